@@ -0,0 +1,174 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+
+#include "namespace-stuffs.h"
+
+#include "bus_pacer.h"
+
+#include "logging/logging.h"
+#include "tracing/tracing.h"
+
+namespace creatures {
+
+    namespace {
+        // Everything in here logs under the "bus" component
+        constexpr auto &logger = logging::component<"bus">;
+
+        // How much the gap comes back down, and how many normal replies in a row it takes
+        constexpr std::chrono::microseconds gapStep{1000};
+        constexpr uint32_t cleanRepliesPerStep = 8;
+    }
+
+    BusPacer::BusPacer(PacerOptions options)
+            : options(options), gap(options.minGap), windowStart(clock::now()) {
+        this->options.baud = std::max<uint32_t>(options.baud, 1);
+        quietSince = windowStart;
+    }
+
+    std::chrono::microseconds BusPacer::airtime(std::size_t bytes) const {
+        // A start bit, eight data bits, and a stop bit
+        return std::chrono::microseconds(bytes * 10 * 1'000'000 / options.baud);
+    }
+
+    std::chrono::microseconds BusPacer::replyWait() const {
+        if (!haveRtt) {
+            return options.initialReplyWait;
+        }
+        return std::clamp<std::chrono::microseconds>(srtt + 4 * rttVar, options.minGap, options.maxGap);
+    }
+
+    bool BusPacer::waitForSlot(std::stop_token stopToken) {
+        return waitUntil(stopToken, std::nullopt);
+    }
+
+    bool BusPacer::waitForSlot(clock::time_point deadline) {
+        return waitUntil({}, deadline);
+    }
+
+    bool BusPacer::waitUntil(std::stop_token stopToken, std::optional<clock::time_point> deadline) {
+        TRACE_ZONE("BusPacer::waitForSlot");
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // Let the panel finish answering the last one, unless it's taking way too long
+        if (awaitingReply) {
+            auto replyDeadline = lastSentAt + replyWait();
+            if (!replied.wait_until(lock, stopToken, deadline ? std::min(replyDeadline, *deadline) : replyDeadline,
+                                    [this] { return !awaitingReply; })) {
+                if (stopToken.stop_requested() || (deadline && clock::now() >= *deadline)) {
+                    return false;
+                }
+                unanswered++;
+                awaitingReply = false;
+                quietSince = clock::now();
+                logger().debug("no reply after {}us, moving on", replyWait().count());
+            }
+        }
+
+        // ...and then give it a breather
+        auto ready = quietSince + gap;
+        lock.unlock();
+        if (deadline && ready > *deadline) {
+            return false;
+        }
+        if (clock::now() < ready) {
+            std::condition_variable_any sleeper;
+            std::mutex sleepMutex;
+            std::unique_lock<std::mutex> sleepLock(sleepMutex);
+            sleeper.wait_until(sleepLock, stopToken, ready, [] { return false; });
+        }
+        return !stopToken.stop_requested();
+    }
+
+    void BusPacer::sent(std::size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto now = clock::now();
+        auto onWire = airtime(bytes);
+
+        lastSentAt = now;
+        awaitingReply = true;
+        quietSince = now + onWire;
+        sentFrames++;
+        addAirtime(onWire, now);
+    }
+
+    void BusPacer::replyReceived(std::size_t bytes, bool busy) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto now = clock::now();
+            addAirtime(airtime(bytes), now);
+            quietSince = now;
+
+            // Frames can show up on their own (or late). Only time the ones we're waiting on.
+            if (awaitingReply) {
+                awaitingReply = false;
+                replies++;
+
+                // RFC 6298, same as TCP
+                auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(now - lastSentAt);
+                if (!haveRtt) {
+                    srtt = rtt;
+                    rttVar = rtt / 2;
+                    haveRtt = true;
+                } else {
+                    auto error = rtt > srtt ? rtt - srtt : srtt - rtt;
+                    rttVar = (3 * rttVar + error) / 4;
+                    srtt = (7 * srtt + rtt) / 8;
+                }
+            }
+
+            if (busy) {
+                busyReplies++;
+                cleanStreak = 0;
+                auto backedOff = std::min<std::chrono::microseconds>(std::max(gap * 2, gapStep), options.maxGap);
+                logger().debug("the panel is busy, backing off to {}us between frames", backedOff.count());
+                gap = backedOff;
+            } else if (++cleanStreak >= cleanRepliesPerStep) {
+                cleanStreak = 0;
+                gap = std::max<std::chrono::microseconds>(gap - gapStep, options.minGap);
+            }
+        }
+        replied.notify_all();
+    }
+
+    void BusPacer::addAirtime(std::chrono::microseconds time, clock::time_point now) {
+        windowAirtime += time;
+
+        auto elapsed = now - windowStart;
+        if (elapsed >= utilizationWindow) {
+            utilization = 100.0 * static_cast<double>(windowAirtime.count()) /
+                          static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+            windowStart = now;
+            windowAirtime = std::chrono::microseconds(0);
+            TRACE_PLOT("bus utilization", utilization);
+        }
+    }
+
+    PacerStats BusPacer::getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        PacerStats stats;
+        stats.rtt = srtt;
+        stats.rttVariance = rttVar;
+        stats.gap = gap;
+        stats.utilization = utilization;
+        stats.sent = sentFrames;
+        stats.replies = replies;
+        stats.busy = busyReplies;
+        stats.unanswered = unanswered;
+        return stats;
+    }
+
+    void BusPacer::logStats() const {
+        auto stats = getStats();
+        logger().info("bus: {} frames sent, {} replies ({} busy, {} never answered), rtt {}us +/- {}us, "
+                      "gap {}us, {:.1f}% utilized", stats.sent, stats.replies, stats.busy, stats.unanswered,
+                      stats.rtt.count(), stats.rttVariance.count(), stats.gap.count(), stats.utilization);
+    }
+
+} // creatures
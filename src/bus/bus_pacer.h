@@ -0,0 +1,125 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_BUS_PACER_H
+#define ANDERSEN_MQTT_BUS_PACER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+
+namespace creatures {
+
+    /**
+     * How hard we're allowed to push the bus
+     */
+    struct PacerOptions {
+
+        // The panel's serial speed. Frames are 8N1, so ten bits a byte on the wire.
+        uint32_t baud = 9600;
+
+        // The gap between frames never goes below this, or above the max
+        std::chrono::milliseconds minGap{5};
+        std::chrono::milliseconds maxGap{500};
+
+        // How long to wait on a reply before we know what the panel's like
+        std::chrono::milliseconds initialReplyWait{200};
+    };
+
+    /**
+     * What the pacer has learned so far
+     */
+    struct PacerStats {
+        std::chrono::microseconds rtt{0};           // smoothed
+        std::chrono::microseconds rttVariance{0};
+        std::chrono::microseconds gap{0};           // what we're leaving between frames right now
+        double utilization = 0;                     // percent of the last stats window the bus was talking
+        uint64_t sent = 0;
+        uint64_t replies = 0;
+        uint64_t busy = 0;
+        uint64_t unanswered = 0;                    // gave up waiting on a reply
+    };
+
+    /**
+     * Keeps the writer from talking over the panel.
+     *
+     * The bus is half duplex, so after a frame goes out we wait for the reply (or for as long
+     * as a reply usually takes, TCP style: smoothed RTT plus four deviations) and then leave a
+     * gap before the next one. The gap is AIMD: every BUSY from the panel doubles it, and
+     * every eight normal replies in a row take a millisecond back off, so we settle in just
+     * under where the panel starts complaining.
+     *
+     * Airtime is estimated from frame lengths and the baud rate, which is what utilization
+     * is worked out from.
+     */
+    class BusPacer {
+
+    public:
+        explicit BusPacer(PacerOptions options = {});
+
+        /**
+         * Blocks the writer until it's OK to send again
+         *
+         * @return false if we're stopping, and it might not be OK yet
+         */
+        bool waitForSlot(std::stop_token stopToken);
+
+        /**
+         * Same, but gives up at the deadline
+         *
+         * @return false if the deadline came first
+         */
+        bool waitForSlot(std::chrono::steady_clock::time_point deadline);
+
+        // A frame just went out
+        void sent(std::size_t bytes);
+
+        // A frame came back from the panel. Called from the reader so the timing is honest.
+        void replyReceived(std::size_t bytes, bool busy);
+
+        [[nodiscard]] PacerStats getStats() const;
+        void logStats() const;
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        bool waitUntil(std::stop_token stopToken, std::optional<clock::time_point> deadline);
+
+        [[nodiscard]] std::chrono::microseconds airtime(std::size_t bytes) const;
+        [[nodiscard]] std::chrono::microseconds replyWait() const;
+        void addAirtime(std::chrono::microseconds time, clock::time_point now);
+
+        PacerOptions options;
+
+        mutable std::mutex mutex;
+        std::condition_variable_any replied;
+
+        bool awaitingReply = false;
+        bool haveRtt = false;
+        clock::time_point lastSentAt;
+        clock::time_point quietSince;         // when the bus last went quiet
+        std::chrono::microseconds srtt{0};
+        std::chrono::microseconds rttVar{0};
+        std::chrono::microseconds gap;
+        uint32_t cleanStreak = 0;
+
+        // Utilization is worked out over windows this long
+        static constexpr std::chrono::seconds utilizationWindow{10};
+        clock::time_point windowStart;
+        std::chrono::microseconds windowAirtime{0};
+        double utilization = 0;
+
+        uint64_t sentFrames = 0;
+        uint64_t replies = 0;
+        uint64_t busyReplies = 0;
+        uint64_t unanswered = 0;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_BUS_PACER_H
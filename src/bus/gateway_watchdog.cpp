@@ -0,0 +1,87 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+
+#include "namespace-stuffs.h"
+
+#include "gateway_watchdog.h"
+
+#include "logging/logging.h"
+
+namespace creatures {
+
+    namespace {
+        // Everything in here logs under the "bus" component
+        constexpr auto &logger = logging::component<"bus">;
+    }
+
+    GatewayWatchdog::GatewayWatchdog(boost::asio::io_context &ioc, uint32_t missedPollLimit,
+                                     std::chrono::milliseconds replyTimeout)
+            : ioc(ioc), deadline(ioc), missedPollLimit(std::max<uint32_t>(missedPollLimit, 1)),
+              replyTimeout(replyTimeout) {}
+
+    void GatewayWatchdog::pollSent() {
+
+        // Counted here, not on the io thread, since the answer could beat us there
+        boost::asio::post(ioc, withMemory(pollMemory, [this, heardBefore = framesHeard.load()] {
+
+            // A confirm poll can go out right behind a background one. The first one's deadline
+            // still stands, and whatever comes back answers both.
+            if (deadlinePending) {
+                return;
+            }
+
+            heardAtPoll = heardBefore;
+            deadlinePending = true;
+            deadline.expires_after(replyTimeout);
+            deadline.async_wait([this](const boost::system::error_code &ec) {
+                if (!ec && deadlinePending) {
+                    deadlinePassed();
+                }
+            });
+        }));
+    }
+
+    void GatewayWatchdog::frameReceived() {
+        framesHeard.fetch_add(1, std::memory_order_relaxed);
+        if (framePosted.exchange(true)) {
+            return;
+        }
+        boost::asio::post(ioc, withMemory(frameMemory, [this] {
+            framePosted = false;
+            heard();
+        }));
+    }
+
+    void GatewayWatchdog::deadlinePassed() {
+        deadlinePending = false;
+
+        if (framesHeard.load(std::memory_order_relaxed) != heardAtPoll) {
+            return;
+        }
+
+        missed++;
+        if (online && missed >= missedPollLimit) {
+            online = false;
+            logger().warn("the gateway missed {} polls in a row, marking it offline", missed);
+            if (callback) {
+                callback(false);
+            }
+        }
+    }
+
+    void GatewayWatchdog::heard() {
+        missed = 0;
+
+        if (!online) {
+            online = true;
+            logger().info("the gateway is online");
+            if (callback) {
+                callback(true);
+            }
+        }
+    }
+
+} // creatures
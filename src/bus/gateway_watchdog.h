@@ -0,0 +1,77 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_GATEWAY_WATCHDOG_H
+#define ANDERSEN_MQTT_GATEWAY_WATCHDOG_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include <boost/asio.hpp>
+
+#include "threading/handler_memory.h"
+
+namespace creatures {
+
+    /**
+     * Notices when the gateway stops answering our polls.
+     *
+     * Every poll that goes out on the wire arms a deadline. If nothing comes back before it,
+     * that's a missed poll, and after enough of them in a row the gateway is offline. The
+     * first good frame brings it right back.
+     *
+     * There's nothing to track per window. One STATUS frame answers for all of them, so a
+     * window can't go quiet without the gateway going quiet too.
+     *
+     * All of the bookkeeping happens on one io_context, so the writer and the processor
+     * only ever post to it.
+     */
+    class GatewayWatchdog {
+
+    public:
+        using AvailabilityCallback = std::function<void(bool online)>;
+
+        GatewayWatchdog(boost::asio::io_context &ioc, uint32_t missedPollLimit, std::chrono::milliseconds replyTimeout);
+
+        void setCallback(AvailabilityCallback newCallback) { callback = std::move(newCallback); }
+
+        // A poll just went out on the wire. Called from the writer.
+        void pollSent();
+
+        // The gateway said something that made sense. Called from the processor.
+        void frameReceived();
+
+    private:
+        void deadlinePassed();
+        void heard();
+
+        boost::asio::io_context &ioc;
+        boost::asio::steady_timer deadline;
+        bool deadlinePending = false;
+
+        uint32_t missedPollLimit;
+        std::chrono::milliseconds replyTimeout;
+
+        AvailabilityCallback callback;
+
+        // These come with every poll and every frame, so they don't go to the heap to get to the io thread
+        HandlerMemory pollMemory;
+        HandlerMemory frameMemory;
+
+        // Every frame counts, but one waiting on the io thread is as good as ten. Whether the
+        // gateway answered a poll is down to this count moving, not to what order things ran in.
+        std::atomic<uint64_t> framesHeard = 0;
+        std::atomic<bool> framePosted = false;
+
+        // Only touched on the io thread
+        bool online = false;
+        uint64_t heardAtPoll = 0;   // framesHeard when the poll the deadline is for went out
+        uint32_t missed = 0;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_GATEWAY_WATCHDOG_H
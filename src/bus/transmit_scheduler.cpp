@@ -0,0 +1,375 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <sstream>
+
+#include "namespace-stuffs.h"
+
+#include "transmit_scheduler.h"
+
+#include "logging/logging.h"
+#include "tracing/tracing.h"
+
+namespace creatures {
+
+    namespace {
+        // Everything in here logs under the "bus" component
+        constexpr auto &logger = logging::component<"bus">;
+
+        constexpr std::array<const char *, trafficClassCount> classNames = {
+                "safety",
+                "command",
+                "confirm_poll",
+                "background_poll"
+        };
+
+        // Tracy holds on to plot names, so these have to live forever
+        [[maybe_unused]] constexpr std::array<const char *, trafficClassCount> depthPlotNames = {
+                "bus queue: safety",
+                "bus queue: command",
+                "bus queue: confirm_poll",
+                "bus queue: background_poll"
+        };
+
+        // Rain closing is still worth doing late, a command mostly isn't, and a stale poll never is
+        constexpr std::array<ClassLimits, trafficClassCount> defaultLimits = {{
+                {16, std::chrono::seconds(60), OverflowPolicy::DropOldest},
+                {32, std::chrono::seconds(30), OverflowPolicy::Reject},
+                {8, std::chrono::seconds(5), OverflowPolicy::DropOldest},
+                {4, std::chrono::seconds(10), OverflowPolicy::DropOldest}
+        }};
+
+        bool isPoll(TrafficClass trafficClass) {
+            return trafficClass == TrafficClass::ConfirmPoll || trafficClass == TrafficClass::BackgroundPoll;
+        }
+
+        bool applyOption(ClassLimits &limits, const std::string &option, const std::string &value) {
+
+            if (option == "overflow") {
+                if (value == "drop_oldest") {
+                    limits.overflow = OverflowPolicy::DropOldest;
+                } else if (value == "drop_newest") {
+                    limits.overflow = OverflowPolicy::DropNewest;
+                } else if (value == "reject") {
+                    limits.overflow = OverflowPolicy::Reject;
+                } else {
+                    return false;
+                }
+                return true;
+            }
+
+            char *end = nullptr;
+            double number = std::strtod(value.c_str(), &end);
+            if (end == value.c_str() || *end != '\0' || number < 0) {
+                return false;
+            }
+
+            if (option == "capacity" && number >= 1) {
+                limits.capacity = static_cast<std::size_t>(number);
+            } else if (option == "ttl") {
+                limits.ttl = std::chrono::milliseconds(static_cast<int64_t>(number * 1000));
+            } else {
+                return false;
+            }
+            return true;
+        }
+    }
+
+    const char *trafficClassName(TrafficClass trafficClass) {
+        return classNames[static_cast<std::size_t>(trafficClass)];
+    }
+
+    std::optional<TrafficClass> trafficClassFromName(const std::string &name) {
+        for (std::size_t i = 0; i < trafficClassCount; i++) {
+            if (name == classNames[i]) {
+                return static_cast<TrafficClass>(i);
+            }
+        }
+        return std::nullopt;
+    }
+
+
+    void QueueWaitHistogram::record(std::chrono::microseconds wait) {
+        auto ms = static_cast<uint64_t>(std::max<int64_t>(wait.count() / 1000, 0));
+        std::size_t bucket = std::min<std::size_t>(std::bit_width(ms), bucketCount - 1);
+
+        buckets[bucket]++;
+        count++;
+        total += wait;
+        longest = std::max(longest, wait);
+    }
+
+    std::chrono::milliseconds QueueWaitHistogram::percentile(double p) const {
+        if (count == 0) {
+            return std::chrono::milliseconds(0);
+        }
+
+        auto target = static_cast<uint64_t>(static_cast<double>(count) * p / 100.0);
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < bucketCount; i++) {
+            seen += buckets[i];
+            if (seen > target || seen == count) {
+                return std::chrono::milliseconds(uint64_t(1) << i);
+            }
+        }
+        return std::chrono::milliseconds(uint64_t(1) << (bucketCount - 1));
+    }
+
+
+    TransmitScheduler::TransmitScheduler(std::chrono::milliseconds agingLimit)
+            : agingLimit(agingLimit), limits(defaultLimits) {}
+
+    bool TransmitScheduler::apply(const std::string &overrides) {
+
+        bool good = true;
+
+        std::istringstream classes(overrides);
+        std::string entry;
+        while (std::getline(classes, entry, ';')) {
+            if (entry.empty()) {
+                continue;
+            }
+
+            auto colon = entry.find(':');
+            auto trafficClass = trafficClassFromName(entry.substr(0, colon));
+            if (colon == std::string::npos || !trafficClass) {
+                warn("ignoring bus limits for unknown class: {}", entry);
+                good = false;
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            auto &classLimits = limits[static_cast<std::size_t>(*trafficClass)];
+
+            std::istringstream options(entry.substr(colon + 1));
+            std::string option;
+            while (std::getline(options, option, ',')) {
+                auto equals = option.find('=');
+                if (equals == std::string::npos ||
+                    !applyOption(classLimits, option.substr(0, equals), option.substr(equals + 1))) {
+                    warn("ignoring bad bus limit for {}: {}", trafficClassName(*trafficClass), option);
+                    good = false;
+                }
+            }
+        }
+
+        return good;
+    }
+
+    ClassLimits TransmitScheduler::getLimits(TrafficClass trafficClass) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return limits[static_cast<std::size_t>(trafficClass)];
+    }
+
+    void TransmitScheduler::setDropCallback(DropCallback callback) {
+        std::lock_guard<std::mutex> lock(mutex);
+        dropCallback = std::move(callback);
+    }
+
+    EnqueueResult TransmitScheduler::enqueue(std::vector<uint8_t> frame, TrafficClass trafficClass, uint64_t tag) {
+        TRACE_ZONE("TransmitScheduler::enqueue");
+        TRACE_ZONE_VALUE(static_cast<uint8_t>(trafficClass));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto index = static_cast<std::size_t>(trafficClass);
+            auto &queue = queues[index];
+            auto &classStats = stats[index];
+            const auto &classLimits = limits[index];
+
+            if (isPoll(trafficClass) &&
+                std::any_of(queue.begin(), queue.end(), [&](const Pending &p) { return p.frame == frame; })) {
+                classStats.coalesced++;
+                logger().trace("a {} is already waiting, not queueing another", trafficClassName(trafficClass));
+                return EnqueueResult::Coalesced;
+            }
+
+            // Anything past its TTL is going nowhere, so it shouldn't count against the room we have
+            expire(std::chrono::steady_clock::now());
+
+            if (queue.size() >= classLimits.capacity) {
+                switch (classLimits.overflow) {
+                    case OverflowPolicy::DropOldest:
+                        logger().warn("{} queue is full, dropping the oldest", trafficClassName(trafficClass));
+                        dropFront(index);
+                        classStats.dropped++;
+                        break;
+                    case OverflowPolicy::DropNewest:
+                        logger().warn("{} queue is full, dropping the newest", trafficClassName(trafficClass));
+                        classStats.dropped++;
+                        return EnqueueResult::Dropped;
+                    case OverflowPolicy::Reject:
+                        logger().warn("{} queue is full, rejecting", trafficClassName(trafficClass));
+                        classStats.rejected++;
+                        return EnqueueResult::Rejected;
+                }
+            }
+
+            queue.push_back({std::move(frame), std::chrono::steady_clock::now(), tag});
+            classStats.depth = queue.size();
+            TRACE_PLOT(depthPlotNames[index], queue.size());
+            classStats.highWater = std::max(classStats.highWater, queue.size());
+        }
+        ready.notify_one();
+        return EnqueueResult::Queued;
+    }
+
+    void TransmitScheduler::expire(std::chrono::steady_clock::time_point now) {
+        for (std::size_t i = 0; i < trafficClassCount; i++) {
+            if (limits[i].ttl.count() == 0) {
+                continue;
+            }
+
+            // Everything in a class has the same TTL, so the expired ones are all up front
+            auto &queue = queues[i];
+            while (!queue.empty() && now - queue.front().enqueuedAt >= limits[i].ttl) {
+                logger().log(isPoll(static_cast<TrafficClass>(i)) ? spdlog::level::debug : spdlog::level::warn,
+                             "a {} waited more than {}ms, not sending it", classNames[i], limits[i].ttl.count());
+                dropFront(i);
+                stats[i].expired++;
+            }
+            stats[i].depth = queue.size();
+        }
+    }
+
+    void TransmitScheduler::dropFront(std::size_t index) {
+        auto tag = queues[index].front().tag;
+        queues[index].pop_front();
+        if (tag != 0 && dropCallback) {
+            dropCallback(static_cast<TrafficClass>(index), tag);
+        }
+    }
+
+    std::optional<std::size_t> TransmitScheduler::pickClass(std::chrono::steady_clock::time_point now,
+                                                            std::size_t classes) const {
+
+        // Anything that's been waiting too long goes first, oldest of those first
+        std::optional<std::size_t> aged;
+        for (std::size_t i = 0; i < classes; i++) {
+            if (!queues[i].empty() && now - queues[i].front().enqueuedAt >= agingLimit &&
+                (!aged || queues[i].front().enqueuedAt < queues[*aged].front().enqueuedAt)) {
+                aged = i;
+            }
+        }
+        if (aged) {
+            return aged;
+        }
+
+        for (std::size_t i = 0; i < classes; i++) {
+            if (!queues[i].empty()) {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void TransmitScheduler::take(std::size_t index, std::vector<uint8_t> &frame,
+                                 std::chrono::steady_clock::time_point now, FrameInfo *info) {
+        auto &pending = queues[index].front();
+        waits[index].record(std::chrono::duration_cast<std::chrono::microseconds>(now - pending.enqueuedAt));
+        frame = std::move(pending.frame);
+        if (info) {
+            info->trafficClass = static_cast<TrafficClass>(index);
+            info->tag = pending.tag;
+            info->enqueuedAt = pending.enqueuedAt;
+        }
+        queues[index].pop_front();
+        stats[index].depth = queues[index].size();
+        TRACE_PLOT(depthPlotNames[index], queues[index].size());
+    }
+
+    bool TransmitScheduler::waitDequeue(std::vector<uint8_t> &frame, std::stop_token stopToken, FrameInfo *info) {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        std::optional<std::size_t> index;
+        ready.wait(lock, stopToken, [&] {
+            auto now = std::chrono::steady_clock::now();
+            expire(now);
+            index = pickClass(now);
+            return index.has_value();
+        });
+
+        if (!index) {
+            return false;
+        }
+
+        take(*index, frame, std::chrono::steady_clock::now(), info);
+        return true;
+    }
+
+    bool TransmitScheduler::tryDequeue(std::vector<uint8_t> &frame, TrafficClass lowest, FrameInfo *info) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto now = std::chrono::steady_clock::now();
+        expire(now);
+        auto index = pickClass(now, static_cast<std::size_t>(lowest) + 1);
+        if (!index) {
+            return false;
+        }
+
+        take(*index, frame, now, info);
+        return true;
+    }
+
+    void TransmitScheduler::putBack(std::vector<uint8_t> frame, const FrameInfo &info) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto index = static_cast<std::size_t>(info.trafficClass);
+            auto &queue = queues[index];
+
+            // It was already let in once, so it doesn't get checked against the capacity again
+            queue.push_front({std::move(frame), info.enqueuedAt, info.tag});
+            stats[index].depth = queue.size();
+            TRACE_PLOT(depthPlotNames[index], queue.size());
+            stats[index].highWater = std::max(stats[index].highWater, queue.size());
+        }
+        ready.notify_one();
+    }
+
+    std::size_t TransmitScheduler::discard() {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::size_t discarded = 0;
+        for (std::size_t i = 0; i < trafficClassCount; i++) {
+            while (!queues[i].empty()) {
+                dropFront(i);
+                stats[i].dropped++;
+                discarded++;
+            }
+            stats[i].depth = 0;
+            TRACE_PLOT(depthPlotNames[i], 0);
+        }
+        return discarded;
+    }
+
+    QueueWaitHistogram TransmitScheduler::getWaitHistogram(TrafficClass trafficClass) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return waits[static_cast<std::size_t>(trafficClass)];
+    }
+
+    ClassStats TransmitScheduler::getStats(TrafficClass trafficClass) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats[static_cast<std::size_t>(trafficClass)];
+    }
+
+    void TransmitScheduler::logStats() const {
+        for (std::size_t i = 0; i < trafficClassCount; i++) {
+            auto histogram = getWaitHistogram(static_cast<TrafficClass>(i));
+            auto classStats = getStats(static_cast<TrafficClass>(i));
+            if (histogram.count == 0 && classStats.highWater == 0 && classStats.rejected == 0 &&
+                classStats.dropped == 0) {
+                continue;
+            }
+            logger().info("{}: {} frames, queue wait p50 <{}ms, p99 <{}ms, longest {}us; "
+                          "{} waiting (at most {}), {} dropped, {} rejected, {} expired, {} coalesced",
+                          classNames[i], histogram.count, histogram.percentile(50).count(),
+                          histogram.percentile(99).count(), histogram.longest.count(),
+                          classStats.depth, classStats.highWater, classStats.dropped, classStats.rejected,
+                          classStats.expired, classStats.coalesced);
+        }
+    }
+
+} // creatures
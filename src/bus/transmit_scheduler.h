@@ -0,0 +1,217 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_TRANSMIT_SCHEDULER_H
+#define ANDERSEN_MQTT_TRANSMIT_SCHEDULER_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+namespace creatures {
+
+    /**
+     * What a frame is for, most important first
+     */
+    enum class TrafficClass : uint8_t {
+        Safety = 0,         // closing up for rain and the like
+        Command,            // someone asked for a window to move
+        ConfirmPoll,        // checking on a window we just told to move
+        BackgroundPoll      // the regular status poll
+    };
+
+    constexpr std::size_t trafficClassCount = 4;
+
+    const char *trafficClassName(TrafficClass trafficClass);
+    std::optional<TrafficClass> trafficClassFromName(const std::string &name);
+
+    /**
+     * What to do with a new frame when its class is already full
+     */
+    enum class OverflowPolicy : uint8_t {
+        DropOldest,     // make room by throwing out the one that's waited longest
+        DropNewest,     // throw out the new one
+        Reject          // throw out the new one, and tell whoever sent it
+    };
+
+    /**
+     * How much of a class can be waiting, and for how long
+     */
+    struct ClassLimits {
+        std::size_t capacity;
+        std::chrono::milliseconds ttl;      // frames older than this are thrown out instead of sent (0 = never)
+        OverflowPolicy overflow;
+    };
+
+    enum class EnqueueResult : uint8_t {
+        Queued,
+        Coalesced,      // an identical poll was already waiting
+        Dropped,        // the class was full
+        Rejected        // the class was full, and the caller should let someone know
+    };
+
+    /**
+     * Gauges and counters for one class
+     */
+    struct ClassStats {
+        std::size_t depth = 0;
+        std::size_t highWater = 0;
+        uint64_t dropped = 0;
+        uint64_t rejected = 0;
+        uint64_t expired = 0;
+        uint64_t coalesced = 0;
+    };
+
+    /**
+     * How long frames sat in the queue before going out. Bucket i holds waits under 2^i ms,
+     * and the last one holds everything longer.
+     */
+    struct QueueWaitHistogram {
+        static constexpr std::size_t bucketCount = 16;
+
+        std::array<uint64_t, bucketCount> buckets{};
+        uint64_t count = 0;
+        std::chrono::microseconds total{0};
+        std::chrono::microseconds longest{0};
+
+        void record(std::chrono::microseconds wait);
+
+        /**
+         * Upper bound of the bucket the given percentile (0-100) lands in
+         */
+        [[nodiscard]] std::chrono::milliseconds percentile(double p) const;
+    };
+
+    /**
+     * What a frame was queued as, for whoever takes it out
+     */
+    struct FrameInfo {
+        TrafficClass trafficClass = TrafficClass::BackgroundPoll;
+        uint64_t tag = 0;
+        std::chrono::steady_clock::time_point enqueuedAt;
+    };
+
+    /**
+     * Everything headed out onto the bus goes through here.
+     *
+     * The bus is half-duplex and 9600 baud, so when there's a backlog it matters what goes
+     * first. Frames come out by class (Safety, then Command, then the polls), and within a
+     * class in the order they went in. So polls can't starve, a frame that has been waiting
+     * longer than the aging limit goes ahead of everything else.
+     *
+     * Poll frames that are already waiting aren't queued twice. A second identical poll
+     * wouldn't tell us anything new.
+     *
+     * Every class is bounded and has a TTL, so when the gateway stalls memory stays flat,
+     * and when it comes back we don't open a window someone asked about an hour ago.
+     */
+    class TransmitScheduler {
+
+    public:
+        explicit TransmitScheduler(std::chrono::milliseconds agingLimit = std::chrono::milliseconds(2000));
+
+        /**
+         * Applies overrides in the form "class:option=value,...;class:..."
+         *
+         * Options are capacity, ttl (in seconds), and overflow (drop_oldest, drop_newest, or
+         * reject). For example: "command:capacity=8,ttl=10;background_poll:capacity=1"
+         *
+         * @return false if any of it didn't make sense (the parts that did are still applied)
+         */
+        bool apply(const std::string &overrides);
+
+        [[nodiscard]] ClassLimits getLimits(TrafficClass trafficClass) const;
+
+        /**
+         * Called when a frame that was queued with a tag gets thrown out instead of sent (its TTL
+         * ran out, or drop_oldest made room for a newer one). Whoever's waiting on an answer to
+         * it won't be getting one.
+         *
+         * This is called with our lock held, so it mustn't call back into us.
+         */
+        using DropCallback = std::function<void(TrafficClass trafficClass, uint64_t tag)>;
+        void setDropCallback(DropCallback callback);
+
+        /**
+         * @param tag anything but 0 means we'll say so (see setDropCallback()) if this frame never goes out
+         */
+        EnqueueResult enqueue(std::vector<uint8_t> frame, TrafficClass trafficClass, uint64_t tag = 0);
+
+        /**
+         * Waits for the next frame to send
+         *
+         * @param info if not null, gets what the frame was queued as
+         * @return false if we were asked to stop first
+         */
+        bool waitDequeue(std::vector<uint8_t> &frame, std::stop_token stopToken, FrameInfo *info = nullptr);
+
+        /**
+         * @param lowest the least important class to take from. Anything below it stays put.
+         * @param info if not null, gets what the frame was queued as
+         * @return false if there's nothing waiting
+         */
+        bool tryDequeue(std::vector<uint8_t> &frame, TrafficClass lowest = TrafficClass::BackgroundPoll,
+                        FrameInfo *info = nullptr);
+
+        /**
+         * Puts a frame that was taken out but never sent back at the front of its class, so it
+         * goes out before anything that was queued after it. It keeps its tag and its age.
+         */
+        void putBack(std::vector<uint8_t> frame, const FrameInfo &info);
+
+        /**
+         * Throws out everything still waiting (tagged frames are reported, same as any other drop)
+         *
+         * @return how many frames that was
+         */
+        std::size_t discard();
+
+        [[nodiscard]] QueueWaitHistogram getWaitHistogram(TrafficClass trafficClass) const;
+
+        [[nodiscard]] ClassStats getStats(TrafficClass trafficClass) const;
+
+        /**
+         * Logs how long each class has been waiting, and what got thrown out
+         */
+        void logStats() const;
+
+    private:
+        struct Pending {
+            std::vector<uint8_t> frame;
+            std::chrono::steady_clock::time_point enqueuedAt;
+            uint64_t tag;
+        };
+
+        // Must be called with the lock held
+        void expire(std::chrono::steady_clock::time_point now);
+        void dropFront(std::size_t index);
+        std::optional<std::size_t> pickClass(std::chrono::steady_clock::time_point now,
+                                             std::size_t classes = trafficClassCount) const;
+        void take(std::size_t index, std::vector<uint8_t> &frame, std::chrono::steady_clock::time_point now,
+                  FrameInfo *info);
+
+        std::chrono::milliseconds agingLimit;
+
+        mutable std::mutex mutex;
+        std::condition_variable_any ready;
+
+        std::array<std::deque<Pending>, trafficClassCount> queues;
+        std::array<ClassLimits, trafficClassCount> limits;
+        std::array<QueueWaitHistogram, trafficClassCount> waits;
+        std::array<ClassStats, trafficClassCount> stats;
+
+        DropCallback dropCallback;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_TRANSMIT_SCHEDULER_H
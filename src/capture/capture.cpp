@@ -0,0 +1,249 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "namespace-stuffs.h"
+
+#include "capture.h"
+
+#include "logging/logging.h"
+
+namespace creatures {
+
+    namespace {
+        // Everything in here logs under the "capture" component
+        constexpr auto &logger = logging::component<"capture">;
+
+        constexpr char captureMagic[8] = {'A', 'N', 'D', 'C', 'A', 'P', '0', '1'};
+        constexpr uint32_t captureVersion = 1;
+
+        // Anything smaller than this isn't worth the trouble
+        constexpr std::size_t minimumCapacity = 4096;
+
+        bool isCapture(const CaptureFileHeader &header) {
+            return std::memcmp(header.magic, captureMagic, sizeof(captureMagic)) == 0 &&
+                   header.version == captureVersion &&
+                   header.headerSize == sizeof(CaptureFileHeader);
+        }
+    }
+
+
+    CaptureWriter::CaptureWriter(std::string path, std::size_t capacity) : path(std::move(path)), capacity(capacity) {}
+
+    CaptureWriter::~CaptureWriter() {
+        if (mapping != nullptr) {
+            msync(mapping, mappingSize, MS_ASYNC);
+            munmap(mapping, mappingSize);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool CaptureWriter::open() {
+
+        if (capacity < minimumCapacity) {
+            logger().error("capture capacity of {} bytes is too small (minimum is {})", capacity, minimumCapacity);
+            return false;
+        }
+
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            logger().error("unable to open capture file {}: {}", path, strerror(errno));
+            return false;
+        }
+
+        mappingSize = sizeof(CaptureFileHeader) + capacity;
+
+        // If there's already a capture here that's the same size, keep adding to it
+        bool reuse = false;
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) == mappingSize) {
+            CaptureFileHeader existing{};
+            if (pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+                isCapture(existing) && existing.capacity == capacity) {
+                reuse = true;
+            }
+        }
+
+        if (!reuse) {
+            if (ftruncate(fd, 0) != 0 || ftruncate(fd, static_cast<off_t>(mappingSize)) != 0) {
+                logger().error("unable to size capture file {}: {}", path, strerror(errno));
+                return false;
+            }
+
+            // Grab the disk space now so we don't find out it's gone in the middle of a capture
+            int result = posix_fallocate(fd, 0, static_cast<off_t>(mappingSize));
+            if (result != 0) {
+                logger().warn("unable to preallocate capture file {}: {}", path, strerror(result));
+            }
+        }
+
+        void *address = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            logger().error("unable to map capture file {}: {}", path, strerror(errno));
+            return false;
+        }
+
+        mapping = static_cast<uint8_t *>(address);
+        header = reinterpret_cast<CaptureFileHeader *>(mapping);
+        ring = mapping + sizeof(CaptureFileHeader);
+
+        if (!reuse) {
+            std::memset(header, 0, sizeof(CaptureFileHeader));
+            std::memcpy(header->magic, captureMagic, sizeof(captureMagic));
+            header->version = captureVersion;
+            header->headerSize = sizeof(CaptureFileHeader);
+            header->capacity = capacity;
+        }
+
+        logger().info("capturing wire traffic to {} ({} byte ring, {} records so far)", path, capacity, header->records);
+        return true;
+    }
+
+    void CaptureWriter::record(CaptureDirection direction, const uint8_t *bytes, std::size_t size) {
+
+        if (header == nullptr || size == 0) {
+            return;
+        }
+
+        std::size_t needed = sizeof(CaptureRecordHeader) + size;
+        if (size > UINT16_MAX || needed > capacity) {
+            logger().warn("not capturing a {} byte chunk, it's too big for the ring", size);
+            return;
+        }
+
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+
+        std::lock_guard<std::mutex> lock(writeMutex);
+
+        // Won't fit before the end of the ring? Clear out what's left back there and wrap.
+        if (header->head + needed > capacity) {
+            while (header->records > 0 && header->tail >= header->head) {
+                evictOldest();
+            }
+            if (header->head + sizeof(CaptureRecordHeader) <= capacity) {
+                CaptureRecordHeader pad{};
+                pad.direction = CaptureDirection::Pad;
+                std::memcpy(ring + header->head, &pad, sizeof(pad));
+            }
+            header->head = 0;
+        }
+
+        // Make room by dropping the oldest records we're about to write over
+        while (header->records > 0 && header->tail >= header->head && header->tail < header->head + needed) {
+            evictOldest();
+        }
+        if (header->records == 0) {
+            header->tail = header->head;
+        }
+
+        CaptureRecordHeader record{};
+        record.timestampNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+        record.length = static_cast<uint16_t>(size);
+        record.direction = direction;
+
+        std::memcpy(ring + header->head, &record, sizeof(record));
+        std::memcpy(ring + header->head + sizeof(record), bytes, size);
+
+        // Only move the head once the bytes are really there, so a crash leaves a readable file
+        std::atomic_thread_fence(std::memory_order_release);
+        header->head += needed;
+        header->records++;
+        header->totalRecords++;
+    }
+
+    void CaptureWriter::evictOldest() {
+        CaptureRecordHeader oldest{};
+        std::memcpy(&oldest, ring + header->tail, sizeof(oldest));
+
+        if (oldest.direction == CaptureDirection::Pad) {
+            header->tail = 0;
+            return;
+        }
+
+        header->tail += sizeof(CaptureRecordHeader) + oldest.length;
+        header->records--;
+
+        // No room for another record header back here means the next one is at the front
+        if (header->tail + sizeof(CaptureRecordHeader) > capacity) {
+            header->tail = 0;
+        }
+    }
+
+
+    bool CaptureReader::forEach(const RecordHandler &handler) const {
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            logger().error("unable to open capture file {}: {}", path, strerror(errno));
+            return false;
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(CaptureFileHeader)) {
+            logger().error("{} is too small to be a capture", path);
+            close(fd);
+            return false;
+        }
+
+        auto size = static_cast<std::size_t>(st.st_size);
+        void *address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED) {
+            logger().error("unable to map capture file {}: {}", path, strerror(errno));
+            return false;
+        }
+
+        const auto *mapping = static_cast<const uint8_t *>(address);
+        const auto *header = reinterpret_cast<const CaptureFileHeader *>(mapping);
+
+        if (!isCapture(*header) || sizeof(CaptureFileHeader) + header->capacity != size) {
+            logger().error("{} isn't a capture file this version understands", path);
+            munmap(address, size);
+            return false;
+        }
+
+        const uint8_t *ring = mapping + sizeof(CaptureFileHeader);
+        const uint64_t capacity = header->capacity;
+
+        logger().debug("reading {} records from {}", header->records, path);
+
+        uint64_t position = header->tail;
+        bool good = true;
+        for (uint64_t i = 0; i < header->records; i++) {
+            if (position + sizeof(CaptureRecordHeader) > capacity) {
+                position = 0;
+            }
+
+            CaptureRecordHeader record{};
+            std::memcpy(&record, ring + position, sizeof(record));
+            if (record.direction == CaptureDirection::Pad) {
+                position = 0;
+                std::memcpy(&record, ring + position, sizeof(record));
+            }
+
+            if (position + sizeof(CaptureRecordHeader) + record.length > capacity) {
+                logger().error("capture {} is corrupt at offset {}", path, position);
+                good = false;
+                break;
+            }
+
+            handler(record, ring + position + sizeof(CaptureRecordHeader));
+            position += sizeof(CaptureRecordHeader) + record.length;
+        }
+
+        munmap(address, size);
+        return good;
+    }
+
+} // creatures
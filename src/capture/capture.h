@@ -0,0 +1,119 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_CAPTURE_H
+#define ANDERSEN_MQTT_CAPTURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace creatures {
+
+    /*
+     * Capture file layout
+     *
+     *   [CaptureFileHeader][ring of records ... capacity bytes]
+     *
+     * Each record is a CaptureRecordHeader followed by `length` bytes from the wire. The ring
+     * is preallocated when the file is made and the oldest records are overwritten once it
+     * fills up. If a record won't fit before the end of the ring, a pad record is left (when
+     * there's room for one) and writing starts over at the front.
+     */
+
+    enum class CaptureDirection : uint8_t {
+        Received = 0,   // gateway -> us
+        Sent = 1,       // us -> gateway
+        Pad = 0xFF      // nothing here, skip to the start of the ring
+    };
+
+    struct CaptureFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t capacity;      // size of the ring
+        uint64_t head;          // where the next record goes
+        uint64_t tail;          // the oldest record we still have
+        uint64_t records;       // how many records are in the ring right now
+        uint64_t totalRecords;  // how many records have ever been written
+        uint8_t reserved[8];
+    };
+
+    struct __attribute__((packed)) CaptureRecordHeader {
+        uint64_t timestampNs;   // since the epoch
+        uint16_t length;
+        CaptureDirection direction;
+        uint8_t reserved;
+    };
+
+    static_assert(sizeof(CaptureFileHeader) == 64);
+    static_assert(sizeof(CaptureRecordHeader) == 12);
+
+
+    /**
+     * Appends timestamped chunks of wire traffic to an mmap'd capture file. Safe to call
+     * from the reader and writer threads at the same time.
+     */
+    class CaptureWriter {
+
+    public:
+        CaptureWriter(std::string path, std::size_t capacity);
+        ~CaptureWriter();
+
+        CaptureWriter(const CaptureWriter &) = delete;
+        CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+        /**
+         * Opens (or makes) the capture file. An existing capture with the same capacity is
+         * appended to, anything else is started over.
+         *
+         * @return true if we're ready to record
+         */
+        bool open();
+
+        void record(CaptureDirection direction, const uint8_t *bytes, std::size_t size);
+
+    private:
+
+        void evictOldest();
+
+        std::string path;
+        std::size_t capacity;
+
+        int fd = -1;
+        uint8_t *mapping = nullptr;
+        std::size_t mappingSize = 0;
+
+        CaptureFileHeader *header = nullptr;
+        uint8_t *ring = nullptr;
+
+        std::mutex writeMutex;
+
+    };
+
+
+    /**
+     * Walks the records of a capture file, oldest first
+     */
+    class CaptureReader {
+
+    public:
+        using RecordHandler = std::function<void(const CaptureRecordHeader &record, const uint8_t *bytes)>;
+
+        explicit CaptureReader(std::string path) : path(std::move(path)) {}
+
+        /**
+         * @return false if the file couldn't be read or isn't a capture
+         */
+        bool forEach(const RecordHandler &handler) const;
+
+    private:
+        std::string path;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_CAPTURE_H
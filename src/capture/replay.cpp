@@ -0,0 +1,53 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <condition_variable>
+#include <mutex>
+
+#include "replay.h"
+
+namespace creatures {
+
+    bool Replayer::run(std::stop_token stopToken, const ChunkHandler &handler) {
+
+        auto start = std::chrono::steady_clock::now();
+        bool haveFirst = false;
+        uint64_t firstTimestamp = 0;
+
+        // Lets the waits below end early if we're told to stop
+        std::mutex waitMutex;
+        std::condition_variable_any waitCondition;
+
+        bool good = reader.forEach([&](const CaptureRecordHeader &record, const uint8_t *data) {
+            if (stopToken.stop_requested()) {
+                return;
+            }
+
+            if (!haveFirst) {
+                firstTimestamp = record.timestampNs;
+                haveFirst = true;
+            }
+
+            // Hold this one until it's due
+            if (speed > 0 && record.timestampNs > firstTimestamp) {
+                auto offset = std::chrono::nanoseconds(
+                        static_cast<int64_t>(static_cast<double>(record.timestampNs - firstTimestamp) / speed));
+                std::unique_lock<std::mutex> lock(waitMutex);
+                if (waitCondition.wait_until(lock, stopToken, start + offset, [] { return false; }) ||
+                    stopToken.stop_requested()) {
+                    return;
+                }
+            }
+
+            handler(record.direction, data, record.length);
+
+            records++;
+            bytes += record.length;
+        });
+
+        elapsed = std::chrono::steady_clock::now() - start;
+        return good;
+    }
+
+} // creatures
@@ -0,0 +1,53 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_REPLAY_H
+#define ANDERSEN_MQTT_REPLAY_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stop_token>
+#include <string>
+
+#include "capture.h"
+
+namespace creatures {
+
+    /**
+     * Plays a capture file back with the same timing it was recorded with, sped up by
+     * `speed`. A speed of 0 means don't wait at all.
+     */
+    class Replayer {
+
+    public:
+        using ChunkHandler = std::function<void(CaptureDirection direction, const uint8_t *bytes, std::size_t size)>;
+
+        Replayer(std::string path, double speed) : reader(std::move(path)), speed(speed) {}
+
+        /**
+         * Runs the whole capture through the handler, stopping early if we're asked to.
+         *
+         * @return false if the capture couldn't be read
+         */
+        bool run(std::stop_token stopToken, const ChunkHandler &handler);
+
+        [[nodiscard]] uint64_t getRecords() const { return records; }
+        [[nodiscard]] uint64_t getBytes() const { return bytes; }
+        [[nodiscard]] std::chrono::nanoseconds getElapsed() const { return elapsed; }
+
+    private:
+
+        CaptureReader reader;
+        double speed;
+
+        uint64_t records = 0;
+        uint64_t bytes = 0;
+        std::chrono::nanoseconds elapsed{0};
+
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_REPLAY_H
@@ -0,0 +1,150 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+#include "config.h"
+
+namespace creatures {
+
+    Configuration Configuration::fromEnvironment() {
+        Configuration config;
+
+        config.logLevel = getEnv("ANDERSEN_LOG_LEVEL", config.logLevel);
+        config.logLevels = getEnv("ANDERSEN_LOG_LEVELS", config.logLevels);
+        config.logQueueSize = getEnvSize("ANDERSEN_LOG_QUEUE_SIZE", config.logQueueSize);
+        config.logOverflowPolicy = getEnv("ANDERSEN_LOG_OVERFLOW", config.logOverflowPolicy);
+
+        config.threads = getEnv("ANDERSEN_THREADS", config.threads);
+        config.mlockAll = getEnvBool("ANDERSEN_MLOCKALL", config.mlockAll);
+
+        config.mqttHost = getEnv("ANDERSEN_MQTT_HOST", config.mqttHost);
+        config.mqttPort = getEnv("ANDERSEN_MQTT_PORT", config.mqttPort);
+        config.brokers = parseBrokers(getEnv("ANDERSEN_MQTT_BROKERS", ""));
+        if (config.brokers.empty()) {
+            config.brokers.push_back({"mqtt", config.mqttHost, config.mqttPort});
+        }
+        config.mqttShards = getEnvSize("ANDERSEN_MQTT_SHARDS", config.mqttShards);
+        config.mqttV5 = getEnvBool("ANDERSEN_MQTT_V5", config.mqttV5);
+        config.mqttReceiveMaximum = static_cast<uint16_t>(getEnvSize("ANDERSEN_MQTT_RECEIVE_MAXIMUM", config.mqttReceiveMaximum));
+        config.commandMaxAge = getEnvSize("ANDERSEN_COMMAND_MAX_AGE", config.commandMaxAge);
+        config.commandDedupe = getEnvSize("ANDERSEN_COMMAND_DEDUPE", config.commandDedupe);
+        config.gatewayHost = getEnv("ANDERSEN_GATEWAY_HOST", config.gatewayHost);
+        config.gatewayPort = static_cast<int>(getEnvSize("ANDERSEN_GATEWAY_PORT", config.gatewayPort));
+        config.gatewayMissedPolls = getEnvSize("ANDERSEN_GATEWAY_MISSED_POLLS", config.gatewayMissedPolls);
+        config.gatewayReplyTimeout = getEnvSize("ANDERSEN_GATEWAY_REPLY_TIMEOUT", config.gatewayReplyTimeout);
+        config.busLimits = getEnv("ANDERSEN_BUS_LIMITS", config.busLimits);
+        config.busBaud = getEnvSize("ANDERSEN_BUS_BAUD", config.busBaud);
+        config.busMinGap = getEnvSize("ANDERSEN_BUS_MIN_GAP", config.busMinGap);
+        config.incomingQueueSize = getEnvSize("ANDERSEN_INCOMING_QUEUE_SIZE", config.incomingQueueSize);
+
+        // In a container the hostname is different every time, which is what we want
+        char hostname[256] = {};
+        gethostname(hostname, sizeof(hostname) - 1);
+        config.failover = getEnvBool("ANDERSEN_FAILOVER", config.failover);
+        config.instanceName = getEnv("ANDERSEN_INSTANCE", hostname[0] ? hostname : "andersen-mqtt");
+        config.failoverSettle = getEnvSize("ANDERSEN_FAILOVER_SETTLE", config.failoverSettle);
+
+        config.publishPolicy = getEnv("ANDERSEN_PUBLISH_POLICY", config.publishPolicy);
+        config.groups = getEnv("ANDERSEN_GROUPS", config.groups);
+        config.scenes = getEnv("ANDERSEN_SCENES", config.scenes);
+        config.rules = getEnv("ANDERSEN_RULES", config.rules);
+
+        config.stateFile = getEnv("ANDERSEN_STATE_FILE", config.stateFile);
+        config.historySize = getEnvSize("ANDERSEN_HISTORY_SIZE", config.historySize);
+        config.sharedStateFile = getEnv("ANDERSEN_SHM_EXPORT", config.sharedStateFile);
+        config.httpPort = static_cast<uint16_t>(getEnvSize("ANDERSEN_HTTP_PORT", config.httpPort));
+
+        config.captureFile = getEnv("ANDERSEN_CAPTURE_FILE", config.captureFile);
+        config.captureSize = getEnvSize("ANDERSEN_CAPTURE_SIZE", config.captureSize);
+        config.replayFile = getEnv("ANDERSEN_REPLAY_FILE", config.replayFile);
+        config.replaySpeed = getEnvSpeed("ANDERSEN_REPLAY_SPEED", config.replaySpeed);
+
+        return config;
+    }
+
+    std::string Configuration::getEnv(const char *name, const std::string &fallback) {
+        const char *value = std::getenv(name);
+        if (value == nullptr || *value == '\0') {
+            return fallback;
+        }
+        return value;
+    }
+
+    std::size_t Configuration::getEnvSize(const char *name, std::size_t fallback) {
+        const char *value = std::getenv(name);
+        if (value == nullptr || *value == '\0') {
+            return fallback;
+        }
+
+        // Don't let a typo in a compose file take the whole daemon down
+        char *end = nullptr;
+        unsigned long long parsed = std::strtoull(value, &end, 10);
+        if (end == value || *end != '\0') {
+            return fallback;
+        }
+        return static_cast<std::size_t>(parsed);
+    }
+
+    bool Configuration::getEnvBool(const char *name, bool fallback) {
+        const char *value = std::getenv(name);
+        if (value == nullptr || *value == '\0') {
+            return fallback;
+        }
+
+        std::string text(value);
+        if (text == "yes" || text == "true" || text == "1") {
+            return true;
+        }
+        if (text == "no" || text == "false" || text == "0") {
+            return false;
+        }
+        return fallback;
+    }
+
+    std::vector<BrokerConfig> Configuration::parseBrokers(const std::string &spec) {
+        std::vector<BrokerConfig> brokers;
+
+        std::istringstream entries(spec);
+        std::string entry;
+        while (std::getline(entries, entry, ';')) {
+            auto equals = entry.find('=');
+            auto colon = entry.rfind(':');
+
+            // Anything that isn't name=host:port gets skipped
+            if (equals == std::string::npos || equals == 0 || colon == std::string::npos ||
+                colon < equals + 2 || colon + 1 == entry.size()) {
+                continue;
+            }
+
+            brokers.push_back({entry.substr(0, equals),
+                               entry.substr(equals + 1, colon - equals - 1),
+                               entry.substr(colon + 1)});
+        }
+
+        return brokers;
+    }
+
+    double Configuration::getEnvSpeed(const char *name, double fallback) {
+        const char *value = std::getenv(name);
+        if (value == nullptr || *value == '\0') {
+            return fallback;
+        }
+
+        if (std::string(value) == "max") {
+            return 0.0;
+        }
+
+        char *end = nullptr;
+        double parsed = std::strtod(value, &end);
+        if (end == value || *end != '\0' || parsed < 0) {
+            return fallback;
+        }
+        return parsed;
+    }
+
+} // creatures
@@ -0,0 +1,198 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_CONFIG_H
+#define ANDERSEN_MQTT_CONFIG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace creatures {
+
+    /**
+     * One broker we publish to (and take commands from)
+     */
+    struct BrokerConfig {
+        std::string name;
+        std::string host;
+        std::string port;
+    };
+
+    /**
+     * Runtime settings for the daemon. We run in a container, so everything comes from the
+     * environment. Anything that isn't set keeps the defaults below.
+     */
+    class Configuration {
+
+    public:
+        Configuration() = default;
+
+        static Configuration fromEnvironment();
+
+        [[nodiscard]] const std::string &getLogLevel() const { return logLevel; }
+        [[nodiscard]] const std::string &getLogLevels() const { return logLevels; }
+        [[nodiscard]] std::size_t getLogQueueSize() const { return logQueueSize; }
+        [[nodiscard]] const std::string &getThreads() const { return threads; }
+        [[nodiscard]] bool isMlockAll() const { return mlockAll; }
+        [[nodiscard]] const std::string &getLogOverflowPolicy() const { return logOverflowPolicy; }
+
+        [[nodiscard]] const std::string &getMqttHost() const { return mqttHost; }
+        [[nodiscard]] const std::string &getMqttPort() const { return mqttPort; }
+        [[nodiscard]] const std::vector<BrokerConfig> &getBrokers() const { return brokers; }
+        [[nodiscard]] std::size_t getMqttShards() const { return mqttShards; }
+        [[nodiscard]] bool isMqttV5() const { return mqttV5; }
+        [[nodiscard]] uint16_t getMqttReceiveMaximum() const { return mqttReceiveMaximum; }
+        [[nodiscard]] std::size_t getCommandMaxAge() const { return commandMaxAge; }
+        [[nodiscard]] std::size_t getCommandDedupe() const { return commandDedupe; }
+        [[nodiscard]] const std::string &getGatewayHost() const { return gatewayHost; }
+        [[nodiscard]] int getGatewayPort() const { return gatewayPort; }
+        [[nodiscard]] std::size_t getGatewayMissedPolls() const { return gatewayMissedPolls; }
+        [[nodiscard]] std::size_t getGatewayReplyTimeout() const { return gatewayReplyTimeout; }
+        [[nodiscard]] const std::string &getBusLimits() const { return busLimits; }
+        [[nodiscard]] std::size_t getBusBaud() const { return busBaud; }
+        [[nodiscard]] std::size_t getBusMinGap() const { return busMinGap; }
+        [[nodiscard]] std::size_t getIncomingQueueSize() const { return incomingQueueSize; }
+
+        [[nodiscard]] bool isFailover() const { return failover; }
+        [[nodiscard]] const std::string &getInstanceName() const { return instanceName; }
+        [[nodiscard]] std::size_t getFailoverSettle() const { return failoverSettle; }
+
+        [[nodiscard]] const std::string &getPublishPolicy() const { return publishPolicy; }
+        [[nodiscard]] const std::string &getGroups() const { return groups; }
+        [[nodiscard]] const std::string &getScenes() const { return scenes; }
+        [[nodiscard]] const std::string &getRules() const { return rules; }
+
+        [[nodiscard]] const std::string &getSharedStateFile() const { return sharedStateFile; }
+        [[nodiscard]] const std::string &getStateFile() const { return stateFile; }
+        [[nodiscard]] std::size_t getHistorySize() const { return historySize; }
+        [[nodiscard]] uint16_t getHttpPort() const { return httpPort; }
+
+        [[nodiscard]] const std::string &getCaptureFile() const { return captureFile; }
+        [[nodiscard]] std::size_t getCaptureSize() const { return captureSize; }
+        [[nodiscard]] const std::string &getReplayFile() const { return replayFile; }
+        [[nodiscard]] double getReplaySpeed() const { return replaySpeed; }
+
+    private:
+
+        static std::string getEnv(const char *name, const std::string &fallback);
+        static std::size_t getEnvSize(const char *name, std::size_t fallback);
+        static double getEnvSpeed(const char *name, double fallback);
+        static bool getEnvBool(const char *name, bool fallback);
+        static std::vector<BrokerConfig> parseBrokers(const std::string &spec);
+
+        // ANDERSEN_LOG_LEVEL: the level for any component that isn't called out on its own
+        std::string logLevel = "trace";
+
+        // ANDERSEN_LOG_LEVELS: per-component overrides, like "window=info,mqtt_cpp=warn"
+        std::string logLevels;
+
+        // ANDERSEN_LOG_QUEUE_SIZE: how many records can be waiting on the console thread
+        std::size_t logQueueSize = 8192;
+
+        // ANDERSEN_LOG_OVERFLOW: what to do when that queue is full (overrun_oldest or block)
+        std::string logOverflowPolicy = "overrun_oldest";
+
+        // ANDERSEN_THREADS: where each thread runs, like "reader:cpus=3,fifo=50;mqtt:nice=5"
+        std::string threads;
+
+        // ANDERSEN_MLOCKALL: lock all of our memory so we never wait on a page fault
+        bool mlockAll = false;
+
+        // ANDERSEN_MQTT_HOST / ANDERSEN_MQTT_PORT: the broker
+        std::string mqttHost = "10.3.2.5";
+        std::string mqttPort = "1883";
+
+        // ANDERSEN_MQTT_BROKERS: to publish to more than one broker, like
+        // "local=10.3.2.5:1883;cloud=bridge.example.com:1883". Replaces the host and port above.
+        std::vector<BrokerConfig> brokers;
+
+        // ANDERSEN_MQTT_SHARDS: connections to each broker, with the windows split between them
+        std::size_t mqttShards = 1;
+
+        // ANDERSEN_MQTT_V5: talk MQTT v5 (topic aliases, user properties, etc) instead of v3.1.1
+        bool mqttV5 = false;
+
+        // ANDERSEN_MQTT_RECEIVE_MAXIMUM: v5 only, QoS1 messages the broker can have in flight to us
+        uint16_t mqttReceiveMaximum = 16;
+
+        // ANDERSEN_COMMAND_MAX_AGE: v5 only, seconds before a timestamped command is too old to run (0 = never)
+        std::size_t commandMaxAge = 30;
+
+        // ANDERSEN_COMMAND_DEDUPE: milliseconds a command from one broker stops the same one from another running (0 = off)
+        std::size_t commandDedupe = 2000;
+
+        // ANDERSEN_GATEWAY_HOST / ANDERSEN_GATEWAY_PORT: the serial to TCP gateway on the window bus
+        std::string gatewayHost = "10.3.2.5";
+        int gatewayPort = 6000;
+
+        // ANDERSEN_GATEWAY_MISSED_POLLS: polls in a row that can go unanswered before the gateway is offline
+        std::size_t gatewayMissedPolls = 2;
+
+        // ANDERSEN_GATEWAY_REPLY_TIMEOUT: milliseconds the gateway has to answer a poll
+        std::size_t gatewayReplyTimeout = 2000;
+
+        // ANDERSEN_BUS_LIMITS: overrides for how much of each kind of traffic can wait for the bus, and for how long
+        std::string busLimits;
+
+        // ANDERSEN_BUS_BAUD: how fast the panel's serial bus runs, for working out airtime
+        std::size_t busBaud = 9600;
+
+        // ANDERSEN_BUS_MIN_GAP: the least milliseconds we'll leave between frames, however well the panel's keeping up
+        std::size_t busMinGap = 5;
+
+        // ANDERSEN_INCOMING_QUEUE_SIZE: frames from the gateway that can wait to be processed before we drop the oldest
+        std::size_t incomingQueueSize = 256;
+
+        // ANDERSEN_FAILOVER: run as one of a pair, where only the leader talks to the gateway
+        bool failover = false;
+
+        // ANDERSEN_INSTANCE: what this instance is called for failover (the hostname if it isn't set)
+        std::string instanceName;
+
+        // ANDERSEN_FAILOVER_SETTLE: milliseconds the leader lock has to stay ours before we act on it
+        std::size_t failoverSettle = 250;
+
+        // ANDERSEN_PUBLISH_POLICY: overrides for how often each window field is published
+        std::string publishPolicy;
+
+        // ANDERSEN_GROUPS: named sets of windows, like "front=window1,window2;back=window3,window4"
+        std::string groups;
+
+        // ANDERSEN_SCENES: named sets of commands, like "night=window1:close,window3:open"
+        std::string scenes;
+
+        // ANDERSEN_RULES: overrides for what happens on its own when a window changes, like "rain_close:scope=all"
+        std::string rules;
+
+        // ANDERSEN_STATE_FILE: if set, the last known window state is saved here and restored at startup
+        std::string stateFile;
+
+        // ANDERSEN_HISTORY_SIZE: bytes of status history to keep in memory for each window (0 = off)
+        std::size_t historySize = 4096;
+
+        // ANDERSEN_SHM_EXPORT: if set, window state is also kept in a shared memory region here
+        std::string sharedStateFile;
+
+        // ANDERSEN_HTTP_PORT: if set, serve the local HTTP API on this port (0 = off)
+        uint16_t httpPort = 0;
+
+        // ANDERSEN_CAPTURE_FILE: if set, every byte to and from the gateway is recorded here
+        std::string captureFile;
+
+        // ANDERSEN_CAPTURE_SIZE: how big the capture ring is, in bytes
+        std::size_t captureSize = 64 * 1024 * 1024;
+
+        // ANDERSEN_REPLAY_FILE: if set, play this capture back instead of talking to the gateway
+        std::string replayFile;
+
+        // ANDERSEN_REPLAY_SPEED: 1, 100, etc. "max" (or 0) means as fast as we can go.
+        double replaySpeed = 1.0;
+
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_CONFIG_H
@@ -0,0 +1,345 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <chrono>
+#include <string>
+
+#include "namespace-stuffs.h"
+
+#include "http_server.h"
+
+#include "bus/bus_pacer.h"
+#include "bus/transmit_scheduler.h"
+#include "logging/logging.h"
+#include "mqtt/command_tracker.h"
+#include "threading/threading.h"
+#include "window/command_compiler.h"
+
+extern std::shared_ptr<creatures::TransmitScheduler> transmitScheduler;
+extern std::shared_ptr<creatures::BusPacer> busPacer;
+extern std::shared_ptr<creatures::CommandTracker> commandTracker;
+
+namespace beast = boost::beast;
+namespace http = boost::beast::http;
+using tcp = boost::asio::ip::tcp;
+
+namespace creatures {
+
+    namespace {
+        // Everything in here logs under the "http" component
+        constexpr auto &logger = logging::component<"http">;
+
+        // A client on /events that falls this far behind gets dropped instead of eating memory
+        constexpr std::size_t maxPendingEvents = 64;
+
+        // How long a keep-alive connection can sit there doing nothing
+        constexpr auto idleTimeout = std::chrono::seconds(60);
+
+        const std::string windowsPrefix = "/windows/";
+
+        std::shared_ptr<const std::string> formatEvent(const std::string &event, const std::string &data) {
+            return std::make_shared<const std::string>("event: " + event + "\ndata: " + data + "\n\n");
+        }
+    }
+
+
+    HttpServer::HttpServer(boost::asio::io_context &ioc, uint16_t port, std::vector<std::shared_ptr<Window>> windows)
+            : ioc(ioc), acceptor(ioc), port(port), windows(std::move(windows)) {}
+
+    bool HttpServer::start() {
+
+        boost::system::error_code ec;
+        tcp::endpoint endpoint(tcp::v4(), port);
+
+        acceptor.open(endpoint.protocol(), ec);
+        if (!ec) {
+            acceptor.set_option(boost::asio::socket_base::reuse_address(true), ec);
+        }
+        if (!ec) {
+            acceptor.bind(endpoint, ec);
+        }
+        if (!ec) {
+            acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
+        }
+        if (ec) {
+            logger().error("unable to listen on port {}: {}", port, ec.message());
+            return false;
+        }
+
+        logger().info("HTTP API listening on port {}", port);
+        accept();
+        return true;
+    }
+
+    void HttpServer::accept() {
+        acceptor.async_accept([self = shared_from_this()](boost::system::error_code ec, tcp::socket socket) {
+            if (ec == boost::asio::error::operation_aborted) {
+                return;
+            }
+
+            if (ec) {
+                logger().warn("unable to accept a connection: {}", ec.message());
+            } else {
+                std::make_shared<HttpSession>(std::move(socket), self)->start();
+            }
+
+            self->accept();
+        });
+    }
+
+    void HttpServer::broadcast(const std::string &event, const std::string &data) {
+        auto formatted = formatEvent(event, data);
+        boost::asio::post(ioc, [self = shared_from_this(), formatted] {
+            // Work from a copy, since a slow client can drop itself while we're going through these
+            auto subscribers = self->subscribers;
+            for (const auto &subscriber: subscribers) {
+                subscriber->sendEvent(formatted);
+            }
+        });
+    }
+
+    void HttpServer::addSubscriber(const std::shared_ptr<HttpSession> &session) {
+        subscribers.insert(session);
+        logger().debug("event stream opened ({} listening)", subscribers.size());
+
+        // Start everyone off with where things are right now
+        for (const auto &window: windows) {
+            session->sendEvent(formatEvent("window", window->toJson()));
+        }
+    }
+
+    void HttpServer::removeSubscriber(const std::shared_ptr<HttpSession> &session) {
+        subscribers.erase(session);
+        logger().debug("event stream closed ({} listening)", subscribers.size());
+    }
+
+    std::string HttpServer::windowsJson() const {
+        std::string json = "[";
+        for (std::size_t i = 0; i < windows.size(); i++) {
+            if (i > 0) {
+                json += ",";
+            }
+            json += windows[i]->toJson();
+        }
+        json += "]";
+        return json;
+    }
+
+    std::string HttpServer::statsJson() const {
+        std::string json = R"({"threads":[)";
+        bool first = true;
+        for (const auto &thread: threading::cpuTimes()) {
+            json += fmt::format(R"({}{{"name":"{}","cpuUs":{},"running":{}}})", first ? "" : ",",
+                                thread.name, thread.cpu.count(), thread.running);
+            first = false;
+        }
+
+        json += R"(],"bus":{)";
+        for (std::size_t i = 0; i < trafficClassCount; i++) {
+            auto trafficClass = static_cast<TrafficClass>(i);
+            auto stats = transmitScheduler->getStats(trafficClass);
+            auto waits = transmitScheduler->getWaitHistogram(trafficClass);
+            json += fmt::format(R"({}"{}":{{"depth":{},"highWater":{},"sent":{},"dropped":{},"rejected":{},)"
+                                R"("expired":{},"coalesced":{},"waitP99Ms":{}}})",
+                                i == 0 ? "" : ",", trafficClassName(trafficClass), stats.depth, stats.highWater,
+                                waits.count, stats.dropped, stats.rejected, stats.expired, stats.coalesced,
+                                waits.percentile(99).count());
+        }
+
+        auto pacing = busPacer->getStats();
+        json += fmt::format(R"(}},"pacing":{{"rttUs":{},"rttVarianceUs":{},"gapUs":{},"utilizationPercent":{:.1f},)"
+                            R"("sent":{},"replies":{},"busy":{},"unanswered":{}}}}})",
+                            pacing.rtt.count(), pacing.rttVariance.count(), pacing.gap.count(), pacing.utilization,
+                            pacing.sent, pacing.replies, pacing.busy, pacing.unanswered);
+        return json;
+    }
+
+    http::response<http::string_body> HttpServer::handle(const http::request<http::string_body> &request) {
+
+        auto respond = [&request](http::status status, std::string body) {
+            http::response<http::string_body> response{status, request.version()};
+            response.set(http::field::server, "andersen-mqtt");
+            response.set(http::field::content_type, "application/json");
+            response.keep_alive(request.keep_alive());
+            response.body() = std::move(body);
+            response.prepare_payload();
+            return response;
+        };
+
+        std::string target(request.target());
+        logger().debug("{} {}", std::string(request.method_string()), target);
+
+        if (target == "/stats") {
+            if (request.method() != http::verb::get) {
+                return respond(http::status::method_not_allowed, R"({"error":"use GET"})");
+            }
+            return respond(http::status::ok, statsJson());
+        }
+
+        if (target == "/windows") {
+            if (request.method() != http::verb::get) {
+                return respond(http::status::method_not_allowed, R"({"error":"use GET"})");
+            }
+            return respond(http::status::ok, windowsJson());
+        }
+
+        // POST /windows/{name}/{command}
+        auto slash = target.find('/', windowsPrefix.size());
+        if (!target.starts_with(windowsPrefix) || slash == std::string::npos) {
+            return respond(http::status::not_found, R"({"error":"not found"})");
+        }
+
+        if (request.method() != http::verb::post) {
+            return respond(http::status::method_not_allowed, R"({"error":"use POST"})");
+        }
+
+        std::string name = target.substr(windowsPrefix.size(), slash - windowsPrefix.size());
+        std::string action = target.substr(slash + 1);
+
+        uint8_t command;
+        if (action == "open") {
+            command = CMD_OPEN;
+        } else if (action == "close") {
+            command = CMD_CLOSE;
+        } else if (action == "stop") {
+            command = CMD_STOP;
+        } else {
+            return respond(http::status::not_found, R"({"error":"unknown command"})");
+        }
+
+        for (const auto &window: windows) {
+            if (window->getName() == name) {
+                logger().info("{} window {} (from HTTP)", action, name);
+                // Nobody's listening for results, but the tracker still has to know so ACKs line up. It
+                // hears about it before the frame is queued, so the frame can't go out ahead of it.
+                auto tag = commandTracker->newTag();
+                commandTracker->track(tag, {action, "", std::chrono::milliseconds(60000)},
+                                      CommandTracker::targets({{window, command}}), 1, nullptr);
+                auto result = transmitScheduler->enqueue(window->createCommand(command), TrafficClass::Command, tag);
+                if (result != EnqueueResult::Queued) {
+                    commandTracker->onDropped(tag);
+                    return respond(http::status::service_unavailable, R"({"error":"the bus is backed up, try again"})");
+                }
+                transmitScheduler->enqueue(
+                        CommandCompiler::createFrame(window->getPanel(), WINDOW_ALL, CMD_STATUS_WITHOUT_POLL),
+                        TrafficClass::ConfirmPoll);
+                return respond(http::status::accepted,
+                               R"({"window":")" + name + R"(","command":")" + action + R"(","status":"queued"})");
+            }
+        }
+
+        return respond(http::status::not_found, R"({"error":"unknown window"})");
+    }
+
+
+    HttpSession::HttpSession(tcp::socket socket, std::shared_ptr<HttpServer> server)
+            : stream(std::move(socket)), server(std::move(server)) {}
+
+    void HttpSession::start() {
+        read();
+    }
+
+    void HttpSession::read() {
+        request = {};
+        stream.expires_after(idleTimeout);
+        http::async_read(stream, buffer, request,
+                         beast::bind_front_handler(&HttpSession::onRead, shared_from_this()));
+    }
+
+    void HttpSession::onRead(beast::error_code ec, std::size_t) {
+
+        // The client is done with us, or went quiet
+        if (ec) {
+            close();
+            return;
+        }
+
+        if (request.method() == http::verb::get && request.target() == "/events") {
+            startEvents();
+            return;
+        }
+
+        response = std::make_shared<http::response<http::string_body>>(server->handle(request));
+        http::async_write(stream, *response,
+                          beast::bind_front_handler(&HttpSession::onWrite, shared_from_this(), response->need_eof()));
+    }
+
+    void HttpSession::onWrite(bool closeAfter, beast::error_code ec, std::size_t) {
+        if (ec || closeAfter) {
+            close();
+            return;
+        }
+
+        response.reset();
+        read();
+    }
+
+    void HttpSession::startEvents() {
+        streaming = true;
+        stream.expires_never();
+
+        sendEvent(std::make_shared<const std::string>(
+                "HTTP/1.1 200 OK\r\n"
+                "Server: andersen-mqtt\r\n"
+                "Content-Type: text/event-stream\r\n"
+                "Cache-Control: no-cache\r\n"
+                "Connection: keep-alive\r\n"
+                "\r\n"));
+        server->addSubscriber(shared_from_this());
+
+        // Keep a read going so we notice when the client hangs up. We don't care what they send.
+        stream.async_read_some(buffer.prepare(512), [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) {
+                self->close();
+            }
+        });
+    }
+
+    void HttpSession::sendEvent(std::shared_ptr<const std::string> event) {
+        if (!streaming) {
+            return;
+        }
+
+        if (pendingEvents.size() >= maxPendingEvents) {
+            logger().warn("an event stream client isn't keeping up, dropping it");
+            close();
+            return;
+        }
+
+        pendingEvents.push_back(std::move(event));
+        if (!writing) {
+            writeNextEvent();
+        }
+    }
+
+    void HttpSession::writeNextEvent() {
+        if (pendingEvents.empty() || !streaming) {
+            writing = false;
+            return;
+        }
+
+        writing = true;
+        boost::asio::async_write(stream, boost::asio::buffer(*pendingEvents.front()),
+                                 [self = shared_from_this()](beast::error_code ec, std::size_t) {
+                                     if (ec) {
+                                         self->close();
+                                         return;
+                                     }
+                                     self->pendingEvents.pop_front();
+                                     self->writeNextEvent();
+                                 });
+    }
+
+    void HttpSession::close() {
+        if (streaming) {
+            streaming = false;
+            server->removeSubscriber(shared_from_this());
+        }
+
+        beast::error_code ec;
+        stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+        stream.socket().close(ec);
+    }
+
+} // creatures
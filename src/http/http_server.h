@@ -0,0 +1,115 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_HTTP_SERVER_H
+#define ANDERSEN_MQTT_HTTP_SERVER_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include "window/window.h"
+
+namespace creatures {
+
+    class HttpSession;
+
+    /**
+     * A small HTTP API for things on the LAN that would rather not go through the broker.
+     *
+     *   GET  /windows                       current state of every window
+     *   POST /windows/{name}/open|close|stop  send a command straight to the bus
+     *   GET  /events                        Server-Sent Events, one per window state change
+     *   GET  /stats                         per-thread CPU time and bus queue gauges
+     *
+     * It runs on an existing io_context (the MQTT one), so every connection is just a few
+     * async operations on that thread, no matter how many there are.
+     */
+    class HttpServer : public std::enable_shared_from_this<HttpServer> {
+
+    public:
+        HttpServer(boost::asio::io_context &ioc, uint16_t port, std::vector<std::shared_ptr<Window>> windows);
+
+        /**
+         * Starts listening
+         *
+         * @return false if we couldn't bind the port
+         */
+        bool start();
+
+        /**
+         * Sends an event to everyone on /events. Safe to call from any thread.
+         */
+        void broadcast(const std::string &event, const std::string &data);
+
+    private:
+        friend class HttpSession;
+
+        void accept();
+
+        std::string windowsJson() const;
+        std::string statsJson() const;
+        boost::beast::http::response<boost::beast::http::string_body> handle(
+                const boost::beast::http::request<boost::beast::http::string_body> &request);
+
+        // Only touched on the io thread
+        void addSubscriber(const std::shared_ptr<HttpSession> &session);
+        void removeSubscriber(const std::shared_ptr<HttpSession> &session);
+
+        boost::asio::io_context &ioc;
+        boost::asio::ip::tcp::acceptor acceptor;
+        uint16_t port;
+
+        std::vector<std::shared_ptr<Window>> windows;
+        std::set<std::shared_ptr<HttpSession>> subscribers;
+    };
+
+
+    /**
+     * One connection. Handles keep-alive requests until the client goes away, or turns into
+     * an event stream if it asks for /events.
+     */
+    class HttpSession : public std::enable_shared_from_this<HttpSession> {
+
+    public:
+        HttpSession(boost::asio::ip::tcp::socket socket, std::shared_ptr<HttpServer> server);
+
+        void start();
+
+        /**
+         * Queues an already formatted event for this stream. Only call this on the io thread.
+         */
+        void sendEvent(std::shared_ptr<const std::string> event);
+
+    private:
+        void read();
+        void onRead(boost::beast::error_code ec, std::size_t bytes);
+        void onWrite(bool close, boost::beast::error_code ec, std::size_t bytes);
+
+        void startEvents();
+        void writeNextEvent();
+        void close();
+
+        boost::beast::tcp_stream stream;
+        boost::beast::flat_buffer buffer;
+        boost::beast::http::request<boost::beast::http::string_body> request;
+        std::shared_ptr<boost::beast::http::response<boost::beast::http::string_body>> response;
+        std::shared_ptr<HttpServer> server;
+
+        // Event stream state
+        bool streaming = false;
+        bool writing = false;
+        std::deque<std::shared_ptr<const std::string>> pendingEvents;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_HTTP_SERVER_H
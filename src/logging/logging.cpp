@@ -0,0 +1,190 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include <spdlog/async.h>
+#include <spdlog/async_logger.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include "logging.h"
+
+namespace creatures::logging {
+
+    namespace {
+
+        std::mutex loggingMutex;
+
+        std::shared_ptr<spdlog::details::thread_pool> threadPool;
+        std::size_t queueSize = 0;
+        spdlog::sink_ptr consoleSink;
+        spdlog::async_overflow_policy overflowPolicy = spdlog::async_overflow_policy::overrun_oldest;
+
+        spdlog::level::level_enum defaultLevel = spdlog::level::trace;
+        std::unordered_map<std::string, spdlog::level::level_enum> componentLevels;
+
+        std::optional<spdlog::level::level_enum> parseLevel(const std::string &level) {
+            if (level == "warning") {
+                return spdlog::level::warn;
+            }
+            if (level == "error") {
+                return spdlog::level::err;
+            }
+
+            // from_str() hands back "off" for anything it doesn't know, so check for that
+            auto parsed = spdlog::level::from_str(level);
+            if (parsed == spdlog::level::off && level != "off") {
+                return std::nullopt;
+            }
+            return parsed;
+        }
+
+        spdlog::async_overflow_policy parseOverflowPolicy(const std::string &policy) {
+            if (policy == "block") {
+                return spdlog::async_overflow_policy::block;
+            }
+            return spdlog::async_overflow_policy::overrun_oldest;
+        }
+
+        // "window=info,mqtt_cpp=warn" -> {window: info, mqtt_cpp: warn}
+        void parseComponentLevels(const std::string &levels) {
+            std::istringstream iss(levels);
+            std::string entry;
+            while (std::getline(iss, entry, ',')) {
+                auto equals = entry.find('=');
+                if (equals == std::string::npos) {
+                    continue;
+                }
+                auto level = parseLevel(entry.substr(equals + 1));
+                if (level) {
+                    componentLevels[entry.substr(0, equals)] = *level;
+                }
+            }
+        }
+
+        // Caller must hold loggingMutex
+        std::shared_ptr<spdlog::logger> makeLogger(const std::string &component) {
+            auto logger = std::make_shared<spdlog::async_logger>(component, consoleSink, threadPool, overflowPolicy);
+
+            auto level = componentLevels.find(component);
+            logger->set_level(level != componentLevels.end() ? level->second : defaultLevel);
+
+            // Make sure the bad stuff gets out even if we're about to fall over
+            logger->flush_on(spdlog::level::err);
+
+            spdlog::register_logger(logger);
+            return logger;
+        }
+
+        // Caller must hold loggingMutex
+        void initLocked(const Configuration &config) {
+
+            overflowPolicy = parseOverflowPolicy(config.getLogOverflowPolicy());
+            defaultLevel = parseLevel(config.getLogLevel()).value_or(spdlog::level::trace);
+            parseComponentLevels(config.getLogLevels());
+
+            // One thread does all the console I/O. The queue is bounded, and the overflow policy
+            // decides if a slow reader costs us messages or costs us latency.
+            //
+            // This only happens once. Components hang on to their loggers, and a logger only has
+            // a weak_ptr to its pool, so swapping in a new one would leave them all logging into
+            // nothing. Everything after the first time just gets retuned: the levels
+            // change right away, the overflow policy only for loggers made after this.
+            if (!threadPool) {
+                queueSize = config.getLogQueueSize();
+                threadPool = std::make_shared<spdlog::details::thread_pool>(queueSize, 1);
+                consoleSink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+            }
+
+            spdlog::apply_all([](const std::shared_ptr<spdlog::logger> &logger) {
+                auto level = componentLevels.find(logger->name());
+                logger->set_level(level != componentLevels.end() ? level->second : defaultLevel);
+            });
+
+            // Make the default logger ours so the free functions go through the queue too
+            auto mainLogger = spdlog::get("main");
+            if (!mainLogger) {
+                mainLogger = makeLogger("main");
+            }
+            spdlog::set_default_logger(mainLogger);
+
+            if (config.getLogQueueSize() != queueSize) {
+                mainLogger->warn("something logged before the logging was set up, so the queue is staying at {} records, not {}",
+                                 queueSize, config.getLogQueueSize());
+            }
+        }
+
+    }
+
+    void init(const Configuration &config) {
+        std::lock_guard<std::mutex> lock(loggingMutex);
+        initLocked(config);
+    }
+
+    std::shared_ptr<spdlog::logger> get(const std::string &component) {
+        if (auto logger = spdlog::get(component)) {
+            return logger;
+        }
+
+        std::lock_guard<std::mutex> lock(loggingMutex);
+
+        // Someone asked before init(), so set things up with the defaults
+        if (!threadPool) {
+            initLocked(Configuration());
+        }
+
+        // Another thread might have beat us here
+        if (auto logger = spdlog::get(component)) {
+            return logger;
+        }
+        return makeLogger(component);
+    }
+
+    bool setLevel(const std::string &component, const std::string &level) {
+        auto parsed = parseLevel(level);
+        if (!parsed) {
+            return false;
+        }
+
+        // This comes in over MQTT, so only touch loggers we already have. Otherwise anyone on
+        // the broker could have us making new ones forever.
+        auto logger = spdlog::get(component);
+        if (!logger) {
+            return false;
+        }
+
+        // Make sure it sticks if the logger gets made again (init() does that to "main")
+        {
+            std::lock_guard<std::mutex> lock(loggingMutex);
+            componentLevels[component] = *parsed;
+        }
+
+        logger->set_level(*parsed);
+        return true;
+    }
+
+    bool exists(const std::string &component) {
+        return spdlog::get(component) != nullptr;
+    }
+
+    std::size_t droppedMessages() {
+        std::lock_guard<std::mutex> lock(loggingMutex);
+        if (!threadPool) {
+            return 0;
+        }
+        return threadPool->overrun_counter();
+    }
+
+    void shutdown() {
+        spdlog::shutdown();
+
+        std::lock_guard<std::mutex> lock(loggingMutex);
+        threadPool.reset();
+    }
+
+} // creatures::logging
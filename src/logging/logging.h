@@ -0,0 +1,83 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_LOGGING_H
+#define ANDERSEN_MQTT_LOGGING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+#include "config/config.h"
+
+namespace creatures::logging {
+
+    /**
+     * Sets up the async console pipeline. Every logger hands its records to a bounded queue
+     * that a single background thread drains, so the bus and MQTT threads never wait on
+     * stdout (or on whoever is on the other end of `docker logs`).
+     *
+     * The default logger (what the plain `debug()` and friends use) becomes the "main" component.
+     *
+     * The pipeline is only made once. Calling this again (or after something already logged)
+     * just sets the levels again, and keeps the loggers everyone already has working.
+     */
+    void init(const Configuration &config);
+
+    /**
+     * Gets the logger for a component, making it on the async pipeline if this is the first
+     * time anyone has asked for it.
+     */
+    std::shared_ptr<spdlog::logger> get(const std::string &component);
+
+    /**
+     * A component's name, as something that can be a template argument
+     */
+    template<std::size_t N>
+    struct ComponentName {
+        constexpr ComponentName(const char (&name)[N]) { std::copy_n(name, N, value); }
+        char value[N];
+    };
+
+    /**
+     * The logger for a component, looked up the first time and kept after that, so logging
+     * from a hot path doesn't go through spdlog's registry (and its lock) every time.
+     *
+     *     logging::component<"bus">().debug("...");
+     *
+     * init() keeps the same loggers working, so it's fine to hang on to these.
+     */
+    template<ComponentName Name>
+    spdlog::logger &component() {
+        static auto logger = get(Name.value);
+        return *logger;
+    }
+
+    /**
+     * Changes the level of one component while we're running. Returns false if the level
+     * isn't one spdlog knows about, or if nothing has made a logger for the component yet.
+     */
+    bool setLevel(const std::string &component, const std::string &level);
+
+    /**
+     * Has anything made a logger for this component yet?
+     */
+    bool exists(const std::string &component);
+
+    /**
+     * How many records were thrown away because the queue was full
+     */
+    std::size_t droppedMessages();
+
+    /**
+     * Drains the queue and stops the console thread
+     */
+    void shutdown();
+
+} // creatures::logging
+
+#endif //ANDERSEN_MQTT_LOGGING_H
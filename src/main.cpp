@@ -1,258 +1,337 @@
 
+#include <algorithm>
+#include <array>
 #include <csignal>
 #include <sstream>
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
 #include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <stop_token>
+#include <sys/socket.h>
 #include <unistd.h>
 #include <string>
 #include <iomanip>
 #include <iostream>
 
-// spdlog
-#include "spdlog/sinks/stdout_color_sinks.h"
-
 #include <nlohmann/json.hpp>
 
 #include "namespace-stuffs.h"
 
+#include "bus/bus_pacer.h"
+#include "bus/gateway_watchdog.h"
+#include "bus/transmit_scheduler.h"
+#include "capture/capture.h"
+#include "capture/replay.h"
+#include "config/config.h"
+#include "http/http_server.h"
+#include "logging/logging.h"
+#include "mqtt/command_tracker.h"
+#include "mqtt/leader_election.h"
 #include "mqtt/mqtt.h"
 #include "mqtt/log_wrapper.h"
+#include "processor/processor.h"
+#include "rules/rule_engine.h"
+#include "shm/shared_state.h"
+#include "startup/startup.h"
+#include "state/state_history.h"
+#include "state/state_snapshot.h"
+#include "threading/threading.h"
+#include "tracing/allocations.h"
+#include "tracing/tracing.h"
 #include "socket/socket.h"
+#include "window/framer.h"
 #include "window/window.h"
 
 #include "blockingconcurrentqueue.h"
 
 
-// Old school pointer so the signal handler knows what to do
-creatures::MQTTClient* mqttClient = nullptr;
-std::atomic<bool> keepRunning(true);
+// Anyone can ask for the whole daemon to shut down with this (signals, a dead gateway, etc)
+std::stop_source shutdownSource;
 
-std::shared_ptr<moodycamel::BlockingConcurrentQueue<std::vector<uint8_t>>> outgoingSocketMessages;
+// Everything else the threads share (the windows, the brokers, and so on) is in processor/processor.h
 std::shared_ptr<moodycamel::BlockingConcurrentQueue<std::vector<uint8_t>>> incomingSocketMessages;
 
-
-std::shared_ptr<creatures::Window> window1;
-std::shared_ptr<creatures::Window> window2;
-std::shared_ptr<creatures::Window> window3;
-std::shared_ptr<creatures::Window> window4;
-
-extern "C" void signalHandler(int signalNumber) {
-    if (signalNumber == SIGINT) {
-
-        std::cerr << "Exiting..." << std::endl;
-
-        // Stop the serial reader
-        keepRunning = false;
-
-        // Stop the MQTT client
-        if (mqttClient) {
-            mqttClient->stop();
+// Frame buffers the processor is done with, so the reader can fill them again instead of allocating
+std::shared_ptr<moodycamel::ConcurrentQueue<std::vector<uint8_t>>> spareFrames;
+
+// Only set if we've been asked to record the wire
+std::unique_ptr<creatures::CaptureWriter> wireCapture;
+
+// The gateway connection, once we have one, so losing the leader lock can cut it off right away
+std::atomic<int> gatewaySocket = -1;
+
+// With failover, how long a leader that can't reach the gateway stays out of the running. It
+// doubles every time, in case it's the gateway that's gone and not just our way to it.
+constexpr auto gatewayRetryDelay = std::chrono::milliseconds(1000);
+constexpr auto maxGatewayRetryDelay = std::chrono::milliseconds(60000);
+
+/**
+ * Tells every broker whether the gateway is there. Every window's status comes back in the same
+ * frame, so they come and go with it.
+ */
+void setAvailability(bool online) {
+    for (const auto &mqttClient: mqttClients) {
+        mqttClient->setAvailability(nullptr, online);
+        for (const auto &window: {window1, window2, window3, window4}) {
+            mqttClient->setAvailability(window, online);
         }
-
     }
 }
 
-// Helper to join strings for logging
-std::string joinStrings(const std::vector<std::string>& strings, const std::string& delimiter = ", ") {
-    std::ostringstream oss;
-    for (size_t i = 0; i < strings.size(); ++i) {
-        oss << strings[i];
-        if (i < strings.size() - 1) {
-            oss << delimiter;
+/**
+ * Waits for SIGINT (Ctrl-C) or SIGTERM (`docker stop`). These are blocked in every thread, so
+ * this is the only place they show up, and we don't have to do anything clever in a signal handler.
+ */
+void signal_thread(std::stop_token stopToken, sigset_t signals) {
+    creatures::threading::setup("signals");
+
+    // If we're asked to stop some other way, poke ourselves so sigwait() comes back
+    std::stop_callback wakeup(stopToken, [self = pthread_self()] {
+        pthread_kill(self, SIGTERM);
+    });
+
+    int signalNumber = 0;
+    while (!stopToken.stop_requested()) {
+        if (sigwait(&signals, &signalNumber) != 0 || stopToken.stop_requested()) {
+            continue;
         }
+
+        info("received {}, exiting...", strsignal(signalNumber));
+        shutdownSource.request_stop();
+        return;
     }
-    return oss.str();
 }
 
-void reader_thread(int socket_fd) {
-    std::vector<uint8_t> buffer; // Persistent buffer for accumulating bytes
-    while (keepRunning) {
-        std::vector<uint8_t> tempBuffer(1024); // Temporary buffer for reading
+void reader_thread(std::stop_token stopToken, int socket_fd, std::size_t incomingLimit) {
+    creatures::threading::setup("reader");
+
+    // Complete frames go straight onto the incoming queue. If processing has fallen that far
+    // behind, the oldest frames are the least interesting ones, so those go.
+    uint64_t dropped = 0;
+    creatures::Framer framer([incomingLimit, &dropped](const uint8_t *frame, size_t size) {
+        std::vector<uint8_t> stale;
+        while (incomingSocketMessages->size_approx() >= incomingLimit && incomingSocketMessages->try_dequeue(stale)) {
+            if (dropped++ == 0) {
+                warn("processing has fallen behind the gateway, dropping old frames");
+            }
+            spareFrames->enqueue(std::move(stale));
+        }
+        // The pacer wants to know the moment the panel answers, not when we get around to it
+        busPacer->replyReceived(size, size > 2 && frame[2] == 0x27);
+
+        // Once things settle down there's always a buffer the processor has given back
+        std::vector<uint8_t> message;
+        spareFrames->try_dequeue(message);
+        message.assign(frame, frame + size);
+
+        incomingSocketMessages->enqueue(std::move(message));
+        TRACE_PLOT("incoming queue", incomingSocketMessages->size_approx());
+    });
+
+    std::array<uint8_t, 1024> tempBuffer{}; // Temporary buffer for reading
+    while (!stopToken.stop_requested()) {
         ssize_t bytes_received = recv(socket_fd, tempBuffer.data(), tempBuffer.size(), 0);
 
         debug("Received {} bytes", bytes_received);
 
         if (bytes_received <= 0) {
-            std::cerr << "Connection closed or error occurred\n";
-            error("Connection closed or error occurred");
-            keepRunning = false;
+            // We expect this when we're shutting down, since that's how recv() gets unblocked
+            if (!stopToken.stop_requested()) {
+                error("Connection closed or error occurred");
+                shutdownSource.request_stop();
+            }
             break;
         }
 
-        // Append newly received bytes to the persistent buffer
-        buffer.insert(buffer.end(), tempBuffer.begin(), tempBuffer.begin() + bytes_received);
-
-        // Process complete messages
-        while (!buffer.empty()) {
-            // Synchronize to the header byte (0xFF)
-            auto it = std::find(buffer.begin(), buffer.end(), 0xFF);
-            if (it != buffer.begin()) {
-                if (it == buffer.end()) {
-                    debug("No valid header found. Clearing buffer.");
-                    buffer.clear();
-                    break;
-                }
-                debug("Synchronizing buffer. Removing {} invalid bytes.", std::distance(buffer.begin(), it));
-                buffer.erase(buffer.begin(), it); // Remove invalid bytes
-            }
+        TRACE_ZONE("reader: framing");
+        TRACE_ZONE_VALUE(bytes_received);
 
-            // Ensure we have enough bytes to determine the message type (at least 3 bytes)
-            if (buffer.size() < 3) {
-                debug("Not enough bytes to determine message type. Waiting for more data...");
-                break;
-            }
+        if (wireCapture) {
+            wireCapture->record(creatures::CaptureDirection::Received, tempBuffer.data(), bytes_received);
+        }
 
-            // Determine the expected message size
-            size_t expectedSize = 0;
-            uint8_t messageType = buffer[2]; // Assuming the third byte is the message type
-
-            if (messageType == CMD_STATUS_WITHOUT_POLL || messageType == CMD_STATUS_WITH_POLL) { // STATUS message (always all windows)
-                expectedSize = 8; // Always 8 bytes for STATUS with all windows
-                debug("Detected STATUS message for all windows. Expected size: 8 bytes.");
-            } else if (messageType == 0xB1 || messageType == 0x27) { // ACK or BUSY
-                expectedSize = 5;
-                debug("Detected ACK or BUSY message. Expected size: 5 bytes.");
-            } else {
-                debug("Unknown message type: 0x{:02X}. Discarding header byte.", messageType);
-                buffer.erase(buffer.begin()); // Remove the header and try again
-                continue;
-            }
+        framer.feed(tempBuffer.data(), bytes_received);
+    }
 
-            // If we don't have enough bytes for the full message, wait for more
-            if (buffer.size() < expectedSize) {
-                debug("Not enough bytes yet. Expected {}, but have {}.", expectedSize, buffer.size());
-                break;
-            }
+    if (dropped > 0) {
+        warn("dropped {} frames from the gateway since processing couldn't keep up", dropped);
+    }
+}
 
-            // Extract the full message
-            std::vector<uint8_t> message(buffer.begin(), buffer.begin() + expectedSize);
+void send_message(int socket_fd, const std::vector<uint8_t> &message) {
+    TRACE_ZONE("send_message");
+    TRACE_ZONE_VALUE(message.size() > 2 ? message[2] : 0);  // Which window, for commands
+    if(!message.empty()) {
+        debug("Sending message of size {}", message.size());
+        busPacer->sent(message.size());
+        // If the gateway was cut off under us, that's an error back, not a SIGPIPE
+        send(socket_fd, message.data(), message.size(), MSG_NOSIGNAL); // Send binary data
+        creatures::startup::mark("first frame sent");
+
+        if (wireCapture) {
+            wireCapture->record(creatures::CaptureDirection::Sent, message.data(), message.size());
+        }
+    }
+    else
+        debug("No message to send");
+}
 
-            // Debug: Log the full message being processed
-            debug("Processing full message: [{}]", joinStrings(creatures::Window::bytesToHexStrings(message)));
+// How long the writer gets to send what's left once we're shutting down
+constexpr auto writerDrainLimit = std::chrono::milliseconds(2000);
 
-            // Create a slice of the message that excludes the checksum byte
-            std::vector<uint8_t> messageWithoutChecksum(message.begin(), message.end());
+void writer_thread(std::stop_token stopToken, int socket_fd) {
+    creatures::threading::setup("writer");
 
-            // Validate the checksum
-            if (!creatures::Window::validateChecksum(messageWithoutChecksum)) {
-                debug("Checksum validation failed. Message: [{}], Calculated checksum: 0x{:x}, Provided checksum: 0x{:x}",
-                      joinStrings(creatures::Window::bytesToHexStrings(messageWithoutChecksum)),
-                      creatures::Window::calculateChecksum(messageWithoutChecksum),
-                      message.back());
-                std::cerr << "Invalid checksum received. Discarding message.\n";
-                buffer.erase(buffer.begin(), buffer.begin() + expectedSize); // Remove processed bytes
-                continue;
-            }
+    std::vector<uint8_t> message;
+    creatures::FrameInfo info;
+    while (transmitScheduler->waitDequeue(message, stopToken, &info)) {
+        if (!busPacer->waitForSlot(stopToken)) {
 
-            // Log the valid message
-            debug("Valid message received: [{}]", joinStrings(creatures::Window::bytesToHexStrings(message)));
+            // We're stopping, and the panel might still be talking. Commands get another go with
+            // the rest below, and a poll isn't worth it anymore.
+            if (info.trafficClass <= creatures::TrafficClass::Command) {
+                transmitScheduler->putBack(std::move(message), info);
+            }
+            break;
+        }
 
-            // Enqueue the valid message
-            incomingSocketMessages->enqueue(std::move(message));
+        // The controller answers in the order frames go out, which isn't always the order they were queued in
+        if (info.tag != 0) {
+            commandTracker->onSent(info.tag);
+        }
+        send_message(socket_fd, message);
 
-            // Remove the processed message from the buffer
-            buffer.erase(buffer.begin(), buffer.begin() + expectedSize);
+        // The reply clock starts now, not when the poll was queued
+        if (message.size() > 3 && message[3] == CMD_STATUS_WITHOUT_POLL) {
+            gatewayWatchdog->pollSent();
         }
     }
-}
 
-void writer_thread(int socket_fd) {
-    while (keepRunning) {
-        std::vector<uint8_t> message;
-        if (outgoingSocketMessages->wait_dequeue_timed(message, std::chrono::seconds(1))) {
-            if(!message.empty()) {
-                debug("Sending message of size {}", message.size());
-                send(socket_fd, message.data(), message.size(), 0); // Send binary data
-            }
-            else
-                debug("No message to send");
+    // Don't leave any commands behind. These still get paced, the panel doesn't care that we're leaving,
+    // but nobody will be around for the answer to a poll, and there's only so long we can wait.
+    auto deadline = std::chrono::steady_clock::now() + writerDrainLimit;
+    while (transmitScheduler->tryDequeue(message, creatures::TrafficClass::Command, &info)) {
+        if (!busPacer->waitForSlot(deadline)) {
+            warn("ran out of time to send what was queued");
+            break;
         }
+        if (info.tag != 0) {
+            commandTracker->onSent(info.tag);
+        }
+        send_message(socket_fd, message);
+    }
+
+    if (auto discarded = transmitScheduler->discard()) {
+        debug("left {} frames unsent on the way out", discarded);
     }
 }
 
-void process_message_thread() {
+void process_message_thread(std::stop_token stopToken, bool forceFirstPublish) {
+    creatures::threading::setup("processor");
 
-    // Force a publish the first time around
-    bool firstRun = true;
+    // An empty message wakes the wait below when it's time to go
+    std::stop_callback wakeup(stopToken, [] {
+        incomingSocketMessages->enqueue({});
+    });
 
-    while (keepRunning) {
-        std::vector<uint8_t> message;
+    // Force a publish the first time around, unless the saved state already went out
+    bool firstRun = forceFirstPublish;
+
+    std::vector<uint8_t> message;
+    while (!stopToken.stop_requested()) {
 
         // Block until a new message is available in the queue
         incomingSocketMessages->wait_dequeue(message);
+        TRACE_PLOT("incoming queue", incomingSocketMessages->size_approx());
 
-        // Log the received message
-        debug("Processing message: [{}]", joinStrings(creatures::Window::bytesToHexStrings(message)));
-
-        // Ensure the message has at least 3 bytes (enough to determine the type)
-        if (message.size() < 3) {
-            error("Message too short: {} bytes. Ignoring.", message.size());
-            continue;
+        if (!message.empty()) {
+            process_message(message, firstRun);
         }
 
-        // Determine the message type
-        uint8_t messageType = message[2];
+        // Give the buffer back to the reader. This leaves message empty, so the next wait has nothing to free.
+        spareFrames->enqueue(std::move(message));
+    }
+
+    // Finish up anything the reader already handed us so the last state makes it out
+    while (incomingSocketMessages->try_dequeue(message)) {
+        if (!message.empty()) {
+            process_message(message, firstRun);
+        }
+    }
+}
 
-        switch (messageType) {
-            case 0x5C: { // STATUS message
-                debug("Detected STATUS message.");
+/**
+ * Runs a capture back through the framer, the windows, and the publish path instead of
+ * talking to a real gateway. Handy for chasing bugs from the field and for benchmarking.
+ */
+int replay_capture(const creatures::Configuration &config) {
 
-                // Ensure the message is the correct size for a STATUS message
-                if (message.size() != 8) {
-                    error("Invalid STATUS message size: {}. Expected 8 bytes.", message.size());
-                    break;
-                }
+    bool firstRun = true;
+    std::vector<uint8_t> message;
+
+    // When we're built to count allocations, a status that didn't change anything shouldn't make
+    // any. The first few frames get a pass, since that's when everything is finding its feet.
+    constexpr uint64_t warmupFrames = 64;
+    uint64_t handled = 0;
+    uint64_t steadyFrames = 0;
+    uint64_t steadyAllocations = 0;
+
+    creatures::Framer framer([&](const uint8_t *frame, size_t size) {
+        bool unchanged = size == 8 && frame[2] == CMD_STATUS_WITHOUT_POLL;
+        for (const auto &window: {window1, window2, window3, window4}) {
+            unchanged = unchanged && window->hasStatus() && window->getStatusByte() == frame[2 + window->getNumber()];
+        }
 
-                // Extract the window statuses
-                uint8_t window1Status = message[3];
-                uint8_t window2Status = message[4];
-                uint8_t window3Status = message[5];
-                uint8_t window4Status = message[6];
-
-                // Update the window statuses
-                window1->setStatus(window1Status);
-                window2->setStatus(window2Status);
-                window3->setStatus(window3Status);
-                window4->setStatus(window4Status);
-
-                // Log the updated statuses
-                debug("Updated window statuses");
-                debug("Window 1: {}", window1->toJson());
-                debug("Window 2: {}", window2->toJson());
-                debug("Window 3: {}", window3->toJson());
-                debug("Window 4: {}", window4->toJson());
-
-                // Publish this update on MQTT
-                mqttClient->publishWindows(firstRun);
-                firstRun = false;
-                break;
-            }
+        auto before = creatures::allocations::count();
+        message.assign(frame, frame + size);
+        process_message(message, firstRun);
 
-            case 0xB1: { // ACK message
-                debug("Detected ACK message.");
-                // Handle ACK-specific processing here
-                break;
-            }
+        if (unchanged && ++handled > warmupFrames) {
+            steadyFrames++;
+            steadyAllocations += creatures::allocations::count() - before;
+        }
+    });
 
-            case 0x27: { // BUSY message
-                debug("Detected BUSY message.");
-                // Handle BUSY-specific processing here
-                break;
-            }
+    info("replaying {} at {}", config.getReplayFile(),
+         config.getReplaySpeed() > 0 ? fmt::format("{}x", config.getReplaySpeed()) : "full speed");
 
-            default:
-                debug("Unknown message type: 0x{:02X}. Ignoring message.", messageType);
-                break;
+    // Only the gateway's side of the conversation matters here, what we sent is just for context
+    creatures::Replayer replayer(config.getReplayFile(), config.getReplaySpeed());
+    bool good = replayer.run(shutdownSource.get_token(), [&framer](creatures::CaptureDirection direction, const uint8_t *bytes, size_t size) {
+        if (direction == creatures::CaptureDirection::Received) {
+            framer.feed(bytes, size);
+        }
+    });
+
+    auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(replayer.getElapsed()).count();
+    info("replayed {} records ({} bytes) in {}us: {} frames, {} checksum errors, {} bytes discarded, {:.0f} frames/s",
+         replayer.getRecords(), replayer.getBytes(), elapsedUs, framer.getFrames(), framer.getChecksumErrors(),
+         framer.getDiscardedBytes(), elapsedUs > 0 ? framer.getFrames() * 1e6 / elapsedUs : 0.0);
+
+    if (creatures::allocations::audited) {
+        info("allocation audit: {} allocations over {} steady state frames", steadyAllocations, steadyFrames);
+        if (steadyAllocations > 0) {
+            error("handling frames that didn't change anything went to the heap, it shouldn't");
+            good = false;
         }
     }
-}
 
+    return good ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
 int main() {
 
-    std::signal(SIGINT, signalHandler);
+    // Block the signals we care about before any threads exist, so they all inherit it and
+    // the signal thread is the only one that ever sees them
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigaddset(&shutdownSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, nullptr);
 
     try {
         // Set up our locale. If this vomits, install `locales-all`
@@ -262,25 +341,41 @@ int main() {
         critical("Unable to set the locale: '{}' (Hint: Make sure package locales-all is installed!)", e.what());
         return EXIT_FAILURE;
     }
+    creatures::startup::mark("locale");
 
-    // Console logger
-    spdlog::set_level(spdlog::level::trace);
+    // Console logger. This goes through a queue so nobody waits on stdout.
+    auto config = creatures::Configuration::fromEnvironment();
+    creatures::logging::init(config);
+    creatures::startup::mark("logging");
 
     info("Welcome to Andersen to MQTT! 🪟");
 
+    // Before any of our threads exist, so they all get placed where they're supposed to be
+    creatures::threading::init(config);
+
+    std::jthread signals(signal_thread, shutdownSignals);
+
 
     // Leave some version info to be found
     debug("spdlog version {}.{}.{}", SPDLOG_VER_MAJOR, SPDLOG_VER_MINOR, SPDLOG_VER_PATCH);
     debug("fmt version {}", FMT_VERSION);
     debug("json version {}.{}.{}", NLOHMANN_JSON_VERSION_MAJOR, NLOHMANN_JSON_VERSION_MINOR, NLOHMANN_JSON_VERSION_PATCH);
 
-    // Set up our boost -> spdlog wrapper
+    // Set up our boost -> spdlog wrapper. This replaces mqtt_cpp's own console sink, so its
+    // level is set with the "mqtt_cpp" component like everything else.
     init_boost_logging();
-    MQTT_NS::setup_log();
+    creatures::startup::mark("boost logging");
 
     // Make our queues
-    outgoingSocketMessages = std::make_shared<moodycamel::BlockingConcurrentQueue<std::vector<uint8_t>>>();
+    transmitScheduler = std::make_shared<creatures::TransmitScheduler>();
+    transmitScheduler->apply(config.getBusLimits());
+
+    creatures::PacerOptions pacerOptions;
+    pacerOptions.baud = static_cast<uint32_t>(config.getBusBaud());
+    pacerOptions.minGap = std::chrono::milliseconds(config.getBusMinGap());
+    busPacer = std::make_shared<creatures::BusPacer>(pacerOptions);
     incomingSocketMessages = std::make_shared<moodycamel::BlockingConcurrentQueue<std::vector<uint8_t>>>();
+    spareFrames = std::make_shared<moodycamel::ConcurrentQueue<std::vector<uint8_t>>>();
 
     // Make the windows
     window1 = std::make_shared<creatures::Window>("window1", 1);
@@ -289,28 +384,232 @@ int main() {
     window4 = std::make_shared<creatures::Window>("window4", 4);
 
 
-    mqttClient = new creatures::MQTTClient("10.3.2.5", "1883");
-    mqttClient->addWindow(window1);
-    mqttClient->addWindow(window2);
-    mqttClient->addWindow(window3);
-    mqttClient->addWindow(window4);
+    if (!config.getSharedStateFile().empty()) {
+        sharedState = std::make_unique<creatures::SharedStateExport>(config.getSharedStateFile());
+        if (sharedState->open()) {
+            for (const auto &window: {window1, window2, window3, window4}) {
+                sharedState->addWindow(window->getName(), window->getNumber());
+            }
+        } else {
+            sharedState.reset();
+        }
+    }
+
+    // Start from what we knew last time. Not when replaying, the capture has its own story.
+    bool restored = false;
+    if (!config.getStateFile().empty() && config.getReplayFile().empty()) {
+        stateSnapshot = std::make_unique<creatures::StateSnapshot>(config.getStateFile());
+        restored = stateSnapshot->load({window1, window2, window3, window4});
+        if (restored && sharedState) {
+            uint8_t statuses[] = {window1->getStatusByte(), window2->getStatusByte(),
+                                  window3->getStatusByte(), window4->getStatusByte()};
+            sharedState->update(statuses, 4, window1->getLastPolledTime());
+        }
+    }
+
+    ruleEngine = std::make_unique<creatures::RuleEngine>();
+    for (const auto &window: {window1, window2, window3, window4}) {
+        ruleEngine->addWindow(window);
+    }
+    ruleEngine->apply(config.getRules());
+
+    if (config.getHistorySize() > 0) {
+        stateHistory = std::make_unique<creatures::StateHistory>(config.getHistorySize());
+    }
+
+    creatures::MQTTOptions mqttOptions;
+    mqttOptions.v5 = config.isMqttV5();
+    mqttOptions.receiveMaximum = config.getMqttReceiveMaximum();
+    mqttOptions.commandMaxAge = std::chrono::seconds(config.getCommandMaxAge());
+
+    creatures::PublishPolicy publishPolicy;
+    publishPolicy.apply(config.getPublishPolicy());
+
+    creatures::WindowGroups windowGroups;
+    windowGroups.applyGroups(config.getGroups());
+    windowGroups.applyScenes(config.getScenes());
+
+    auto brokers = config.getBrokers();
+
+    // With failover, we start out as a standby and follow along until the gateway is ours
+    bool failover = config.isFailover() && config.getReplayFile().empty();
+    if (failover) {
+        mqttOptions.instance = config.getInstanceName();
+        mqttOptions.standby = true;
+    }
+
+    // Every broker gets its own connection and thread, so one that's slow (or gone) can't hold up the rest.
+    // Big installs can split each broker's windows across more than one connection, too.
+    mqttOptions.shards = std::max<std::size_t>(config.getMqttShards(), 1);
+    for (const auto &broker: brokers) {
+        for (std::size_t shard = 0; shard < mqttOptions.shards; shard++) {
+            mqttOptions.shard = shard;
+            mqttOptions.name = mqttOptions.shards == 1 ? broker.name : fmt::format("{}/{}", broker.name, shard);
+            mqttOptions.clientId = shard == 0 ? "andersen-mqtt" : fmt::format("andersen-mqtt-{}", shard);
+            if (failover) {
+                // Both instances are on the same broker at once, so they can't share client ids
+                mqttOptions.clientId += "-" + config.getInstanceName();
+                mqttOptions.warmWindows = &broker == &brokers.front();
+            }
+
+            auto mqttClient = std::make_unique<creatures::MQTTClient>(broker.host, broker.port, mqttOptions);
+            mqttClient->addWindow(window1);
+            mqttClient->addWindow(window2);
+            mqttClient->addWindow(window3);
+            mqttClient->addWindow(window4);
+            mqttClient->setPublishPolicy(publishPolicy);
+            mqttClient->setGroups(windowGroups);
+            mqttClient->setPublishOnConnect(restored);
+            mqttClients.push_back(std::move(mqttClient));
+        }
+    }
+
+    // Which of us has the gateway gets worked out over the first broker's first connection
+    std::shared_ptr<creatures::LeaderElection> leaderElection;
+    if (failover) {
+        leaderElection = std::make_shared<creatures::LeaderElection>(
+                mqttClients.front()->getIoContext(), config.getInstanceName(),
+                std::chrono::milliseconds(config.getFailoverSettle()));
+        leaderElection->setCallback([](bool isLeader) {
+            if (!isLeader) {
+                // Someone else could be connecting to the gateway any moment now, and it only takes
+                // one of us. Let go of it first, then shut down the usual way.
+                int fd = gatewaySocket.exchange(-1);
+                if (fd >= 0) {
+                    shutdown(fd, SHUT_RDWR);
+                }
+                error("we're not the leader anymore, let go of the gateway and shutting down");
+                shutdownSource.request_stop();
+            }
+        });
+        mqttClients.front()->setLeaderElection(leaderElection);
+
+        // Our will only covers this instance, so if the leader's will goes off and nobody takes
+        // its place, we're the ones who have to say the gateway's gone
+        leaderElection->setAbandonedCallback([] {
+            setAvailability(false);
+        });
+    }
+
+    // Commands get followed along on the first broker's io thread, too
+    commandTracker = std::make_shared<creatures::CommandTracker>(mqttClients.front()->getIoContext());
+    commandTracker->setDuplicateWindow(std::chrono::milliseconds(config.getCommandDedupe()));
+
+    // A frame that never makes it onto the bus never gets an ACK, so the tracker has to hear about those
+    transmitScheduler->setDropCallback([](creatures::TrafficClass, uint64_t tag) {
+        commandTracker->onDropped(tag);
+    });
+
+    // ...and so does keeping an eye on whether the gateway is still answering
+    gatewayWatchdog = std::make_shared<creatures::GatewayWatchdog>(
+            mqttClients.front()->getIoContext(), static_cast<uint32_t>(config.getGatewayMissedPolls()),
+            std::chrono::milliseconds(config.getGatewayReplyTimeout()));
+    gatewayWatchdog->setCallback([](bool online) {
+        setAvailability(online);
+        if (httpServer) {
+            nlohmann::json event = {{"window", "gateway"}, {"online", online}};
+            httpServer->broadcast("availability", event.dump());
+        }
+    });
+
+    // The HTTP API shares the first broker's io thread, so set it up before that gets going
+    if (config.getHttpPort() != 0) {
+        httpServer = std::make_shared<creatures::HttpServer>(mqttClients.front()->getIoContext(), config.getHttpPort(),
+                                                             std::vector{window1, window2, window3, window4});
+        if (!httpServer->start()) {
+            httpServer.reset();
+        }
+    }
+
+    // Connecting to the brokers happens on their own threads, so the gateway connect below
+    // runs at the same time instead of after
+    for (const auto &mqttClient: mqttClients) {
+        mqttClient->start();
+    }
+    creatures::startup::mark("mqtt started");
+
+    // Playing back a capture? Then there's no gateway to talk to.
+    if (!config.getReplayFile().empty()) {
 
-    mqttClient->start();
+        // Give the brokers a moment so the first frames actually get published
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::any_of(mqttClients.begin(), mqttClients.end(), [](const auto &c) { return !c->isConnected(); }) &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
 
+        int result = replay_capture(config);
+        creatures::MQTTClient::stopAll(mqttClients);
+        signals.request_stop();
+        signals.join();
+        creatures::logging::shutdown();
+        return result;
+    }
 
-    const char* host = "10.3.2.5";
-    int port = 6000;
+    // Only one of us can be talking to the gateway, so wait our turn. If it's ours and the gateway
+    // won't have us, let the lock go for a while so someone else can try.
+    int socket_fd = -1;
+    auto retryDelay = gatewayRetryDelay;
+    while (socket_fd < 0) {
+        if (leaderElection) {
+            info("{} is on standby until the gateway is ours", config.getInstanceName());
+            if (!leaderElection->waitUntilLeader(shutdownSource.get_token())) {
+                creatures::MQTTClient::stopAll(mqttClients);
+                signals.request_stop();
+                signals.join();
+                creatures::logging::shutdown();
+                return 0;
+            }
+        }
 
-    int socket_fd = connect_to_server(host, port);
-    if (socket_fd < 0) {
-        return 1;
+        socket_fd = connect_to_server(config.getGatewayHost().c_str(), config.getGatewayPort());
+        if (socket_fd >= 0) {
+            break;
+        }
+
+        if (!leaderElection) {
+            creatures::MQTTClient::stopAll(mqttClients);
+            return 1;
+        }
+        error("couldn't reach the gateway, giving up the leader lock for {}ms", retryDelay.count());
+        leaderElection->stepDown(retryDelay);
+        retryDelay = std::min(retryDelay * 2, maxGatewayRetryDelay);
+    }
+    creatures::startup::mark("gateway connected");
+
+    gatewaySocket = socket_fd;
+    if (leaderElection && !leaderElection->isLeader()) {
+        // We lost the lock while we were connecting, before the callback had anything to let go of
+        gatewaySocket = -1;
+        shutdown(socket_fd, SHUT_RDWR);
+    } else if (leaderElection) {
+        // We've been following the old leader, so we pick up right where it left off. Nothing
+        // needs to be forced out on the first poll.
+        bool warm = true;
+        for (const auto &window: {window1, window2, window3, window4}) {
+            warm = warm && window->hasStatus();
+        }
+        restored = restored || warm;
+        for (const auto &mqttClient: mqttClients) {
+            mqttClient->promote();
+        }
+        creatures::startup::mark("took over as leader");
     }
 
+    if (!config.getCaptureFile().empty()) {
+        wireCapture = std::make_unique<creatures::CaptureWriter>(config.getCaptureFile(), config.getCaptureSize());
+        if (!wireCapture->open()) {
+            wireCapture.reset();
+        }
+    }
 
 
-    std::thread reader(reader_thread, socket_fd);
-    std::thread writer(writer_thread, socket_fd);
-    std::thread processor(process_message_thread);
+    std::jthread reader(reader_thread, socket_fd, std::max<std::size_t>(config.getIncomingQueueSize(), 1));
+    std::jthread writer(writer_thread, socket_fd);
+    std::jthread processor(process_message_thread, !restored);
+    if (stateSnapshot) {
+        stateSnapshot->start({window1, window2, window3, window4});
+    }
 
 
     // Define a vector of hex string values
@@ -327,30 +626,68 @@ int main() {
 
 
     // Do something else or just wait here
-    int count = 0;
-    while(keepRunning /*&& count++ < 25*/) {
+    // The main thread's name is what ps shows for the whole process, so keep it recognizable
+    creatures::threading::setup("poll", "andersen_mqtt");
+    auto shutdownToken = shutdownSource.get_token();
+    std::mutex pollMutex;
+    std::condition_variable_any pollCondition;
+    while (!shutdownToken.stop_requested()) {
         debug("Polling all windows...");
         std::vector<uint8_t> event = {SRC_CONTROLLER, DST_PANEL_1, WINDOW_ALL, CMD_STATUS_WITHOUT_POLL};
         auto ck = creatures::Window::calculateChecksum(event);
         event.push_back(ck);
-        outgoingSocketMessages->enqueue(std::move(event));
+        transmitScheduler->enqueue(std::move(event), creatures::TrafficClass::BackgroundPoll);
+        creatures::startup::mark("first poll queued");
 
-        std::this_thread::sleep_for(std::chrono::seconds(5));
+        // Wait for the next poll, but wake right up if it's time to go
+        std::unique_lock<std::mutex> lock(pollMutex);
+        pollCondition.wait_for(lock, shutdownToken, std::chrono::seconds(5), [] { return false; });
     }
-    std::this_thread::sleep_for(std::chrono::seconds(5));
-    keepRunning = false; // Tell the threads to finish up
 
-    // Signal to the writer to stop
-    outgoingSocketMessages->enqueue({});
+    // Shut down in order: get the queued commands out, stop reading, finish processing what
+    // we read, then flush MQTT
+    auto shutdownStarted = std::chrono::steady_clock::now();
+    info("shutting down");
+    creatures::startup::finish("shutdown (nothing was ever published)");
 
-    // Make sure to join your threads
-    if (mqttClient) {
-        mqttClient->stop();
-    }
-    reader.join();
+    writer.request_stop();
     writer.join();
 
+    reader.request_stop();
+    shutdown(socket_fd, SHUT_RDWR); // Unblocks the recv()
+    reader.join();
+
+    processor.request_stop();
+    processor.join();
+
+    // Save where everything ended up, with a fresh poll time
+    if (stateSnapshot) {
+        stateSnapshot->stop();
+        stateSnapshot->save({window1, window2, window3, window4});
+    }
+
+    // If there's someone to take over, the windows aren't really going offline
+    bool handingOver = leaderElection && leaderElection->hasStandby();
+    for (const auto &mqttClient: mqttClients) {
+        mqttClient->setHandingOver(handingOver);
+    }
+    creatures::MQTTClient::stopAll(mqttClients);
+
     close(socket_fd);
+    wireCapture.reset();
+    transmitScheduler->logStats();
+    busPacer->logStats();
+    creatures::threading::logCpuTimes();
+
+    if (auto dropped = creatures::logging::droppedMessages()) {
+        warn("dropped {} log messages because the console couldn't keep up", dropped);
+    }
+    signals.request_stop();
+    signals.join();
+
+    info("shutdown took {}us", std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - shutdownStarted).count());
+    creatures::logging::shutdown();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,311 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+#include <cstring>
+
+#include "namespace-stuffs.h"
+
+#include <nlohmann/json.hpp>
+
+#include "command_tracker.h"
+
+#include "logging/logging.h"
+
+using json = nlohmann::json;
+
+namespace creatures {
+
+    namespace {
+        // Everything in here logs under the "commands" component
+        constexpr auto &logger = logging::component<"commands">;
+
+        int64_t millisecondsSince(std::chrono::steady_clock::time_point then) {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - then).count();
+        }
+
+        // A command shows up on the io thread right behind its dropped (or answered) frame, or it's never going to
+        constexpr std::chrono::seconds earlyAnswerLimit{5};
+    }
+
+    std::optional<CommandRequest> parseCommandRequest(const std::string &payload) {
+
+        CommandRequest request;
+
+        if (payload.empty() || payload.front() != '{') {
+            request.command = payload;
+            return request;
+        }
+
+        json parsed = json::parse(payload, nullptr, false);
+        if (parsed.is_discarded() || !parsed.is_object()) {
+            return std::nullopt;
+        }
+
+        request.command = parsed.value("command", std::string());
+        if (parsed.contains("id")) {
+            // Be nice to people who send numbers
+            request.id = parsed["id"].is_string() ? parsed["id"].get<std::string>() : parsed["id"].dump();
+        }
+        if (parsed.contains("timeout") && parsed["timeout"].is_number() && parsed["timeout"].get<double>() > 0) {
+            request.timeout = std::chrono::milliseconds(static_cast<int64_t>(parsed["timeout"].get<double>() * 1000));
+        }
+        return request;
+    }
+
+    std::vector<CommandTarget> CommandTracker::targets(const std::vector<WindowCommand> &commands) {
+        std::vector<CommandTarget> targets;
+        for (const auto &[window, commandId]: commands) {
+            std::optional<bool> wantOpen;
+            if (commandId == CMD_OPEN) {
+                wantOpen = true;
+            } else if (commandId == CMD_CLOSE) {
+                wantOpen = false;
+            }
+            targets.push_back({window->getNumber(), wantOpen});
+        }
+        return targets;
+    }
+
+    std::string CommandTracker::result(const std::string &id, const std::string &stage) {
+        return json{{"id", id}, {"stage", stage}}.dump();
+    }
+
+    void CommandTracker::track(Tag tag, CommandRequest request, std::vector<CommandTarget> targets, std::size_t frames,
+                               ResultPublisher publisher) {
+
+        auto entry = std::make_shared<Pending>();
+        entry->tag = tag;
+        entry->request = std::move(request);
+        entry->targets = std::move(targets);
+        entry->framesToAck = frames;
+        entry->publisher = std::move(publisher);
+        entry->acceptedAt = std::chrono::steady_clock::now();
+
+        boost::asio::post(ioc, [this, entry] {
+            publish(*entry, "accepted");
+
+            entry->timer = std::make_unique<boost::asio::steady_timer>(ioc, entry->request.timeout);
+            entry->timer->async_wait([this, weak = std::weak_ptr<Pending>(entry)](const boost::system::error_code &ec) {
+                auto timedOut = weak.lock();
+                if (!ec && timedOut) {
+                    logger().warn("command {} didn't finish in {}ms", timedOut->request.id,
+                                  timedOut->request.timeout.count());
+                    finish(timedOut, "timed_out");
+                }
+            });
+
+            pending.push_back(entry);
+
+            // Some of it might already be gone, or even answered
+            auto early = earlyAnswers.find(entry->tag);
+            if (early != earlyAnswers.end()) {
+                auto answers = early->second;
+                earlyAnswers.erase(early);
+                entry->dropped = answers.dropped;
+                entry->busy = answers.busy;
+                for (std::size_t i = 0; i < answers.frames && entry->framesToAck > 0; i++) {
+                    frameAnswered(entry);
+                }
+            }
+        });
+    }
+
+    void CommandTracker::onSent(Tag tag) {
+        boost::asio::post(ioc, [this, tag] {
+            sentOrder.push_back(tag);
+        });
+    }
+
+    void CommandTracker::onAck() {
+        boost::asio::post(ioc, [this] {
+            controllerAnswered(false);
+        });
+    }
+
+    void CommandTracker::onBusy() {
+        boost::asio::post(ioc, [this] {
+            controllerAnswered(true);
+        });
+    }
+
+    void CommandTracker::controllerAnswered(bool busy) {
+
+        // The answer is for the oldest frame that went out, whichever command that was
+        if (sentOrder.empty()) {
+            logger().debug("{} from the controller, but we aren't waiting on anything", busy ? "BUSY" : "ACK");
+            return;
+        }
+        auto tag = sentOrder.front();
+        sentOrder.pop_front();
+
+        auto found = std::find_if(pending.begin(), pending.end(), [tag](const auto &p) { return p->tag == tag; });
+        if (found == pending.end() || (*found)->framesToAck == 0) {
+            rememberEarly(tag, false, busy);
+            return;
+        }
+
+        // BUSY is the answer to one frame. The command's other frames still get theirs.
+        auto entry = *found;
+        if (busy) {
+            logger().warn("the controller was too busy for command {}", entry->request.id);
+            entry->busy = true;
+        }
+        frameAnswered(entry);
+    }
+
+    void CommandTracker::onDropped(Tag tag) {
+        boost::asio::post(ioc, [this, tag] {
+            auto found = std::find_if(pending.begin(), pending.end(), [tag](const auto &p) { return p->tag == tag; });
+            if (found != pending.end()) {
+                auto entry = *found;
+                if (entry->framesToAck > 0) {
+                    logger().warn("a frame for command {} was never sent", entry->request.id);
+                    entry->dropped = true;
+                    frameAnswered(entry);
+                }
+                return;
+            }
+
+            rememberEarly(tag, true, false);
+        });
+    }
+
+    void CommandTracker::rememberEarly(Tag tag, bool dropped, bool busy) {
+
+        // Either it's on its way here, or it's already finished (timed out, most likely). Only
+        // the first one is worth remembering, so forget anything that's been waiting a while.
+        auto now = std::chrono::steady_clock::now();
+        std::erase_if(earlyAnswers, [now](const auto &early) { return now - early.second.at > earlyAnswerLimit; });
+        auto &early = earlyAnswers[tag];
+        early.frames++;
+        early.dropped = early.dropped || dropped;
+        early.busy = early.busy || busy;
+        early.at = now;
+    }
+
+    bool CommandTracker::isDuplicate(const std::string &broker, const std::string &key) {
+
+        if (duplicateWindow.count() == 0) {
+            return false;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(seenMutex);
+        std::erase_if(seen, [this, now](const auto &entry) { return now - entry.second.at > duplicateWindow; });
+
+        auto found = seen.find(key);
+        if (found != seen.end() && found->second.broker != broker) {
+            logger().info("{} already came in on {}, not running it again for {}", key, found->second.broker, broker);
+            return true;
+        }
+
+        seen[key] = {broker, now};
+        return false;
+    }
+
+    void CommandTracker::frameAnswered(const std::shared_ptr<Pending> &entry) {
+        if (--entry->framesToAck > 0) {
+            return;
+        }
+
+        // Every frame has been answered one way or another. Anything but an ACK for all of them
+        // means it didn't all happen.
+        if (entry->dropped) {
+            finish(entry, "dropped");
+            return;
+        }
+        if (entry->busy) {
+            finish(entry, "busy");
+            return;
+        }
+
+        entry->ackedAt = std::chrono::steady_clock::now();
+        publish(*entry, "acked");
+
+        // A stop doesn't have anywhere to get to
+        if (std::none_of(entry->targets.begin(), entry->targets.end(),
+                         [](const CommandTarget &t) { return t.wantOpen.has_value(); })) {
+            finish(entry, "confirmed");
+        }
+    }
+
+    void CommandTracker::onStatus(WindowStatuses statusByWindowNumber) {
+
+        // Only the newest status matters, so if one's already on its way, it picks this up
+        uint64_t packed = 0;
+        std::memcpy(&packed, statusByWindowNumber.data(), statusByWindowNumber.size());
+        latestStatus.store(packed, std::memory_order_relaxed);
+        if (statusPosted.exchange(true)) {
+            return;
+        }
+
+        boost::asio::post(ioc, withMemory(statusMemory, [this] {
+            statusPosted = false;
+            WindowStatuses statuses{};
+            auto newest = latestStatus.load(std::memory_order_relaxed);
+            std::memcpy(statuses.data(), &newest, statuses.size());
+
+            // This comes with every poll, and most of the time there's nothing waiting on it
+            if (pending.empty()) {
+                return;
+            }
+
+            // Work from a copy since finish() takes things out of the list
+            auto current = pending;
+            for (const auto &entry: current) {
+                if (entry->ackedAt && reached(*entry, statuses)) {
+                    finish(entry, "confirmed");
+                }
+            }
+        }));
+    }
+
+    bool CommandTracker::reached(const Pending &pending, const WindowStatuses &statusByWindowNumber) {
+        return std::all_of(pending.targets.begin(), pending.targets.end(), [&](const CommandTarget &target) {
+            if (!target.wantOpen) {
+                return true;
+            }
+            if (target.windowNumber >= statusByWindowNumber.size()) {
+                return false;
+            }
+            bool open = (statusByWindowNumber[target.windowNumber] & 0x01) != 0;
+            return open == *target.wantOpen;
+        });
+    }
+
+    void CommandTracker::publish(const Pending &entry, const std::string &stage) const {
+
+        logger().debug("command {} is {} after {}ms", entry.request.id, stage, millisecondsSince(entry.acceptedAt));
+        if (!entry.publisher) {
+            return;
+        }
+
+        json payload = {
+                {"id", entry.request.id},
+                {"command", entry.request.command},
+                {"stage", stage},
+                {"elapsedMs", millisecondsSince(entry.acceptedAt)}
+        };
+        if (entry.ackedAt) {
+            payload["ackMs"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    *entry.ackedAt - entry.acceptedAt).count();
+        }
+
+        entry.publisher(payload.dump());
+    }
+
+    void CommandTracker::finish(const std::shared_ptr<Pending> &entry, const std::string &stage) {
+        publish(*entry, stage);
+        if (entry->timer) {
+            entry->timer->cancel();
+        }
+        pending.erase(std::remove(pending.begin(), pending.end(), entry), pending.end());
+
+        // A command that timed out could still have frames out there that never got an answer
+        std::erase(sentOrder, entry->tag);
+    }
+
+} // creatures
@@ -0,0 +1,188 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_COMMAND_TRACKER_H
+#define ANDERSEN_MQTT_COMMAND_TRACKER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "threading/handler_memory.h"
+#include "window/command_compiler.h"
+
+namespace creatures {
+
+    /**
+     * A command as it came in. Either plain text ("open") or JSON, like
+     * {"command": "open", "id": "kitchen-42", "timeout": 45}
+     */
+    struct CommandRequest {
+        std::string command;
+        std::string id;                                 // empty means nobody wants to hear how it went
+        std::chrono::milliseconds timeout{60000};       // how long the window has to get there
+    };
+
+    std::optional<CommandRequest> parseCommandRequest(const std::string &payload);
+
+    /**
+     * What one window should end up doing
+     */
+    struct CommandTarget {
+        uint8_t windowNumber;
+        std::optional<bool> wantOpen;                   // nothing to wait for after a stop
+    };
+
+    /**
+     * Follows commands from when they're queued until the windows get where they were told to go.
+     *
+     * Results go out at each stage: accepted, acked (or busy, or dropped), and then confirmed (or
+     * timed_out). There's nothing on the bus that ties an ACK to a command, but the controller
+     * answers frames in the order they went out. The scheduler doesn't send them in the order
+     * they were queued, so the writer tells us (onSent()) each tag as it sends it, and ACKs and
+     * BUSYs are handed out in that order. Frames that never make it onto the bus are queued with
+     * the command's tag too, and the scheduler tells us (onDropped()) so we stop waiting on them.
+     *
+     * Everything runs on one io_context, with a timer per command. Nothing here ever blocks.
+     */
+    class CommandTracker {
+
+    public:
+        using ResultPublisher = std::function<void(const std::string &payload)>;
+
+        // Status bytes by window number (1 through 4, 0 isn't a window)
+        using WindowStatuses = std::array<uint8_t, 5>;
+
+        // Ties a command's frames in the scheduler back to the command
+        using Tag = uint64_t;
+
+        explicit CommandTracker(boost::asio::io_context &ioc) : ioc(ioc) {}
+
+        /**
+         * A tag for the next command's frames. Queue them with it, then track() them with it.
+         * Safe to call from any thread.
+         */
+        Tag newTag() { return nextTag++; }
+
+        /**
+         * Starts following a command that's been queued as some number of frames. Publishes
+         * "accepted" right away, if there's anyone to publish to. Safe to call from any thread.
+         */
+        void track(Tag tag, CommandRequest request, std::vector<CommandTarget> targets, std::size_t frames,
+                   ResultPublisher publisher);
+
+        /**
+         * A command's frame is going out on the bus now. Call it for every tagged frame, in the
+         * order they're sent, before the controller could possibly answer. Safe to call from any thread.
+         */
+        void onSent(Tag tag);
+
+        // What the controller said. Safe to call from any thread.
+        void onAck();
+        void onBusy();
+        void onStatus(WindowStatuses statusByWindowNumber);
+
+        /**
+         * One of a command's frames was thrown out of the queue instead of sent, so there's no ACK
+         * coming for it. Safe to call from any thread.
+         */
+        void onDropped(Tag tag);
+
+        /**
+         * Whether this command already came in on a different broker just now. Brokers that
+         * bridge their command topics hand us every command once each, and it should only run
+         * once. The same command again on the same broker is someone asking twice, so that still
+         * runs. Safe to call from any thread.
+         *
+         * @param broker the broker it came in on
+         * @param key what makes it the same command: where it came in, what it is, and its id
+         */
+        bool isDuplicate(const std::string &broker, const std::string &key);
+
+        // How long a command from another broker counts as the same one (0 turns it off). Set it
+        // before any commands come in.
+        void setDuplicateWindow(std::chrono::milliseconds window) { duplicateWindow = window; }
+
+        /**
+         * Where each window should end up after these commands
+         */
+        static std::vector<CommandTarget> targets(const std::vector<WindowCommand> &commands);
+
+        /**
+         * Builds a result payload for a command that never made it as far as being tracked
+         */
+        static std::string result(const std::string &id, const std::string &stage);
+
+    private:
+        struct Pending {
+            Tag tag;
+            CommandRequest request;
+            std::vector<CommandTarget> targets;
+            std::size_t framesToAck;
+            bool busy = false;                  // the controller turned down at least one frame
+            bool dropped = false;               // at least one frame never went out
+            ResultPublisher publisher;
+            std::chrono::steady_clock::time_point acceptedAt;
+            std::optional<std::chrono::steady_clock::time_point> ackedAt;
+            std::unique_ptr<boost::asio::steady_timer> timer;
+        };
+
+        void publish(const Pending &pending, const std::string &stage) const;
+        void finish(const std::shared_ptr<Pending> &pending, const std::string &stage);
+        void frameAnswered(const std::shared_ptr<Pending> &entry);
+        void controllerAnswered(bool busy);
+        void rememberEarly(Tag tag, bool dropped, bool busy);
+        static bool reached(const Pending &pending, const WindowStatuses &statusByWindowNumber);
+
+        boost::asio::io_context &ioc;
+
+        std::atomic<Tag> nextTag = 1;
+
+        // Only touched on the io thread, oldest first
+        std::deque<std::shared_ptr<Pending>> pending;
+
+        // The tags of the frames that have gone out and haven't been answered yet, oldest first
+        std::deque<Tag> sentOrder;
+
+        // A frame can get dropped, or even answered, before the command it's for has made it to
+        // the io thread. These wait for it, but not for long (see rememberEarly()).
+        struct EarlyAnswers {
+            std::size_t frames = 0;
+            bool dropped = false;
+            bool busy = false;
+            std::chrono::steady_clock::time_point at;
+        };
+        std::unordered_map<Tag, EarlyAnswers> earlyAnswers;
+
+        // The commands from the last duplicateWindow, and which broker each came in on first. Every
+        // broker's io thread checks these.
+        struct Seen {
+            std::string broker;
+            std::chrono::steady_clock::time_point at;
+        };
+        std::mutex seenMutex;
+        std::unordered_map<std::string, Seen> seen;
+        std::chrono::milliseconds duplicateWindow{2000};
+
+        // Every status goes through here, so it gets to the io thread without touching the heap.
+        // The newest one is packed into a word, and only one is ever on its way at a time.
+        HandlerMemory statusMemory;
+        std::atomic<uint64_t> latestStatus = 0;
+        std::atomic<bool> statusPosted = false;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_COMMAND_TRACKER_H
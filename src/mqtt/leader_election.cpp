@@ -0,0 +1,258 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+
+#include "leader_election.h"
+
+#include "logging/logging.h"
+
+namespace creatures {
+
+    namespace {
+        // Everything in here logs under the "failover" component
+        constexpr auto &logger = logging::component<"failover">;
+
+        const std::string online = "online";
+        const std::string offline = "offline";
+
+        // How many settle times a standby gives someone to take the leader's place before saying
+        // nobody has. A takeover is a claim that settles, so this is plenty if anyone's coming.
+        constexpr int abandonedSettles = 4;
+    }
+
+    LeaderElection::LeaderElection(boost::asio::io_context &ioc, std::string instance, std::chrono::milliseconds settle)
+            : ioc(ioc), timer(ioc), holdOffTimer(ioc), abandonedTimer(ioc), instance(std::move(instance)),
+              settle(settle) {}
+
+    void LeaderElection::connected() {
+        isConnected = true;
+        publisher(instanceTopic(), online);
+
+        // The retained lock (if there is one) shows up right after we subscribe. Give it a
+        // moment before deciding there isn't one.
+        startupGraceOver = false;
+        timer.expires_after(settle);
+        timer.async_wait([this](const boost::system::error_code &ec) {
+            if (!ec) {
+                startupGraceOver = true;
+                evaluate();
+            }
+        });
+    }
+
+    void LeaderElection::disconnected() {
+        isConnected = false;
+        timer.cancel();
+        abandonedTimer.cancel();
+        watchingAbandoned = false;
+
+        // Everything gets sent to us again when we reconnect
+        lockHolder.clear();
+        instances.clear();
+        standbyOnline = false;
+
+        // We're on our way out, and already let go of everything
+        if (leaving) {
+            return;
+        }
+
+        // A claim we can't see through doesn't count. Neither does being the leader: once the
+        // broker notices we're gone, our will lets a standby take over, and that could happen
+        // before we hear about it. Stepping down now means the gateway gets let go first.
+        if (role == Role::Leader) {
+            logger().error("lost the broker while we were the leader, stepping down");
+        }
+        if (role != Role::Standby) {
+            setRole(Role::Standby);
+        }
+    }
+
+    bool LeaderElection::message(const std::string &topic, const std::string &payload) {
+
+        if (topic == lockTopic) {
+            lockHolder = payload;
+            logger().debug("the leader lock is held by {}", lockHolder.empty() ? "nobody" : lockHolder);
+
+            // We gave it up on purpose, so whatever happens to it now isn't our business
+            if (leaving) {
+                return true;
+            }
+
+            if (role == Role::Leader && lockHolder != instance) {
+                if (lockHolder.empty()) {
+                    // Someone cleared it out from under us. It's still ours.
+                    publisher(lockTopic, instance);
+                } else {
+                    logger().error("{} has taken the leader lock, stepping down", lockHolder);
+                    setRole(Role::Standby);
+                }
+            } else if (role == Role::Claiming) {
+                if (lockHolder == instance) {
+                    // Our claim made it. Start the clock over every time we hear it.
+                    timer.expires_after(settle);
+                    timer.async_wait([this](const boost::system::error_code &ec) {
+                        if (!ec && role == Role::Claiming && lockHolder == instance) {
+                            setRole(Role::Leader);
+                        }
+                    });
+                } else if (!lockHolder.empty()) {
+                    logger().info("{} got the leader lock first, staying on standby", lockHolder);
+                    timer.cancel();
+                    setRole(Role::Standby);
+                }
+            }
+
+            evaluate();
+            return true;
+        }
+
+        if (topic.starts_with(instanceTopicPrefix) && topic.size() > std::char_traits<char>::length(instanceTopicPrefix)) {
+            auto name = topic.substr(std::char_traits<char>::length(instanceTopicPrefix));
+            instances[name] = payload == online;
+            logger().debug("instance {} is {}", name, payload);
+
+            standbyOnline = std::any_of(instances.begin(), instances.end(), [this](const auto &entry) {
+                return entry.first != instance && entry.second;
+            });
+
+            evaluate();
+            return true;
+        }
+
+        return false;
+    }
+
+    void LeaderElection::release() {
+        if (!isConnected) {
+            return;
+        }
+
+        leaving = true;
+        timer.cancel();
+
+        if (role == Role::Leader) {
+            logger().info("letting go of the leader lock");
+            publisher(lockTopic, "");
+        }
+        publisher(instanceTopic(), offline);
+    }
+
+    void LeaderElection::stepDown(std::chrono::milliseconds holdOff) {
+
+        // Right away, so waitUntilLeader() waits again. The rest happens on the io thread.
+        leader = false;
+
+        boost::asio::post(ioc, [this, holdOff] {
+            if (role != Role::Leader) {
+                return;
+            }
+
+            logger().warn("stepping down, not going for the leader lock again for {}ms", holdOff.count());
+            role = Role::Standby;
+            if (isConnected && !leaving) {
+                publisher(lockTopic, "");
+            }
+
+            holdingOff = true;
+            holdOffTimer.expires_after(holdOff);
+            holdOffTimer.async_wait([this](const boost::system::error_code &ec) {
+                if (!ec) {
+                    holdingOff = false;
+                    evaluate();
+                }
+            });
+        });
+    }
+
+    bool LeaderElection::waitUntilLeader(std::stop_token stopToken) {
+        std::unique_lock<std::mutex> lock(leaderMutex);
+        return leaderCondition.wait(lock, stopToken, [this] { return leader.load(); });
+    }
+
+    void LeaderElection::evaluate() {
+        watchForAbandoned();
+
+        if (!isConnected || !startupGraceOver || leaving || holdingOff || role != Role::Standby) {
+            return;
+        }
+
+        if (holderGone()) {
+            claim();
+        }
+    }
+
+    bool LeaderElection::holderGone() const {
+
+        // An instance that's never said it was online (or said it's gone) can't be holding anything.
+        // That includes us, if we fell over while we were the leader.
+        auto holder = instances.find(lockHolder);
+        return lockHolder.empty() || lockHolder == instance || holder == instances.end() || !holder->second;
+    }
+
+    void LeaderElection::watchForAbandoned() {
+
+        // Someone has it (maybe us), or is about to
+        bool abandoned = isConnected && !leaving && role == Role::Standby && holderGone();
+        if (!abandoned) {
+            if (watchingAbandoned) {
+                abandonedTimer.cancel();
+                watchingAbandoned = false;
+            }
+            return;
+        }
+
+        if (watchingAbandoned) {
+            return;
+        }
+        watchingAbandoned = true;
+        abandonedTimer.expires_after(settle * abandonedSettles);
+        abandonedTimer.async_wait([this](const boost::system::error_code &ec) {
+            if (ec) {
+                return;
+            }
+            watchingAbandoned = false;
+            if (isConnected && !leaving && role == Role::Standby && holderGone()) {
+                logger().warn("nobody has taken over from {}, so nobody has the gateway",
+                              lockHolder.empty() ? "the leader" : lockHolder);
+                if (abandonedCallback) {
+                    abandonedCallback();
+                }
+            }
+        });
+    }
+
+    void LeaderElection::claim() {
+        if (lockHolder == instance) {
+            logger().info("the leader lock still has our name on it, taking it back");
+        } else {
+            logger().info("{} isn't around, claiming the leader lock", lockHolder.empty() ? "nobody" : lockHolder);
+        }
+        setRole(Role::Claiming);
+        publisher(lockTopic, instance);
+    }
+
+    void LeaderElection::setRole(Role newRole) {
+        bool wasLeader = role == Role::Leader;
+        role = newRole;
+
+        if (newRole == Role::Leader && !wasLeader) {
+            logger().info("{} is now the leader", instance);
+            {
+                std::lock_guard<std::mutex> lock(leaderMutex);
+                leader = true;
+            }
+            leaderCondition.notify_all();
+            if (callback) {
+                callback(true);
+            }
+        } else if (newRole != Role::Leader && wasLeader) {
+            leader = false;
+            if (callback) {
+                callback(false);
+            }
+        }
+    }
+
+} // creatures
@@ -0,0 +1,144 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_LEADER_ELECTION_H
+#define ANDERSEN_MQTT_LEADER_ELECTION_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stop_token>
+#include <string>
+
+#include <boost/asio.hpp>
+
+namespace creatures {
+
+    /**
+     * Works out which instance gets the gateway, since it only takes one connection at a time.
+     *
+     * The lock is a retained message on andersen-mqtt/leader with the leader's name in it. Every
+     * instance says it's around on andersen-mqtt/instances/<name>, and its will says "offline"
+     * there if it drops off without saying goodbye. When the leader's will goes off (or it lets
+     * go of the lock on its way out), a standby puts its own name in the lock. Once that's stuck
+     * for the settle time with nobody else's name showing up, the standby is the leader.
+     *
+     * If two standbys go for it at once, the broker keeps whichever name it got last, and that's
+     * also the last one both of them hear, so they agree on who won.
+     *
+     * Our will is on the instance topic, so nothing on the broker says the gateway's gone when
+     * the leader is. A standby that sees the leader go, and nobody take its place for a while
+     * after, says so instead (see setAbandonedCallback()).
+     *
+     * Everything runs on the io thread of the connection it's attached to, other than
+     * waitUntilLeader(), isLeader(), and hasStandby().
+     */
+    class LeaderElection {
+
+    public:
+        // Publishes a retained QoS1 message
+        using Publisher = std::function<void(const std::string &topic, const std::string &payload)>;
+
+        // Called when we become the leader, and if we ever stop being it
+        using LeadershipCallback = std::function<void(bool isLeader)>;
+
+        // Called on a standby when the leader's gone and nobody's taken over
+        using AbandonedCallback = std::function<void()>;
+
+        static constexpr const char *lockTopic = "andersen-mqtt/leader";
+        static constexpr const char *instanceTopicPrefix = "andersen-mqtt/instances/";
+
+        LeaderElection(boost::asio::io_context &ioc, std::string instance, std::chrono::milliseconds settle);
+
+        void setPublisher(Publisher newPublisher) { publisher = std::move(newPublisher); }
+        void setCallback(LeadershipCallback newCallback) { callback = std::move(newCallback); }
+        void setAbandonedCallback(AbandonedCallback newCallback) { abandonedCallback = std::move(newCallback); }
+
+        [[nodiscard]] const std::string &getInstance() const { return instance; }
+        [[nodiscard]] std::string instanceTopic() const { return instanceTopicPrefix + instance; }
+
+        // We're connected and subscribed to the lock and instance topics
+        void connected();
+        void disconnected();
+
+        /**
+         * Something came in on the lock or one of the instance topics
+         *
+         * @return false if the topic isn't one of ours
+         */
+        bool message(const std::string &topic, const std::string &payload);
+
+        /**
+         * Lets go of the lock (if we have it) and says we're leaving, so a standby can take
+         * over right away instead of waiting on a will
+         */
+        void release();
+
+        /**
+         * Gives up the lock but stays on as a standby, and doesn't try for it again until the
+         * hold off is up. For when we got the lock but can't do anything with it (the gateway
+         * won't take our connection), so someone else can have a go. The callback isn't
+         * called, since this was our idea. Safe from any thread.
+         */
+        void stepDown(std::chrono::milliseconds holdOff);
+
+        [[nodiscard]] bool isLeader() const { return leader; }
+
+        // If there's another instance around that could take over from us
+        [[nodiscard]] bool hasStandby() const { return standbyOnline; }
+
+        /**
+         * Blocks until we're the leader
+         *
+         * @return false if we were asked to stop first
+         */
+        bool waitUntilLeader(std::stop_token stopToken);
+
+    private:
+        enum class Role {
+            Standby,
+            Claiming,
+            Leader
+        };
+
+        void evaluate();
+        void claim();
+        void setRole(Role newRole);
+        [[nodiscard]] bool holderGone() const;
+        void watchForAbandoned();
+
+        boost::asio::io_context &ioc;
+        boost::asio::steady_timer timer;
+        boost::asio::steady_timer holdOffTimer;
+        boost::asio::steady_timer abandonedTimer;
+        std::string instance;
+        std::chrono::milliseconds settle;
+
+        Publisher publisher;
+        LeadershipCallback callback;
+        AbandonedCallback abandonedCallback;
+
+        // Only touched on the io thread
+        Role role = Role::Standby;
+        bool isConnected = false;
+        bool startupGraceOver = false;
+        bool leaving = false;
+        bool holdingOff = false;
+        bool watchingAbandoned = false;
+        std::string lockHolder;
+        std::map<std::string, bool> instances;
+
+        std::atomic<bool> leader = false;
+        std::atomic<bool> standbyOnline = false;
+
+        std::mutex leaderMutex;
+        std::condition_variable_any leaderCondition;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_LEADER_ELECTION_H
@@ -9,8 +9,12 @@
 #include <boost/log/sinks.hpp>
 #include <boost/log/trivial.hpp>
 #include <boost/log/attributes.hpp>
+#include <boost/log/attributes/value_extraction.hpp>
+#include <boost/log/expressions/message.hpp>
 #include <spdlog/spdlog.h>
 
+#include "logging/logging.h"
+
 namespace logging = boost::log;
 namespace sinks = boost::log::sinks;
 namespace attrs = boost::log::attributes;
@@ -31,28 +35,53 @@ spdlog::level::level_enum map_severity_level(logging::trivial::severity_level le
     }
 }
 
+// mqtt_cpp tags its records with its own severity attribute rather than the trivial one
+spdlog::level::level_enum map_severity_level(MQTT_NS::severity_level level) {
+    using mqtt_sev = MQTT_NS::severity_level;
+    switch (level) {
+        case mqtt_sev::trace:   return spdlog::level::trace;
+        case mqtt_sev::debug:   return spdlog::level::debug;
+        case mqtt_sev::info:    return spdlog::level::info;
+        case mqtt_sev::warning: return spdlog::level::warn;
+        case mqtt_sev::error:   return spdlog::level::err;
+        case mqtt_sev::fatal:   return spdlog::level::critical;
+        default:                 return spdlog::level::debug;
+    }
+}
 
 
-// Custom sink backend that forwards messages to spdlog
+namespace {
+
+    // Everything coming out of Boost.Log shows up under this component
+    std::shared_ptr<spdlog::logger> bridgeLogger;
+
+    spdlog::level::level_enum record_level(logging::attribute_value_set const& attributes) {
+        if (auto severity = logging::extract<MQTT_NS::severity_level>("MqttSeverity", attributes)) {
+            return map_severity_level(severity.get());
+        }
+        if (auto severity = logging::extract<logging::trivial::severity_level>("Severity", attributes)) {
+            return map_severity_level(severity.get());
+        }
+
+        // Default to info level if we can't get the severity level
+        return spdlog::level::info;
+    }
+
+}
+
+
+// Custom sink backend that forwards messages to spdlog. It takes the raw record instead of
+// a formatted one so Boost never builds a string we're going to throw away.
 class spdlog_sink_backend :
-        public sinks::basic_formatted_sink_backend<char, sinks::synchronized_feeding>
+        public sinks::basic_sink_backend<sinks::synchronized_feeding>
 {
 public:
-    // The function is called for every log record to push it to spdlog
-    // The function is called for every log record to push it to spdlog
-    static void consume(logging::record_view const& rec, string_type const& formatted_message)
+    // The function is called for every log record that made it past the filter
+    static void consume(logging::record_view const& rec)
     {
-        // Extract the severity level using Boost.Log attribute value extraction
-        auto severity_attr = rec[logging::trivial::severity];
-        if (severity_attr) {
-            // Get the actual severity level
-            auto severity = severity_attr.get();
-            // Map the Boost severity level to spdlog level
-            auto spdlog_level = map_severity_level(severity);
-            spdlog::log(spdlog_level, formatted_message);
-        } else {
-            // Default to info level if we can't get the severity level
-            spdlog::info(formatted_message);
+        auto message = rec[logging::expressions::smessage];
+        if (message) {
+            bridgeLogger->log(record_level(rec.attribute_values()), message.get());
         }
     }
 };
@@ -60,9 +89,17 @@ public:
 
 void init_boost_logging()
 {
+    bridgeLogger = creatures::logging::get("mqtt_cpp");
+
     typedef sinks::synchronous_sink<spdlog_sink_backend> sink_t;
     boost::shared_ptr<sink_t> sink(new sink_t());
 
+    // Ask spdlog before Boost does any work on the record. Since this looks at the logger's
+    // level each time, changing the "mqtt_cpp" level at runtime takes effect right away.
+    sink->set_filter([](logging::attribute_value_set const& attributes) {
+        return bridgeLogger->should_log(record_level(attributes));
+    });
+
     logging::core::get()->add_sink(sink);
 
     spdlog::debug("Boost logging initialized");
@@ -2,6 +2,7 @@
 // Created by @opsnlops on 11/22/23.
 //
 
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <boost/asio/signal_set.hpp>
@@ -9,20 +10,96 @@
 #include <mqtt_client_cpp.hpp>
 #include <mqtt/setup_log.hpp>
 
-#include "blockingconcurrentqueue.h"
-
 #include "namespace-stuffs.h"
 
+#include <nlohmann/json.hpp>
+
 #include "mqtt.h"
 
-extern std::shared_ptr<moodycamel::BlockingConcurrentQueue<std::vector<uint8_t>>> outgoingSocketMessages;
+#include "bus/transmit_scheduler.h"
+#include "logging/logging.h"
+#include "mqtt/command_tracker.h"
+#include "startup/startup.h"
+#include "state/state_history.h"
+#include "threading/threading.h"
+#include "tracing/allocations.h"
+#include "tracing/tracing.h"
+
+extern std::shared_ptr<creatures::TransmitScheduler> transmitScheduler;
+extern std::shared_ptr<creatures::CommandTracker> commandTracker;
+extern std::unique_ptr<creatures::StateHistory> stateHistory;
+
+using json = nlohmann::json;
 
 
 namespace creatures {
 
-    MQTTClient::MQTTClient(std::string host, std::string port) {
+    namespace {
+        // Everything in here logs under the "mqtt" component
+        constexpr auto &logger = logging::component<"mqtt">;
+
+        const std::string loggingTopicPrefix = "andersen-mqtt/logging/";
+        const std::string loggingTopicSuffix = "/level";
+
+        const std::string groupTopicPrefix = "andersen-mqtt/groups/";
+        const std::string groupTopicSuffix = "/command";
 
-        info("creating a new MQTT instance for host {} and port {}", host, port);
+        const std::string sceneTopicPrefix = "andersen-mqtt/scenes/";
+        const std::string sceneTopicSuffix = "/activate";
+
+        // Where command results go, tacked on to the end of the topic the command came in on
+        const std::string resultTopicSuffix = "/result";
+
+        // Asking what happened to a window, and where the answers go if the asker doesn't say
+        const std::string historyQueryTopic = "andersen-mqtt/history/query";
+        const std::string historyResultTopic = "andersen-mqtt/history/result";
+
+        // Anyone can ask, so they only get to pick where under here the answer goes. Anywhere
+        // else and a query could land on the leader lock or a window's command topic.
+        const std::string historyReplyPrefix = "andersen-mqtt/history/";
+
+        bool isHistoryReplyTopic(const std::string &topic) {
+            return topic.size() > historyReplyPrefix.size() && topic.starts_with(historyReplyPrefix) &&
+                   topic != historyQueryTopic && topic.find_first_of("+#") == std::string::npos;
+        }
+
+        // Whether we (and the gateway) are up. The broker sets this to offline if we drop off.
+        const std::string availabilityTopic = "andersen-mqtt/availability";
+        const std::string online = "online";
+        const std::string offline = "offline";
+
+        // With failover, how often we ping the broker. A crashed leader's will goes off after 1.5x this.
+        constexpr std::uint16_t failoverKeepAlive = 5;
+
+        // ...and how long we wait on the answer before calling the connection dead. The broker could
+        // have given up on us 1.5x the keep alive after the last ping it got, so keep alive plus this
+        // has to be less than that. Then a leader always knows it's gone before a standby does.
+        constexpr auto failoverPingTimeout = std::chrono::seconds(2);
+
+        // How long we give the broker to send what it has retained for our windows after we
+        // subscribe. It sends them right behind the SUBACK, so this is plenty on a LAN.
+        constexpr std::chrono::milliseconds retainedSettle{250};
+
+        // Pulls the name out of the middle of a topic like "andersen-mqtt/groups/<name>/command"
+        std::optional<std::string> topicName(const std::string &topic, const std::string &prefix,
+                                             const std::string &suffix) {
+            if (topic.size() <= prefix.size() + suffix.size() ||
+                !topic.starts_with(prefix) || !topic.ends_with(suffix)) {
+                return std::nullopt;
+            }
+            return topic.substr(prefix.size(), topic.size() - prefix.size() - suffix.size());
+        }
+    }
+
+    MQTTClient::MQTTClient(std::string host, std::string port, MQTTOptions options)
+            : inflightLimit(options.maxInflight), options(options), shardRing(options.shards),
+              work(boost::asio::make_work_guard(ioc)),
+              reconnectTimer(ioc), retainedTimer(ioc), nextReconnectDelay(options.reconnectDelay) {
+
+        standby = options.standby;
+
+        logger().info("creating a new MQTT instance for {} at host {} and port {} (MQTT {})", options.name, host, port,
+                      options.v5 ? "v5" : "v3.1.1");
 
         // Store these for later
         this->host = host;
@@ -31,18 +108,38 @@ namespace creatures {
         this->connected = false;
 
         // Create the client
-        client = mqtt::make_sync_client(this->ioc, this->host, this->port);
+        // Async all the way, since the io thread is shared. Connecting to a broker that never answers
+        // can take minutes, and the first broker's thread runs the command tracker and the watchdog too.
+        client = mqtt::make_async_client(this->ioc, this->host, this->port,
+                                        options.v5 ? MQTT_NS::protocol_version::v5 : MQTT_NS::protocol_version::v3_1_1);
 
         // Setup client
-        client->set_client_id("andersen-mqtt");
+        client->set_client_id(options.clientId);
         client->set_clean_session(true);
 
+        // If we go away without saying goodbye, the broker lets everyone know. With failover, that's
+        // something for the other instance to hear, not a reason to call everything offline.
+        auto willTopic = options.instance.empty() ? availabilityTopic
+                                                  : LeaderElection::instanceTopicPrefix + options.instance;
+        client->set_will(MQTT_NS::will(MQTT_NS::allocate_buffer(willTopic), MQTT_NS::allocate_buffer(offline),
+                                       MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes));
+
+        // The will only goes off once the broker notices we're gone, and a standby is waiting on that
+        if (!options.instance.empty()) {
+            client->set_keep_alive_sec(failoverKeepAlive);
+            client->set_pingresp_timeout(failoverPingTimeout);
+        }
+
+        // Nothing is online until the gateway says so
+        availability[availabilityTopic] = false;
+
         // Bind the member function for the connack handler
         client->set_connack_handler(
                 [this](auto &&PH1, auto &&PH2) {
                     return on_connack(std::forward<decltype(PH1)>(PH1), std::forward<decltype(PH2)>(PH2));
                 });
         client->set_close_handler([this] { on_close(); });
+        client->set_puback_handler([this](auto &&PH1) { return on_puback(std::forward<decltype(PH1)>(PH1)); });
         client->set_error_handler([this](auto &&PH1) { on_error(std::forward<decltype(PH1)>(PH1)); });
         client->set_suback_handler(
                 [this](auto &&PH1, auto &&PH2) {
@@ -53,102 +150,322 @@ namespace creatures {
                               std::forward<decltype(PH3)>(PH3), std::forward<decltype(PH4)>(PH4));
         });
 
+        // v5 calls a different set of handlers, which all end up in the same place
+        client->set_v5_connack_handler([this](bool sp, MQTT_NS::v5::connect_reason_code reason_code,
+                                              MQTT_NS::v5::properties props) {
+            return on_v5_connack(sp, reason_code, std::move(props));
+        });
+        client->set_v5_puback_handler([this](packet_id_t packet_id, MQTT_NS::v5::puback_reason_code,
+                                             MQTT_NS::v5::properties) {
+            return on_puback(packet_id);
+        });
+        client->set_v5_suback_handler([](packet_id_t packet_id, std::vector<MQTT_NS::v5::suback_reason_code> reasons,
+                                         MQTT_NS::v5::properties) {
+            logger().info("subscribe acknowledged! packet_id: {} ({} topics)", packet_id, reasons.size());
+            return true;
+        });
+        client->set_v5_publish_handler([this](MQTT_NS::optional<packet_id_t> packet_id, MQTT_NS::publish_options pubopts,
+                                              MQTT_NS::buffer topic_name, MQTT_NS::buffer contents,
+                                              MQTT_NS::v5::properties props) {
+            return on_v5_publish(packet_id, pubopts, std::move(topic_name), std::move(contents), std::move(props));
+        });
+
+    }
+
+    MQTTClient::~MQTTClient() {
+        // stop() should have been called, but don't take the process down if it wasn't
+        ioc.stop();
+        if (ioThread.joinable()) {
+            ioThread.join();
+        }
     }
 
     void MQTTClient::start() {
 
-        info("starting the MQTT worker");
+        logger().info("starting the MQTT worker for {}", options.name);
+
+        // Even connecting happens on the io thread, and it never waits there, so an unreachable broker
+        // doesn't hold up anything else that runs on it
+        boost::asio::post(ioc, [this] { connect(); });
 
+        logger().debug("starting the ioc");
+        this->ioThread = std::thread([this] {
+            threading::setup("mqtt", "mqtt-" + options.name);
+            ioc.run();
+        });
+
+    }
 
-        debug("connecting");
-        client->connect();
+    void MQTTClient::connect() {
 
-        debug("starting the ioc");
-        this->ioThread = std::thread([this] { ioc.run(); });
+        if (stopping) {
+            return;
+        }
 
+        logger().debug("connecting to {} ({}:{})", options.name, host, port);
+        auto onConnect = [this](MQTT_NS::error_code ec) {
+            if (ec) {
+                logger().warn("unable to connect to {} ({}:{}): {}", options.name, host, port, ec.message());
+                scheduleReconnect();
+            }
+        };
+
+        if (options.v5) {
+            // Tell the broker how much we can take. We don't need it to alias anything for us.
+            client->async_connect(MQTT_NS::v5::properties{
+                    MQTT_NS::v5::property::receive_maximum(options.receiveMaximum),
+                    MQTT_NS::v5::property::topic_alias_maximum(0)
+            }, onConnect);
+        } else {
+            client->async_connect(onConnect);
+        }
     }
 
-    void MQTTClient::stop() {
-        debug("stopping the ioc");
+    void MQTTClient::scheduleReconnect() {
+
+        if (stopping) {
+            return;
+        }
+
+        logger().info("trying {} again in {}ms", options.name, nextReconnectDelay.count());
+        reconnectTimer.expires_after(nextReconnectDelay);
+        reconnectTimer.async_wait([this](const boost::system::error_code &ec) {
+            if (!ec) {
+                connect();
+            }
+        });
+
+        nextReconnectDelay = std::min(nextReconnectDelay * 2, options.maxReconnectDelay);
+    }
+
+    void MQTTClient::stop(std::chrono::milliseconds timeout) {
+        stopAll(std::vector<MQTTClient *>{this}, timeout);
+    }
+
+    void MQTTClient::stopAll(const std::vector<std::unique_ptr<MQTTClient>> &clients, std::chrono::milliseconds timeout) {
+        std::vector<MQTTClient *> pointers;
+        for (const auto &client: clients) {
+            pointers.push_back(client.get());
+        }
+        stopAll(pointers, timeout);
+    }
+
+    void MQTTClient::stopAll(const std::vector<MQTTClient *> &clients, std::chrono::milliseconds timeout) {
+
+        // Half the time for the last publishes to land, the rest for saying goodbye
+        auto start = std::chrono::steady_clock::now();
+        auto flushDeadline = start + timeout / 2;
+        auto deadline = start + timeout;
+
+        auto waitFor = [&clients](auto &&done, std::chrono::steady_clock::time_point until) {
+            while (!std::all_of(clients.begin(), clients.end(), done) && std::chrono::steady_clock::now() < until) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        };
+
+        for (auto *client: clients) {
+            client->beginStop();
+        }
+        waitFor([](const MQTTClient *client) { return client->flushed(); }, flushDeadline);
+
+        for (auto *client: clients) {
+            client->disconnect();
+        }
+        waitFor([](const MQTTClient *client) { return !client->connected; }, deadline);
+
+        for (auto *client: clients) {
+            client->finishStop();
+        }
+    }
+
+    void MQTTClient::beginStop() {
+
+        // No more reconnecting from here on out
+        stopping = true;
+
+        // A clean disconnect doesn't trigger the will, so say we're going ourselves. Count one
+        // publish now so the wait for them doesn't finish before these are even sent.
+        if (connected) {
+            inflightPublishes++;
+            boost::asio::post(ioc, [this] {
+
+                // Let a standby know it can take over now, instead of waiting on a will
+                if (election) {
+                    election->release();
+                }
+
+                // A standby never said anything about availability, and if someone's taking over
+                // from us, the windows aren't going anywhere
+                if (!standby && !handingOver) {
+                    inflightPublishes += static_cast<int64_t>(availability.size());
+                    for (const auto &[topic, isOnline]: availability) {
+                        client->async_publish(topic, offline, MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes);
+                    }
+                }
+                inflightPublishes--;
+            });
+        }
+    }
+
+    bool MQTTClient::flushed() const {
+        // Give a publish that's still queued, and anything still waiting on a PUBACK, a moment to land
+        return !connected || (!publishQueued && inflightPublishes <= 0);
+    }
+
+    void MQTTClient::disconnect() {
+        if (inflightPublishes > 0) {
+            logger().warn("stopping {} with {} publishes not acknowledged", options.name, inflightPublishes.load());
+        }
+
+        // Say goodbye properly so the broker doesn't think we fell over
+        if (connected) {
+            logger().debug("disconnecting from {}", options.name);
+            boost::asio::post(ioc, [this] { client->async_disconnect(); });
+        }
+    }
+
+    void MQTTClient::finishStop() {
+
+        logger().debug("stopping the ioc");
         ioc.stop();
 
-        debug("waiting for the ioc thread to finish");
+        logger().debug("waiting for the ioc thread to finish");
         if (ioThread.joinable()) {
             ioThread.join();
-            debug("ioThread joined!");
+            logger().debug("ioThread joined!");
         }
 
-        info("MQTT Client stopped");
+        logger().info("MQTT Client for {} stopped ({} windows, {} publishes in {} passes, {}us publishing)",
+                      options.name, ownedWindows.size(), publishCount.load(), publishPasses.load(),
+                      publishMicroseconds.load());
     }
 
     void MQTTClient::addWindow(const std::shared_ptr<Window> window) {
-        info("adding window {} to MQTT client", window->getName());
+        logger().info("adding window {} to MQTT client", window->getName());
         windows.push_back(window);
+        compiler.addWindow(window);
+
+        // Every shard knows every window (groups and scenes need them all), but only looks after its own
+        if (shardRing.shardFor(window->getName()) == options.shard) {
+            ownedWindows.push_back(window);
+            availability[window->createPrefix() + "availability"] = false;
+
+            auto &windowFields = fields[window->getName()];
+            for (std::size_t i = 0; i < windowFieldCount; i++) {
+                windowFields.topics[i] = window->createPrefix() + windowFieldName(static_cast<WindowField>(i));
+            }
+        }
+    }
+
+    void MQTTClient::setAvailability(const std::shared_ptr<Window> &window, bool isOnline) {
+        auto topic = window ? window->createPrefix() + "availability" : availabilityTopic;
+
+        boost::asio::post(ioc, [this, topic, isOnline] {
+            auto found = availability.find(topic);
+            if (found == availability.end()) {
+                return;     // Someone else's window
+            }
+            found->second = isOnline;
+            if (connected) {
+                inflightPublishes++;
+                client->async_publish(topic, isOnline ? online : offline, MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes);
+            }
+        });
+    }
+
+    void MQTTClient::setPublishPolicy(const PublishPolicy &policy) {
+        publishPolicy = policy;
+    }
+
+    void MQTTClient::setGroups(const WindowGroups &windowGroups) {
+        groups = windowGroups;
     }
 
     bool MQTTClient::subscribe(std::string topic, MQTT_NS::qos qos) {
 
         if (connected) {
-            info("subscribing to topic {}", topic);
-            client->subscribe(topic, qos);
+            logger().info("subscribing to topic {}", topic);
+            client->async_subscribe(topic, qos);
             return true;
         }
 
-        error("not subscribing since we're not connected");
+        logger().error("not subscribing since we're not connected");
         return false;
     }
 
     bool MQTTClient::publishWindows(bool forcePublish) {
+        TRACE_ZONE("MQTTClient::publishWindows");
 
-        if (connected) {
-            info("publishing all windows to MQTT");
-            for (const auto &window: windows) {
-
-                std::string prefix = window->createPrefix();
-
-                if (window->hasOpenUpdated() || forcePublish) {
-                    client->publish(prefix + "open", yesOrNo(window->isOpen()),
-                                    MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes);
-                }
+        if (!connected) {
+            logger().debug("not publishing to {} since we're not connected", options.name);
+            return false;
+        }
 
-                if (window->hasMovementObstructedUpdated() || forcePublish) {
-                    client->publish(prefix + "movement_obstructed", yesOrNo(window->isMovementObstructed()),
-                                    MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes);
-                }
+        // Whatever's queued reads the windows when it runs, so one waiting is as good as ten
+        if (forcePublish) {
+            pendingForce = true;
+        }
+        if (!publishQueued.exchange(true)) {
+            boost::asio::post(ioc, withMemory(publishMemory, [this] {
+                publishQueued = false;
+                publishNow(pendingForce.exchange(false));
+            }));
+        }
 
-                if (window->hasScreenMissingUpdated() || forcePublish) {
-                    client->publish(prefix + "screen_missing", yesOrNo(window->isScreenMissing()),
-                                    MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes);
-                }
+        return true;
+    }
 
-                if (window->hasRfHeardUpdated() || forcePublish) {
-                    client->publish(prefix + "rf_heard", yesOrNo(window->isRfHeard()),
-                                    MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes);
-                }
+    void MQTTClient::publishNow(bool forcePublish) {
+        TRACE_ZONE("MQTTClient::publishNow");
 
-                if (window->hasRainSensedUpdated() || forcePublish) {
-                    client->publish(prefix + "rain_sensed", yesOrNo(window->isRainSensed()),
-                                    MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes);
-                }
+        if (!connected) {
+            return;
+        }
 
-                if (window->hasRainOverrideActiveUpdated() || forcePublish) {
-                    client->publish(prefix + "rain_override_active", yesOrNo(window->isRainOverrideActive()),
-                                    MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes);
-                }
+        // Still finding out what the broker already has. What's current goes out once we know.
+        if (readingRetained) {
+            deferredForce = deferredForce || forcePublish;
+            return;
+        }
 
-                if (window->hasLastPolledUpdated() || forcePublish) {
-                    client->publish(prefix + "last_polled", window->getLastPolled(),
-                                    MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes);
-                }
+        // The broker is behind on acknowledging us. We'll catch it up on the latest once it is.
+        if (inflightPublishes >= inflightLimit) {
+            if (!publishDeferred) {
+                logger().warn("{} is falling behind ({} publishes unacknowledged), holding off",
+                              options.name, inflightPublishes.load());
+            }
+            publishDeferred = true;
+            deferredForce = deferredForce || forcePublish;
+            return;
+        }
 
-                // Now go mark the window as not updated
-                window->resetUpdatedFlags();
+        {
+            logger().debug("publishing all windows to {}", options.name);
+            auto now = std::chrono::steady_clock::now();
+            for (const auto &window: ownedWindows) {
+
+                // The processor could be in the middle of the next poll, so read it all in one go
+                auto state = window->getState();
+                publishField(window, WindowField::Open, yesOrNo(state.isOpen()), state, forcePublish, now);
+                publishField(window, WindowField::MovementObstructed, yesOrNo(state.isMovementObstructed()), state, forcePublish, now);
+                publishField(window, WindowField::ScreenMissing, yesOrNo(state.isScreenMissing()), state, forcePublish, now);
+                publishField(window, WindowField::RfHeard, yesOrNo(state.isRfHeard()), state, forcePublish, now);
+                publishField(window, WindowField::RainSensed, yesOrNo(state.isRainSensed()), state, forcePublish, now);
+                publishField(window, WindowField::RainOverrideActive, yesOrNo(state.isRainOverrideActive()), state, forcePublish, now);
+                Window::formatISO8601(state.lastPolled, lastPolledScratch);
+                publishField(window, WindowField::LastPolled, lastPolledScratch, state, forcePublish, now);
             }
-            return true;
+
+            publishPasses++;
+            publishMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - now).count();
         }
 
-        error("not publishing since we're not connected");
-        return false;
+        // Building the phase name allocates, so only do it the once it matters
+        if (!startupFinished) {
+            startupFinished = true;
+            startup::finish("first publish to " + options.name);
+        }
     }
 
 
@@ -156,50 +473,309 @@ namespace creatures {
 
         std::string topic = window->createPrefix() + "command";
 
-        debug("subscribing to window {} ({})", window->getName(), topic);
-        client->subscribe(topic, MQTT_NS::qos::at_least_once);
+        logger().debug("subscribing to window {} ({})", window->getName(), topic);
+        subscribeCommands(topic);
 
         return true;
     }
 
+    void MQTTClient::subscribeCommands(const std::string &topic) {
+        if (options.v5) {
+            // Someone leaving a retained command behind shouldn't make us run it again every reconnect
+            client->async_subscribe(topic, MQTT_NS::qos::at_least_once | MQTT_NS::retain_handling::not_send);
+        } else {
+            client->async_subscribe(topic, MQTT_NS::qos::at_least_once);
+        }
+    }
+
+
+    void MQTTClient::publishField(const std::shared_ptr<Window> &window, WindowField field, const std::string &value,
+                                  const Window::State &state, bool forcePublish,
+                                  std::chrono::steady_clock::time_point now) {
+
+        const auto &policy = publishPolicy.get(field);
+        auto &windowFields = fields[window->getName()];
+        auto &throttle = windowFields.throttles[static_cast<std::size_t>(field)];
+
+        // Catching up after a connect: whatever the broker doesn't already have goes out now
+        bool force = forcePublish || (catchingUp && !throttle.matches(value));
+
+        if (throttle.shouldPublish(policy, value, force, now)) {
+            publishRetained(windowFields.topics[static_cast<std::size_t>(field)], value, static_cast<MQTT_NS::qos>(policy.qos),
+                            state.lastPolled);
+            throttle.published(value, now);
+        }
+    }
+
+    void MQTTClient::publishRetained(const std::string &topic, const std::string &payload, MQTT_NS::qos qos,
+                                     std::chrono::system_clock::time_point frameTime) {
+        publishCount++;
+
+        // Only QoS1 gets a PUBACK, so that's all we keep track of for a clean shutdown
+        if (qos == MQTT_NS::qos::at_least_once) {
+            inflightPublishes++;
+        }
+
+        if (!options.v5) {
+            // The library copies the topic and payload into its own buffers. That's on it, not us.
+            allocations::Exempt exempt;
+            client->async_publish(topic, payload, qos | MQTT_NS::retain::yes);
+            return;
+        }
+
+        // Let consumers know when the frame behind this came off the bus
+        auto frameMs = std::chrono::duration_cast<std::chrono::milliseconds>(frameTime.time_since_epoch()).count();
+        MQTT_NS::v5::properties props{
+                MQTT_NS::v5::property::user_property(MQTT_NS::allocate_buffer("frame_timestamp"),
+                                                     MQTT_NS::allocate_buffer(std::to_string(frameMs)))
+        };
+
+        // The first publish on a topic sets up an alias, after that we only send the alias
+        std::string publishTopic = topic;
+        {
+            std::lock_guard<std::mutex> lock(topicAliasMutex);
+            auto alias = topicAliases.find(topic);
+            if (alias != topicAliases.end()) {
+                publishTopic.clear();
+                props.emplace_back(MQTT_NS::v5::property::topic_alias(alias->second));
+            } else if (topicAliases.size() < topicAliasMaximum) {
+                auto next = static_cast<uint16_t>(topicAliases.size() + 1);
+                topicAliases.emplace(topic, next);
+                props.emplace_back(MQTT_NS::v5::property::topic_alias(next));
+            }
+        }
 
-    std::string MQTTClient::yesOrNo(bool value) {
-        return value ? "yes" : "no";
+        allocations::Exempt exempt;
+        client->async_publish(publishTopic, payload, qos | MQTT_NS::retain::yes, std::move(props));
+    }
+
+    const std::string &MQTTClient::yesOrNo(bool value) {
+        static const std::string yes = "yes";
+        static const std::string no = "no";
+        return value ? yes : no;
     }
 
 
     bool MQTTClient::on_connack(bool sp, mqtt::connect_return_code connack_return_code) {
 
-        debug("connection acknowledged! session present: {}, connect return code: {}",
+        logger().debug("connection acknowledged! session present: {}, connect return code: {}",
               sp, MQTT_NS::connect_return_code_to_str(connack_return_code));
 
         connected = true;
+        nextReconnectDelay = options.reconnectDelay;
+        startup::mark("connected to " + options.name);
+
+        // Find out who has the gateway (and tell everyone we're here)
+        if (election) {
+            client->async_subscribe(LeaderElection::lockTopic, MQTT_NS::qos::at_least_once);
+            client->async_subscribe(std::string(LeaderElection::instanceTopicPrefix) + "+", MQTT_NS::qos::at_least_once);
+            election->connected();
+        }
 
-        // Now that we're connected, let's subscribe to all the windows
-        for (const auto &window: windows) {
-            subscribe(window);
+        // The knobs for turning the logging up and down work even on a standby, but only need to be heard once
+        if (options.shard == 0) {
+            client->async_subscribe(loggingTopicPrefix + "+" + loggingTopicSuffix, MQTT_NS::qos::at_least_once);
+        }
+
+        // Until we're the leader, all we do is keep up with what the leader says about our windows
+        if (standby) {
+            for (const auto &window: ownedWindows) {
+                for (const auto &topic: fields[window->getName()].topics) {
+                    client->async_subscribe(topic, MQTT_NS::qos::at_least_once);
+                }
+            }
+            return true;
+        }
+
+        subscribeAll();
+
+        // Our will might have gone off since the last connection, so put availability back how it really is
+        for (const auto &[topic, isOnline]: availability) {
+            inflightPublishes++;
+            client->async_publish(topic, isOnline ? online : offline, MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes);
+        }
+
+        // If we already know where the windows are, there's no reason to make everyone wait on a poll
+        if (publishOnConnect.exchange(false)) {
+            readRetained();
         }
 
         return true;
 
     }
 
+    void MQTTClient::readRetained() {
+
+        // Most of what we know is probably still sitting on the broker from last time. Have a
+        // look before sending it all again.
+        logger().debug("reading what {} has retained for our windows", options.name);
+        readingRetained = true;
+        for (const auto &window: ownedWindows) {
+            for (const auto &topic: fields[window->getName()].topics) {
+                client->async_subscribe(topic, MQTT_NS::qos::at_least_once);
+            }
+        }
+
+        retainedTimer.expires_after(retainedSettle);
+        retainedTimer.async_wait([this](const boost::system::error_code &ec) {
+            if (!ec) {
+                finishReadingRetained();
+            }
+        });
+    }
+
+    void MQTTClient::finishReadingRetained() {
+        readingRetained = false;
+        if (!connected) {
+            return;
+        }
+
+        for (const auto &window: ownedWindows) {
+            for (const auto &topic: fields[window->getName()].topics) {
+                client->async_unsubscribe(topic);
+            }
+        }
+
+        logger().info("publishing the saved window state to {} (only what it doesn't already have)", options.name);
+        catchingUp = true;
+        publishNow(std::exchange(deferredForce, false));
+        catchingUp = false;
+    }
+
+    void MQTTClient::subscribeAll() {
+
+        // Subscribe to all of our windows
+        for (const auto &window: ownedWindows) {
+            subscribe(window);
+        }
+
+        // Everything that isn't about one window only goes to the first shard, so it only gets run once.
+        // That's the groups, the scenes, and the history.
+        if (options.shard == 0) {
+            subscribeCommands(groupTopicPrefix + "+" + groupTopicSuffix);
+            subscribeCommands(sceneTopicPrefix + "+" + sceneTopicSuffix);
+            subscribeCommands(historyQueryTopic);
+        }
+    }
+
+    void MQTTClient::setLeaderElection(std::shared_ptr<LeaderElection> newElection) {
+        election = std::move(newElection);
+        election->setPublisher([this](const std::string &topic, const std::string &payload) {
+            inflightPublishes++;
+            client->async_publish(topic, payload, MQTT_NS::qos::at_least_once | MQTT_NS::retain::yes);
+        });
+    }
+
+    void MQTTClient::promote() {
+        boost::asio::post(ioc, [this] {
+            if (!standby.exchange(false)) {
+                return;
+            }
+            logger().info("taking over on {}", options.name);
+
+            // If we're not connected, the next connection sets everything up like normal
+            if (!connected) {
+                return;
+            }
+
+            for (const auto &window: ownedWindows) {
+                for (const auto &topic: fields[window->getName()].topics) {
+                    client->async_unsubscribe(topic);
+                }
+            }
+            subscribeAll();
+        });
+    }
+
+    bool MQTTClient::on_v5_connack(bool sp, MQTT_NS::v5::connect_reason_code reason_code, MQTT_NS::v5::properties props) {
+
+        if (reason_code != MQTT_NS::v5::connect_reason_code::success) {
+            logger().error("broker refused our connection: {}", MQTT_NS::v5::connect_reason_code_to_str(reason_code));
+            return true;
+        }
+
+        // See what the broker is willing to do for us
+        uint16_t aliasMaximum = 0;
+        uint16_t brokerReceiveMaximum = UINT16_MAX;
+        for (const auto &prop: props) {
+            MQTT_NS::visit(
+                    MQTT_NS::make_lambda_visitor(
+                            [&](const MQTT_NS::v5::property::topic_alias_maximum &p) { aliasMaximum = p.val(); },
+                            [&](const MQTT_NS::v5::property::receive_maximum &p) { brokerReceiveMaximum = p.val(); },
+                            [](const auto &) {}
+                    ),
+                    prop
+            );
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(topicAliasMutex);
+            topicAliases.clear();
+            topicAliasMaximum = aliasMaximum;
+        }
+        inflightLimit = std::min(options.maxInflight, brokerReceiveMaximum);
+
+        logger().info("MQTT v5 session: {} topic aliases, broker takes {} publishes in flight, we take {}",
+                      aliasMaximum, brokerReceiveMaximum, options.receiveMaximum);
+
+        return on_connack(sp, MQTT_NS::connect_return_code::accepted);
+    }
+
     void MQTTClient::on_close() {
 
         this->connected = false;
-        info("MQTT connection closed");
+
+        // We never got to publish the saved state, so do it next time
+        if (readingRetained) {
+            retainedTimer.cancel();
+            readingRetained = false;
+            publishOnConnect = true;
+        }
+
+        if (election) {
+            election->disconnected();
+        }
+
+        // Aliases don't carry over to the next connection
+        {
+            std::lock_guard<std::mutex> lock(topicAliasMutex);
+            topicAliases.clear();
+        }
+
+        // Nothing that was in flight is getting acknowledged now
+        inflightPublishes = 0;
+        publishDeferred = false;
+        inflightLimit = options.maxInflight;
+
+        logger().info("MQTT connection to {} closed", options.name);
+        scheduleReconnect();
+    }
+
+    bool MQTTClient::on_puback(packet_id_t packet_id) {
+        logger().trace("publish acknowledged! packet_id: {}", packet_id);
+        inflightPublishes--;
+
+        // Caught up enough? Then send what's current now.
+        if (publishDeferred && inflightPublishes < inflightLimit / 2) {
+            publishDeferred = false;
+            publishNow(std::exchange(deferredForce, false));
+        }
+        return true;
     }
 
     void MQTTClient::on_error(MQTT_NS::error_code ec) {
-        error("MQTT error: {}", ec.message());
+        logger().error("MQTT error from {}: {}", options.name, ec.message());
+
+        // mqtt_cpp doesn't call the close handler when the connection dies on its own
+        on_close();
     }
 
     bool MQTTClient::on_suback(packet_id_t packet_id, std::vector<MQTT_NS::suback_return_code> results) {
 
-        info("subscribe acknowledged! packet_id: {}", packet_id);
+        logger().info("subscribe acknowledged! packet_id: {}", packet_id);
 
         for (auto const &e: results) {
-            debug("[client] subscribe packet_id: {}, result: {}", packet_id, MQTT_NS::suback_return_code_to_str(e));
+            logger().debug("[client] subscribe packet_id: {}, result: {}", packet_id, MQTT_NS::suback_return_code_to_str(e));
         }
 
         return true;
@@ -208,6 +784,7 @@ namespace creatures {
 
     bool MQTTClient::on_publish(MQTT_NS::optional<packet_id_t> packet_id, MQTT_NS::publish_options pubopts,
                                 MQTT_NS::buffer topic_name, MQTT_NS::buffer contents) {
+        TRACE_ZONE("MQTTClient::on_publish");
 
         /*
          * This isn't my normal style, but the MQTT library makes heavy use of the stream operators. That's fine,
@@ -221,13 +798,47 @@ namespace creatures {
         coss << contents;
         std::string contents_str = coss.str();
 
-        debug("received a message on topic {}: {}", topic_str, contents_str);
+        logger().debug("received a message on topic {}: {}", topic_str, contents_str);
+
+        // Is someone changing a log level?
+        if (auto component = topicName(topic_str, loggingTopicPrefix, loggingTopicSuffix)) {
+            return on_log_level(*component, contents_str);
+        }
+
+        // The leader election has topics of its own
+        if (election && election->message(topic_str, contents_str)) {
+            return true;
+        }
+
+        // While we're a standby, anything else is the leader telling us about a window
+        if (standby) {
+            return on_leader_state(topic_str, contents_str);
+        }
+
+        // ...and right after connecting, it's what's left over from the last time
+        if (readingRetained && pubopts.get_retain() == MQTT_NS::retain::yes &&
+            on_retained_state(topic_str, contents_str)) {
+            return true;
+        }
+
+        // Someone asking about the past?
+        if (topic_str == historyQueryTopic) {
+            return on_history_query(contents_str);
+        }
+
+        // A whole group, or a scene?
+        if (auto group = topicName(topic_str, groupTopicPrefix, groupTopicSuffix)) {
+            return on_group_command(*group, contents_str);
+        }
+        if (auto scene = topicName(topic_str, sceneTopicPrefix, sceneTopicSuffix)) {
+            return on_scene(*scene, contents_str);
+        }
 
         // Figure out which window
         for (auto const &window: windows) {
             std::string prefix = window->createPrefix();
             if (topic_str == prefix + "command") {
-                debug("received a command for window {}", window->getName());
+                logger().debug("received a command for window {}", window->getName());
 
                 uint8_t windowId;
                 switch (window->getNumber()) {
@@ -244,42 +855,415 @@ namespace creatures {
                         windowId = WINDOW_4;
                         break;
                     default:
-                        error("unknown window number: {}", window->getNumber());
+                        logger().error("unknown window number: {}", window->getNumber());
                         return false;
                 }
-                debug("windowId: {}", windowId);
+                logger().debug("windowId: {}", windowId);
 
                 // Now figure out which command
+                auto request = parseCommandRequest(contents_str);
+                if (!request) {
+                    logger().error("couldn't parse a command for {}: {}", window->getName(), contents_str);
+                    return false;
+                }
+
                 uint8_t commandId;
-                switch (contents_str[0]) {
+                switch (request->command.empty() ? '\0' : request->command[0]) {
                     case 'o':
-                        info("opening window {}", window->getName());
+                        logger().info("opening window {}", window->getName());
                         commandId = CMD_OPEN;
                         break;
                     case 'c':
-                        info("closing window {}", window->getName());
+                        logger().info("closing window {}", window->getName());
                         commandId = CMD_CLOSE;
                         break;
                     case 's':
-                        info("opening stopping {}", window->getName());
+                        logger().info("opening stopping {}", window->getName());
                         commandId = CMD_STOP;
                         break;
                     default:
-                        error("unknown command received for {}: ", window->getName(), contents_str);
+                        logger().error("unknown command received for {}: ", window->getName(), contents_str);
+                        publishResult(topic_str + resultTopicSuffix,
+                                      CommandTracker::result(request->id, "rejected"), request->id);
                         return false;
                 }
 
                 // ...and send it
-                debug("sending command {} to window {}", commandId, window->getName());
-                std::vector<uint8_t> command = {SRC_CONTROLLER, DST_PANEL_1, windowId, commandId};
-                command.push_back(creatures::Window::calculateChecksum(command));
-                outgoingSocketMessages->enqueue(std::move(command));
+                logger().debug("sending command {} to window {}", commandId, window->getName());
+                sendCommands({{window, commandId}}, *request, topic_str + resultTopicSuffix);
+            }
+        }
+
+
+        return true;
+    }
+
+    bool MQTTClient::on_v5_publish(MQTT_NS::optional<packet_id_t> packet_id, MQTT_NS::publish_options pubopts,
+                                   MQTT_NS::buffer topic_name, MQTT_NS::buffer contents,
+                                   MQTT_NS::v5::properties props) {
+
+        // If the sender told us when they sent this, make sure it isn't too old to act on
+        std::optional<int64_t> sentMs;
+        for (const auto &prop: props) {
+            MQTT_NS::visit(
+                    MQTT_NS::make_lambda_visitor(
+                            [&](const MQTT_NS::v5::property::user_property &p) {
+                                if (std::string_view(p.key()) == "timestamp") {
+                                    sentMs = std::strtoll(std::string(p.val()).c_str(), nullptr, 10);
+                                }
+                            },
+                            [](const auto &) {}
+                    ),
+                    prop
+            );
+        }
+
+        if (sentMs && options.commandMaxAge.count() > 0) {
+            auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+            auto ageMs = nowMs - *sentMs;
+            if (ageMs > std::chrono::duration_cast<std::chrono::milliseconds>(options.commandMaxAge).count()) {
+                logger().warn("dropping a stale message on {}: it was sent {}ms ago", std::string_view(topic_name), ageMs);
+                return true;
             }
         }
 
+        return on_publish(packet_id, pubopts, std::move(topic_name), std::move(contents));
+    }
+
+    bool MQTTClient::on_log_level(const std::string &component, const std::string &level) {
+
+        if (!logging::exists(component)) {
+            logger().warn("ignoring a log level for unknown component {}", component);
+            return false;
+        }
+
+        if (!logging::setLevel(component, level)) {
+            logger().warn("ignoring unknown log level '{}' for component {}", level, component);
+            return false;
+        }
 
+        logger().info("log level for component {} is now {}", component, level);
         return true;
     }
 
+    bool MQTTClient::on_group_command(const std::string &group, const std::string &payload) {
+
+        auto resultTopic = groupTopicPrefix + group + groupTopicSuffix + resultTopicSuffix;
+
+        auto request = parseCommandRequest(payload);
+        if (!request) {
+            logger().error("couldn't parse a command for group {}: {}", group, payload);
+            return false;
+        }
+
+        const auto &command = request->command;
+        auto commandId = CommandCompiler::commandFromName(command);
+        if (!commandId) {
+            logger().error("unknown command received for group {}: {}", group, command);
+            publishResult(resultTopic, CommandTracker::result(request->id, "rejected"), request->id);
+            return false;
+        }
+
+        std::vector<WindowCommand> commands;
+
+        // "all" is always there, unless someone defined their own
+        const auto *members = groups.group(group);
+        if (members == nullptr && group == "all") {
+            for (const auto &window: windows) {
+                commands.push_back({window, *commandId});
+            }
+        } else if (members == nullptr) {
+            logger().error("command received for unknown group {}", group);
+            return false;
+        } else {
+            for (const auto &name: *members) {
+                if (auto window = findWindow(name)) {
+                    commands.push_back({window, *commandId});
+                } else {
+                    logger().warn("group {} has an unknown window: {}", group, name);
+                }
+            }
+        }
+
+        logger().info("sending {} to group {} ({} windows)", command, group, commands.size());
+        return sendCommands(commands, *request, resultTopic);
+    }
+
+    bool MQTTClient::on_scene(const std::string &scene, const std::string &payload) {
+
+        auto resultTopic = sceneTopicPrefix + scene + sceneTopicSuffix + resultTopicSuffix;
+
+        // Scenes don't need a command, but they can still have an id
+        auto request = parseCommandRequest(payload);
+        if (!request) {
+            logger().error("couldn't parse an activation for scene {}: {}", scene, payload);
+            return false;
+        }
+        request->command = "scene";
+
+        const auto *steps = groups.scene(scene);
+        if (steps == nullptr) {
+            logger().error("activation received for unknown scene {}", scene);
+            publishResult(resultTopic, CommandTracker::result(request->id, "rejected"), request->id);
+            return false;
+        }
+
+        std::vector<WindowCommand> commands;
+        for (const auto &[name, commandId]: *steps) {
+            if (auto window = findWindow(name)) {
+                commands.push_back({window, commandId});
+            } else {
+                logger().warn("scene {} has an unknown window: {}", scene, name);
+            }
+        }
+
+        logger().info("activating scene {} ({} windows)", scene, commands.size());
+        return sendCommands(commands, *request, resultTopic);
+    }
+
+    bool MQTTClient::on_history_query(const std::string &payload) {
+
+        json query = json::parse(payload, nullptr, false);
+        if (query.is_discarded() || !query.is_object()) {
+            logger().error("couldn't parse a history query: {}", payload);
+            return false;
+        }
+
+        auto replyTo = historyResultTopic;
+        bool badReplyTo = false;
+        if (query.contains("reply_to") && query["reply_to"].is_string()) {
+            auto asked = query["reply_to"].get<std::string>();
+            if (isHistoryReplyTopic(asked)) {
+                replyTo = std::move(asked);
+            } else {
+                logger().warn("not answering a history query on {}, it's not under {}", asked, historyReplyPrefix);
+                badReplyTo = true;
+            }
+        }
+        json response = {{"id", query.contains("id") ? query["id"] : json()}};
+
+        // We're already on the io thread. Not retained, this is only for whoever asked.
+        auto reply = [this, &replyTo](const json &body) {
+            inflightPublishes++;
+            client->async_publish(replyTo, body.dump(), MQTT_NS::qos::at_least_once);
+            return true;
+        };
+
+        // Tell them why on the usual topic, since they'll be waiting on one we won't use
+        if (badReplyTo) {
+            response["error"] = "reply_to has to be under " + historyReplyPrefix + " with no wildcards";
+            return reply(response);
+        }
+
+        if (!stateHistory) {
+            response["error"] = "history is turned off";
+            return reply(response);
+        }
+
+        // value() throws if something's there but the wrong type, and that's the asker's problem, not ours
+        std::string windowName;
+        std::string fieldName;
+        int64_t sinceMs;
+        int64_t untilMs;
+        try {
+            auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+            windowName = query.value("window", std::string());
+            fieldName = query.value("field", std::string());
+            untilMs = query.value("until", static_cast<int64_t>(nowMs));
+            sinceMs = query.value("since", untilMs - static_cast<int64_t>(query.value("hours", 24.0) * 3600 * 1000));
+        } catch (const json::exception &e) {
+            response["error"] = e.what();
+            return reply(response);
+        }
+
+        if (!findWindow(windowName)) {
+            response["error"] = "unknown window";
+            return reply(response);
+        }
+
+        // Every status bit, unless they only care about one
+        uint8_t mask = 0x3F;
+        if (!fieldName.empty()) {
+            auto field = windowFieldFromName(fieldName);
+            if (!field || *field == WindowField::LastPolled) {
+                response["error"] = "unknown field";
+                return reply(response);
+            }
+            mask = static_cast<uint8_t>(1 << static_cast<uint8_t>(*field));
+        }
+
+        auto result = stateHistory->query(windowName, mask, sinceMs, untilMs);
+        if (!result) {
+            response["error"] = "nothing heard from that window yet";
+            return reply(response);
+        }
+
+        logger().debug("history query for {} ({}) found {} changes", windowName,
+                       fieldName.empty() ? "everything" : fieldName, result->transitions.size());
+
+        response["window"] = windowName;
+        response["since"] = sinceMs;
+        response["until"] = untilMs;
+        response["complete"] = result->complete;
+
+        // With a field, it's just that field's value. Otherwise the whole status byte and what changed.
+        auto transitions = json::array();
+        if (!fieldName.empty()) {
+            response["field"] = fieldName;
+            if (result->initialStatus) {
+                response["initial"] = (*result->initialStatus & mask) != 0;
+            }
+            for (const auto &transition: result->transitions) {
+                transitions.push_back({{"time", transition.timeMs}, {"value", (transition.status & mask) != 0}});
+            }
+        } else {
+            if (result->initialStatus) {
+                response["initial"] = *result->initialStatus;
+            }
+            for (const auto &transition: result->transitions) {
+                transitions.push_back({{"time", transition.timeMs}, {"status", transition.status},
+                                       {"changed", transition.changed}});
+            }
+        }
+        response["transitions"] = std::move(transitions);
+
+        return reply(response);
+    }
+
+    std::optional<std::pair<std::shared_ptr<Window>, std::size_t>>
+    MQTTClient::followField(const std::string &topic, const std::string &payload) {
+
+        for (const auto &window: ownedWindows) {
+            auto &windowFields = fields[window->getName()];
+            for (std::size_t i = 0; i < windowFieldCount; i++) {
+                if (windowFields.topics[i] != topic) {
+                    continue;
+                }
+
+                // Anything that's already out there, we don't have to say again
+                windowFields.throttles[i].published(payload, std::chrono::steady_clock::now());
+                return std::pair{window, i};
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    bool MQTTClient::on_retained_state(const std::string &topic, const std::string &payload) {
+        if (!followField(topic, payload)) {
+            return false;
+        }
+
+        logger().trace("{} already has {} as {}", options.name, topic, payload);
+        return true;
+    }
+
+    bool MQTTClient::on_leader_state(const std::string &topic, const std::string &payload) {
+
+        auto followed = followField(topic, payload);
+        if (!followed) {
+            return false;
+        }
+
+        if (options.warmWindows) {
+            const auto &[window, i] = *followed;
+            auto field = static_cast<WindowField>(i);
+            auto state = window->getState();
+            if (field == WindowField::LastPolled) {
+                if (auto polledAt = Window::parseISO8601(payload)) {
+                    window->restore(state.statusByte, *polledAt);
+                }
+            } else {
+                // The yes/no fields line up with the bits of the status byte
+                auto bit = static_cast<uint8_t>(1 << i);
+                uint8_t status = payload == yesOrNo(true) ? state.statusByte | bit : state.statusByte & ~bit;
+                window->restore(status, state.lastPolled);
+            }
+        }
+
+        logger().trace("following the leader: {} is {}", topic, payload);
+        return true;
+    }
+
+    std::shared_ptr<Window> MQTTClient::findWindow(const std::string &name) const {
+        for (const auto &window: windows) {
+            if (window->getName() == name) {
+                return window;
+            }
+        }
+        return nullptr;
+    }
+
+    bool MQTTClient::sendCommands(const std::vector<WindowCommand> &commands, const CommandRequest &request,
+                                  const std::string &resultTopic) {
+
+        // A bridge between our brokers means the same command shows up on each of them
+        if (commandTracker->isDuplicate(options.name, resultTopic + " " + request.command + " " + request.id)) {
+            return true;
+        }
+
+        auto frames = compiler.compile(commands);
+        logger().debug("{} window commands became {} frames", commands.size(), frames.size());
+
+        std::vector<uint8_t> panels;
+        std::size_t queued = 0;
+        auto tag = commandTracker->newTag();
+        for (auto &frame: frames) {
+            if (std::find(panels.begin(), panels.end(), frame[1]) == panels.end()) {
+                panels.push_back(frame[1]);
+            }
+            // Dropped (drop_newest) never goes out either, it just doesn't complain about it
+            if (transmitScheduler->enqueue(std::move(frame), TrafficClass::Command, tag) != EnqueueResult::Queued) {
+                logger().error("the bus is backed up, a command from {} was not sent", options.name);
+            } else {
+                queued++;
+            }
+        }
+
+        if (queued < frames.size()) {
+            publishResult(resultTopic, CommandTracker::result(request.id, "rejected"), request.id);
+            if (queued == 0) {
+                return false;
+            }
+        }
+
+        // Follow it along, even if nobody asked, so the controller's ACKs line up with the right command
+        CommandTracker::ResultPublisher publisher;
+        if (!request.id.empty() && queued == frames.size()) {
+            publisher = [this, resultTopic, id = request.id](const std::string &payload) {
+                publishResult(resultTopic, payload, id);
+            };
+        }
+        commandTracker->track(tag, request, CommandTracker::targets(commands), queued, std::move(publisher));
+
+        // Ask right away how it went, rather than waiting on the next regular poll
+        for (auto panel: panels) {
+            transmitScheduler->enqueue(CommandCompiler::createFrame(panel, WINDOW_ALL, CMD_STATUS_WITHOUT_POLL),
+                                       TrafficClass::ConfirmPoll);
+        }
+
+        return queued == frames.size();
+    }
+
+    void MQTTClient::publishResult(const std::string &topic, const std::string &payload, const std::string &id) {
+
+        // Nobody asked
+        if (id.empty()) {
+            return;
+        }
+
+        boost::asio::post(ioc, [this, topic, payload] {
+            if (!connected) {
+                logger().warn("not connected to {}, dropping a command result", options.name);
+                return;
+            }
+
+            // Results aren't retained, they only mean something to whoever's listening right now
+            inflightPublishes++;
+            client->async_publish(topic, payload, MQTT_NS::qos::at_least_once);
+        });
+    }
 
 } // creatures
\ No newline at end of file
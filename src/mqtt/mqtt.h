@@ -5,9 +5,21 @@
 #ifndef ANDERSEN_MQTT_MQTT_H
 #define ANDERSEN_MQTT_MQTT_H
 
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
 
+#include "mqtt/command_tracker.h"
+#include "mqtt/leader_election.h"
+#include "mqtt/publish_policy.h"
+#include "mqtt/shard_ring.h"
+#include "threading/handler_memory.h"
+#include "window/command_compiler.h"
+#include "window/groups.h"
 #include "window/window.h"
 
 #include <mqtt_client_cpp.hpp>
@@ -23,44 +35,253 @@
 
 namespace creatures {
 
-    using MQTTClientType = decltype(MQTT_NS::make_sync_client(std::declval<boost::asio::io_context&>(), "localhost", "1883"));
+    using MQTTClientType = decltype(MQTT_NS::make_async_client(std::declval<boost::asio::io_context&>(), "localhost", "1883"));
     using packet_id_t = typename MQTTClientType::element_type::packet_id_t;
 
+    /**
+     * Knobs for how we talk to the broker
+     */
+    struct MQTTOptions {
+
+        // What we call this broker in the logs
+        std::string name = "mqtt";
+
+        // What we call ourselves to the broker. Every connection to the same broker needs its own.
+        std::string clientId = "andersen-mqtt";
+
+        // Which of this broker's connections this is, and how many there are. Each one looks
+        // after its own share of the windows (see ShardRing).
+        std::size_t shard = 0;
+        std::size_t shards = 1;
+
+        // Speak MQTT v5 instead of v3.1.1
+        bool v5 = false;
+
+        // v5 only: how many QoS1 commands the broker can have in flight to us at once
+        uint16_t receiveMaximum = 16;
+
+        // v5 only: commands with a "timestamp" user property older than this are dropped (0 = never)
+        std::chrono::seconds commandMaxAge{30};
+
+        // QoS1 publishes we'll leave waiting on a PUBACK before holding off (a v5 broker can ask for fewer)
+        uint16_t maxInflight = 64;
+
+        // How long to wait before trying to connect again. It doubles every time it doesn't work.
+        std::chrono::milliseconds reconnectDelay{1000};
+        std::chrono::milliseconds maxReconnectDelay{60000};
+
+        // With failover, what this instance is called (empty if we're on our own). Our will goes on
+        // the instance's own topic then, so a standby falling over doesn't mark everything offline.
+        std::string instance;
+
+        // Start out as a standby, only following what the leader publishes until promote()
+        bool standby = false;
+
+        // ...and keep the windows themselves up to date from it. Only one broker's connections
+        // should do this, so the windows aren't written from two places.
+        bool warmWindows = false;
+    };
+
     class MQTTClient {
     public:
-        MQTTClient(std::string host, std::string port);
-        ~MQTTClient() = default;
+        MQTTClient(std::string host, std::string port, MQTTOptions options = {});
+        ~MQTTClient();
 
+        /**
+         * Starts the io thread, which connects (and keeps reconnecting) on its own. A broker
+         * that's slow or gone only ever holds up its own thread.
+         */
         void start();
-        void stop();
+
+        /**
+         * Waits for our QoS1 publishes to be acknowledged, disconnects cleanly, and stops the
+         * io thread, all in under timeout
+         */
+        void stop(std::chrono::milliseconds timeout = std::chrono::milliseconds(100));
+
+        /**
+         * Same as stop(), but for every client at once. They all say goodbye at the same time
+         * and share the one deadline, so it takes no longer with ten brokers than with one.
+         */
+        static void stopAll(const std::vector<MQTTClient *> &clients,
+                            std::chrono::milliseconds timeout = std::chrono::milliseconds(100));
+        static void stopAll(const std::vector<std::unique_ptr<MQTTClient>> &clients,
+                            std::chrono::milliseconds timeout = std::chrono::milliseconds(100));
 
         void addWindow(std::shared_ptr<Window> window);
+        void setPublishPolicy(const PublishPolicy &policy);
+        void setGroups(const WindowGroups &groups);
+
+        /**
+         * Publish what the windows already know (restored from a snapshot, say) as soon as
+         * we're connected, instead of waiting for the first poll
+         */
+        void setPublishOnConnect(bool publish) { publishOnConnect = publish; }
+
+        /**
+         * Runs the leader election over this connection. Only one connection gets this.
+         */
+        void setLeaderElection(std::shared_ptr<LeaderElection> newElection);
+
+        /**
+         * We're the leader now. Stops following the old leader, subscribes to commands, and
+         * starts looking after availability. Safe to call from any thread.
+         */
+        void promote();
+
+        /**
+         * Another instance is taking over, so don't mark everything offline when we stop
+         */
+        void setHandingOver(bool isHandingOver) { handingOver = isHandingOver; }
+
+        [[nodiscard]] bool isConnected() const { return connected; }
+
+        /**
+         * Marks a window (or the gateway itself, if window is null) online or offline. These
+         * are retained, and put back every time we connect. Safe to call from any thread.
+         */
+        void setAvailability(const std::shared_ptr<Window> &window, bool isOnline);
+
+        /**
+         * The io_context our thread runs. Other small async things (like the HTTP API) can live here too.
+         */
+        boost::asio::io_context &getIoContext() { return ioc; }
 
         bool subscribe(std::string topic, MQTT_NS::qos qos);
 
         bool on_connack(bool sp, mqtt::connect_return_code connack_return_code);
+        bool on_v5_connack(bool sp, MQTT_NS::v5::connect_reason_code reason_code, MQTT_NS::v5::properties props);
         void on_close();
-        static void on_error(MQTT_NS::error_code ec);
+        void on_error(MQTT_NS::error_code ec);
+        bool on_puback(packet_id_t packet_id);
         static bool on_suback(packet_id_t packet_id, std::vector<MQTT_NS::suback_return_code> results);
         bool on_publish(MQTT_NS::optional<packet_id_t> packet_id,
                         MQTT_NS::publish_options pubopts,
                         MQTT_NS::buffer topic_name,
                         MQTT_NS::buffer contents);
+        bool on_v5_publish(MQTT_NS::optional<packet_id_t> packet_id,
+                           MQTT_NS::publish_options pubopts,
+                           MQTT_NS::buffer topic_name,
+                           MQTT_NS::buffer contents,
+                           MQTT_NS::v5::properties props);
+        bool on_log_level(const std::string &component, const std::string &level);
+        bool on_group_command(const std::string &group, const std::string &payload);
+        bool on_scene(const std::string &scene, const std::string &payload);
+        bool on_history_query(const std::string &payload);
+        bool on_leader_state(const std::string &topic, const std::string &payload);
+        bool on_retained_state(const std::string &topic, const std::string &payload);
 
+        /**
+         * Queues a publish of every window on our io thread. Only one is ever waiting, since
+         * it reads the windows (each one in a single atomic load) when it runs. Safe to call
+         * from any thread.
+         */
         bool publishWindows(bool forcePublish);
         bool subscribe(std::shared_ptr<Window> window);
 
     private:
 
-        bool connected;
+        std::atomic<bool> connected;
+        std::atomic<bool> publishOnConnect = false;
+        std::atomic<bool> stopping = false;
+        std::atomic<bool> standby = false;
+        std::atomic<bool> handingOver = false;
+
+        // Only set on the connection the leader election runs over
+        std::shared_ptr<LeaderElection> election;
+
+        void connect();
+        void scheduleReconnect();
+        void publishNow(bool forcePublish);
+
+        // The steps of stopAll()
+        void beginStop();
+        [[nodiscard]] bool flushed() const;
+        void disconnect();
+        void finishStop();
+
+        // publishWindows() hands off to the io thread through these
+        std::atomic<bool> publishQueued = false;
+        std::atomic<bool> pendingForce = false;
+        HandlerMemory publishMemory;
+
+        // Set when the broker got too far behind on PUBACKs. Only touched on the io thread.
+        bool publishDeferred = false;
+        bool deferredForce = false;
+        uint16_t inflightLimit;
+
+        // Right after connecting with state to publish, we first find out what the broker already
+        // has retained, so we only send what's different. Only touched on the io thread.
+        bool readingRetained = false;
+        bool catchingUp = false;
+        void readRetained();
+        void finishReadingRetained();
+
+        // Remembers a field value someone else put on the broker. Which window and field it was, if it's one of ours.
+        std::optional<std::pair<std::shared_ptr<Window>, std::size_t>>
+        followField(const std::string &topic, const std::string &payload);
+
+        static const std::string &yesOrNo(bool value);
 
-        static std::string yesOrNo(bool value);
+        void subscribeCommands(const std::string &topic);
+        void subscribeAll();
+        std::shared_ptr<Window> findWindow(const std::string &name) const;
+        bool sendCommands(const std::vector<WindowCommand> &commands, const CommandRequest &request,
+                          const std::string &resultTopic);
+        void publishResult(const std::string &topic, const std::string &payload, const std::string &id);
 
+        void publishRetained(const std::string &topic, const std::string &payload, MQTT_NS::qos qos,
+                             std::chrono::system_clock::time_point frameTime);
+        void publishField(const std::shared_ptr<Window> &window, WindowField field, const std::string &value,
+                          const Window::State &state, bool forcePublish, std::chrono::steady_clock::time_point now);
 
-        // Keep track of our windows
+        MQTTOptions options;
+
+        // v5 topic aliases. These only last as long as the connection does.
+        std::mutex topicAliasMutex;
+        std::unordered_map<std::string, uint16_t> topicAliases;
+        uint16_t topicAliasMaximum = 0;
+
+        // What goes out when, and what we last sent for each window's fields
+        PublishPolicy publishPolicy;
+        struct WindowFields {
+            std::array<std::string, windowFieldCount> topics;   // built once, so publishing doesn't have to
+            std::array<FieldThrottle, windowFieldCount> throttles;
+        };
+        std::unordered_map<std::string, WindowFields> fields;
+
+        // lastPolled gets formatted into this every pass, so it can keep reusing the same storage
+        std::string lastPolledScratch;
+
+        // Whether we've told startup about our first publish yet. Only touched on the io thread.
+        bool startupFinished = false;
+
+        // What we've said about availability, by topic. Only touched on the io thread once we've started.
+        std::map<std::string, bool> availability;
+
+        // QoS1 publishes that haven't been PUBACK'ed yet
+        std::atomic<int64_t> inflightPublishes = 0;
+
+
+        // Keep track of our windows, and the ones this shard publishes and takes commands for
         std::vector<std::shared_ptr<Window>> windows;
+        std::vector<std::shared_ptr<Window>> ownedWindows;
+        ShardRing shardRing;
+
+        // How much publishing we've done, for the log when we stop
+        std::atomic<uint64_t> publishCount = 0;
+        std::atomic<uint64_t> publishPasses = 0;
+        std::atomic<uint64_t> publishMicroseconds = 0;
+
+        // Groups and scenes, and what turns them into as few frames as possible
+        WindowGroups groups;
+        CommandCompiler compiler;
 
         boost::asio::io_context ioc;
+        boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+        boost::asio::steady_timer reconnectTimer;
+        boost::asio::steady_timer retainedTimer;
+        std::chrono::milliseconds nextReconnectDelay;
         std::string host;
         std::string port;
 
@@ -0,0 +1,177 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include "namespace-stuffs.h"
+
+#include "publish_policy.h"
+
+namespace creatures {
+
+    namespace {
+
+        constexpr std::array<const char *, windowFieldCount> fieldNames = {
+                "open",
+                "movement_obstructed",
+                "screen_missing",
+                "rf_heard",
+                "rain_sensed",
+                "rain_override_active",
+                "last_polled"
+        };
+
+        std::optional<std::chrono::milliseconds> parseSeconds(const std::string &value) {
+            char *end = nullptr;
+            double seconds = std::strtod(value.c_str(), &end);
+            if (end == value.c_str() || *end != '\0' || seconds < 0) {
+                return std::nullopt;
+            }
+            return std::chrono::milliseconds(static_cast<int64_t>(seconds * 1000));
+        }
+
+        bool applyOption(FieldPolicy &policy, const std::string &option, const std::string &value) {
+
+            if (option == "qos") {
+                if (value != "0" && value != "1" && value != "2") {
+                    return false;
+                }
+                policy.qos = static_cast<uint8_t>(value[0] - '0');
+                return true;
+            }
+
+            if (option == "immediate") {
+                if (value != "yes" && value != "no") {
+                    return false;
+                }
+                policy.immediate = value == "yes";
+                return true;
+            }
+
+            auto duration = parseSeconds(value);
+            if (!duration) {
+                return false;
+            }
+
+            if (option == "min_interval") {
+                policy.minInterval = *duration;
+            } else if (option == "heartbeat") {
+                policy.heartbeat = *duration;
+            } else if (option == "debounce") {
+                policy.debounce = *duration;
+            } else {
+                return false;
+            }
+            return true;
+        }
+    }
+
+
+    const char *windowFieldName(WindowField field) {
+        return fieldNames[static_cast<std::size_t>(field)];
+    }
+
+    std::optional<WindowField> windowFieldFromName(const std::string &name) {
+        for (std::size_t i = 0; i < fieldNames.size(); i++) {
+            if (name == fieldNames[i]) {
+                return static_cast<WindowField>(i);
+            }
+        }
+        return std::nullopt;
+    }
+
+
+    PublishPolicy::PublishPolicy() {
+        using namespace std::chrono_literals;
+
+        // These are the whole reason anyone is watching, never hold them back
+        policies[static_cast<std::size_t>(WindowField::RainSensed)].immediate = true;
+        policies[static_cast<std::size_t>(WindowField::MovementObstructed)].immediate = true;
+
+        // These bounce around while a window is moving
+        policies[static_cast<std::size_t>(WindowField::RfHeard)].debounce = 10s;
+        policies[static_cast<std::size_t>(WindowField::ScreenMissing)].debounce = 10s;
+
+        // This changes on every poll. Once a minute is plenty to show we're alive.
+        auto &lastPolled = policies[static_cast<std::size_t>(WindowField::LastPolled)];
+        lastPolled.minInterval = 60s;
+        lastPolled.qos = 0;
+    }
+
+    bool PublishPolicy::apply(const std::string &overrides) {
+
+        bool good = true;
+
+        std::istringstream fields(overrides);
+        std::string entry;
+        while (std::getline(fields, entry, ';')) {
+            if (entry.empty()) {
+                continue;
+            }
+
+            auto colon = entry.find(':');
+            auto field = windowFieldFromName(entry.substr(0, colon));
+            if (colon == std::string::npos || !field) {
+                warn("ignoring publish policy for unknown field: {}", entry);
+                good = false;
+                continue;
+            }
+
+            FieldPolicy policy = get(*field);
+
+            std::istringstream options(entry.substr(colon + 1));
+            std::string option;
+            while (std::getline(options, option, ',')) {
+                auto equals = option.find('=');
+                if (equals == std::string::npos ||
+                    !applyOption(policy, option.substr(0, equals), option.substr(equals + 1))) {
+                    warn("ignoring bad publish policy option for {}: {}", windowFieldName(*field), option);
+                    good = false;
+                }
+            }
+
+            set(*field, policy);
+        }
+
+        return good;
+    }
+
+
+    bool FieldThrottle::shouldPublish(const FieldPolicy &policy, const std::string &value, bool force,
+                                      std::chrono::steady_clock::time_point now) {
+
+        if (force || !havePublished) {
+            return true;
+        }
+
+        // Same as what's out there? Then only a heartbeat gets it sent again.
+        if (value == lastValue) {
+            havePending = false;
+            return policy.heartbeat.count() > 0 && now - lastPublishedAt >= policy.heartbeat;
+        }
+
+        if (policy.immediate) {
+            return true;
+        }
+
+        // Start the debounce clock over every time the value moves
+        if (!havePending || value != pendingValue) {
+            havePending = true;
+            pendingValue = value;
+            pendingSince = now;
+        }
+
+        return now - pendingSince >= policy.debounce && now - lastPublishedAt >= policy.minInterval;
+    }
+
+    void FieldThrottle::published(const std::string &value, std::chrono::steady_clock::time_point now) {
+        havePublished = true;
+        lastValue = value;
+        lastPublishedAt = now;
+        havePending = false;
+    }
+
+} // creatures
@@ -0,0 +1,128 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_PUBLISH_POLICY_H
+#define ANDERSEN_MQTT_PUBLISH_POLICY_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace creatures {
+
+    /**
+     * The things we publish for every window
+     */
+    enum class WindowField : uint8_t {
+        Open = 0,
+        MovementObstructed,
+        ScreenMissing,
+        RfHeard,
+        RainSensed,
+        RainOverrideActive,
+        LastPolled
+    };
+
+    constexpr std::size_t windowFieldCount = 7;
+
+    /**
+     * The name of a field, which is also the last part of its topic
+     */
+    const char *windowFieldName(WindowField field);
+    std::optional<WindowField> windowFieldFromName(const std::string &name);
+
+
+    /**
+     * How one field gets published
+     */
+    struct FieldPolicy {
+
+        // Never publish a change more often than this
+        std::chrono::milliseconds minInterval{0};
+
+        // Republish the current value this often, even if it hasn't changed (0 = never)
+        std::chrono::milliseconds heartbeat{0};
+
+        // A new value has to hold this long before it goes out, so flapping is ignored
+        std::chrono::milliseconds debounce{0};
+
+        uint8_t qos = 1;
+
+        // Changes skip the min interval and debounce and go out right away
+        bool immediate = false;
+    };
+
+
+    /**
+     * The policy for every field. The defaults keep last_polled to once a minute, wait out
+     * the bits that bounce around while a window is moving, and never hold back rain or
+     * obstruction changes.
+     */
+    class PublishPolicy {
+
+    public:
+        PublishPolicy();
+
+        /**
+         * Applies overrides in the form "field:option=value,option=value;field:..."
+         *
+         * Options are min_interval, heartbeat, and debounce (in seconds), qos (0-2), and
+         * immediate (yes/no). For example: "last_polled:min_interval=300,qos=0;rf_heard:debounce=30"
+         *
+         * @return false if any of it didn't make sense (the parts that did are still applied)
+         */
+        bool apply(const std::string &overrides);
+
+        [[nodiscard]] const FieldPolicy &get(WindowField field) const {
+            return policies[static_cast<std::size_t>(field)];
+        }
+
+        void set(WindowField field, const FieldPolicy &policy) {
+            policies[static_cast<std::size_t>(field)] = policy;
+        }
+
+    private:
+        std::array<FieldPolicy, windowFieldCount> policies;
+    };
+
+
+    /**
+     * Keeps track of what we last published for one field of one window and decides if the
+     * current value needs to go out
+     */
+    class FieldThrottle {
+
+    public:
+        // Room for a timestamp up front, so the first one that changes doesn't go to the heap
+        FieldThrottle() {
+            lastValue.reserve(valueCapacity);
+            pendingValue.reserve(valueCapacity);
+        }
+
+        bool shouldPublish(const FieldPolicy &policy, const std::string &value, bool force,
+                           std::chrono::steady_clock::time_point now);
+
+        void published(const std::string &value, std::chrono::steady_clock::time_point now);
+
+        // Is this what we (or whoever was here before us) last put out there?
+        [[nodiscard]] bool matches(const std::string &value) const { return havePublished && value == lastValue; }
+
+    private:
+        static constexpr std::size_t valueCapacity = 32;
+
+        bool havePublished = false;
+        std::string lastValue;
+        std::chrono::steady_clock::time_point lastPublishedAt;
+
+        // A change we've seen but haven't sent yet
+        bool havePending = false;
+        std::string pendingValue;
+        std::chrono::steady_clock::time_point pendingSince;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_PUBLISH_POLICY_H
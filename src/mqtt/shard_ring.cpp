@@ -0,0 +1,49 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+#include <string>
+
+#include "shard_ring.h"
+
+namespace creatures {
+
+    ShardRing::ShardRing(std::size_t shards, std::size_t pointsPerShard) : shards(std::max<std::size_t>(shards, 1)) {
+
+        points.reserve(this->shards * pointsPerShard);
+        for (std::size_t shard = 0; shard < this->shards; shard++) {
+            for (std::size_t point = 0; point < pointsPerShard; point++) {
+                points.emplace_back(hash("shard-" + std::to_string(shard) + "-" + std::to_string(point)), shard);
+            }
+        }
+        std::sort(points.begin(), points.end());
+    }
+
+    std::size_t ShardRing::shardFor(std::string_view key) const {
+        if (shards == 1) {
+            return 0;
+        }
+
+        auto point = std::lower_bound(points.begin(), points.end(), std::make_pair(hash(key), std::size_t{0}));
+        if (point == points.end()) {
+            point = points.begin();
+        }
+        return point->second;
+    }
+
+    uint64_t ShardRing::hash(std::string_view key) {
+        uint64_t value = 0xcbf29ce484222325ULL;
+        for (auto c: key) {
+            value ^= static_cast<uint8_t>(c);
+            value *= 0x100000001b3ULL;
+        }
+
+        // FNV alone leaves "window1" and "window2" too close together, so stir it up some more
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        return value;
+    }
+
+} // creatures
@@ -0,0 +1,45 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_SHARD_RING_H
+#define ANDERSEN_MQTT_SHARD_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace creatures {
+
+    /**
+     * Decides which of a broker's connections looks after which window, by consistent hashing.
+     *
+     * Every shard gets a bunch of points on a ring, and a window belongs to the first point
+     * at or after its own hash. Going from K to K+1 shards only moves about 1/(K+1) of the
+     * windows, so most subscriptions stay where they were.
+     *
+     * The hash is FNV-1a (with a bit of mixing) rather than std::hash, so a window lands on
+     * the same shard no matter what it was built with.
+     */
+    class ShardRing {
+
+    public:
+        explicit ShardRing(std::size_t shards, std::size_t pointsPerShard = 160);
+
+        [[nodiscard]] std::size_t shardFor(std::string_view key) const;
+        [[nodiscard]] std::size_t getShards() const { return shards; }
+
+    private:
+        static uint64_t hash(std::string_view key);
+
+        std::size_t shards;
+
+        // (point, shard), sorted by point
+        std::vector<std::pair<uint64_t, std::size_t>> points;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_SHARD_RING_H
@@ -0,0 +1,59 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "latency_stats.h"
+
+namespace creatures {
+
+    void LatencyStats::record(std::chrono::microseconds latency) {
+        if (!samples.empty() && latency.count() < samples.back()) {
+            sorted = false;
+        }
+        samples.push_back(latency.count());
+    }
+
+    void LatencyStats::recordTimeout(std::chrono::microseconds timeout) {
+        record(timeout);
+        timedOut++;
+    }
+
+    std::chrono::microseconds LatencyStats::percentile(double percent) const {
+        if (samples.empty()) {
+            return std::chrono::microseconds(0);
+        }
+        sort();
+
+        auto rank = static_cast<std::size_t>(std::ceil(percent / 100.0 * static_cast<double>(samples.size())));
+        auto index = std::clamp<std::size_t>(rank, 1, samples.size()) - 1;
+        return std::chrono::microseconds(samples[index]);
+    }
+
+    std::chrono::microseconds LatencyStats::min() const {
+        return percentile(0);
+    }
+
+    std::chrono::microseconds LatencyStats::max() const {
+        return percentile(100);
+    }
+
+    std::chrono::microseconds LatencyStats::mean() const {
+        if (samples.empty()) {
+            return std::chrono::microseconds(0);
+        }
+        auto total = std::accumulate(samples.begin(), samples.end(), int64_t{0});
+        return std::chrono::microseconds(total / static_cast<int64_t>(samples.size()));
+    }
+
+    void LatencyStats::sort() const {
+        if (!sorted) {
+            std::sort(samples.begin(), samples.end());
+            sorted = true;
+        }
+    }
+
+} // creatures
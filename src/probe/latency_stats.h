@@ -0,0 +1,64 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_LATENCY_STATS_H
+#define ANDERSEN_MQTT_LATENCY_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace creatures {
+
+    /**
+     * Every reply latency from a probe run, so we can pull exact percentiles out at the end.
+     *
+     * Even flat out the bus only manages a few hundred frames a second, so keeping all of
+     * them is cheaper than being clever with histograms.
+     */
+    class LatencyStats {
+
+    public:
+        LatencyStats() = default;
+        explicit LatencyStats(std::size_t expected) { samples.reserve(expected); }
+
+        void record(std::chrono::microseconds latency);
+
+        /**
+         * Something we gave up waiting on. It counts as taking the whole timeout, which is the
+         * least it took, so the percentiles don't look better for every reply that never came.
+         */
+        void recordTimeout(std::chrono::microseconds timeout);
+
+        [[nodiscard]] std::size_t count() const { return samples.size(); }
+
+        // How many of the samples are timeouts
+        [[nodiscard]] std::size_t timeouts() const { return timedOut; }
+
+        /**
+         * Nearest rank, so p99 of 100 samples is the 99th slowest one
+         *
+         * @param percent 0 to 100
+         * @return zero if nothing was recorded
+         */
+        [[nodiscard]] std::chrono::microseconds percentile(double percent) const;
+
+        [[nodiscard]] std::chrono::microseconds min() const;
+        [[nodiscard]] std::chrono::microseconds max() const;
+        [[nodiscard]] std::chrono::microseconds mean() const;
+
+    private:
+        void sort() const;
+
+        // Sorted the first time someone asks for a percentile
+        mutable std::vector<int64_t> samples;
+        mutable bool sorted = true;
+
+        std::size_t timedOut = 0;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_LATENCY_STATS_H
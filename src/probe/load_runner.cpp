@@ -0,0 +1,281 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <sys/socket.h>
+
+#include "load_runner.h"
+
+#include "logging/logging.h"
+#include "threading/threading.h"
+#include "window/command_compiler.h"
+#include "window/framer.h"
+
+namespace creatures {
+
+    namespace {
+        // Everything in here logs under the "probe" component
+        constexpr auto &logger = logging::component<"probe">;
+
+        // Flat out, a 9600 baud bus can't do much more than this many round trips a second
+        constexpr double flatOutRate = 100;
+    }
+
+    LoadRunner::LoadRunner(int socketFd, ProbeOptions options) : socketFd(socketFd), options(options) {}
+
+    std::optional<ProbeLoad> LoadRunner::loadFromName(const std::string &name) {
+        if (name == "polls") {
+            return ProbeLoad::Polls;
+        }
+        if (name == "commands") {
+            return ProbeLoad::Commands;
+        }
+        if (name == "mixed") {
+            return ProbeLoad::Mixed;
+        }
+        return std::nullopt;
+    }
+
+    std::string LoadRunner::loadName(ProbeLoad load) {
+        switch (load) {
+            case ProbeLoad::Polls:
+                return "polls";
+            case ProbeLoad::Commands:
+                return "commands";
+            case ProbeLoad::Mixed:
+                return "mixed";
+        }
+        return "unknown";
+    }
+
+    ProbeResults LoadRunner::run(std::stop_token stopToken) {
+        using clock = std::chrono::steady_clock;
+
+        bool polling = options.load != ProbeLoad::Commands;
+        bool bursting = options.load != ProbeLoad::Polls;
+
+        // Every frame we'll ever send, built once up front
+        auto pollFrame = CommandCompiler::createFrame(options.panel, WINDOW_ALL, CMD_STATUS_WITHOUT_POLL);
+        std::array<std::vector<uint8_t>, 4> commandFrames;
+        for (uint8_t i = 0; i < commandFrames.size(); i++) {
+            commandFrames[i] = CommandCompiler::createFrame(options.panel, WINDOW_1 + i, options.command);
+        }
+
+        // Keeping every sample means never growing the vectors in the middle of a run
+        auto seconds = static_cast<double>(options.duration.count());
+        auto expected = static_cast<std::size_t>(seconds * (options.rate > 0 ? options.rate : flatOutRate)) +
+                        static_cast<std::size_t>(seconds * 1000.0 / static_cast<double>(std::max<int64_t>(options.burstInterval.count(), 1))) *
+                        options.burst;
+        results = ProbeResults{};
+        results.all = LatencyStats(expected);
+        results.pollLatency = LatencyStats(polling ? expected : 0);
+        results.commandLatency = LatencyStats(bursting ? expected : 0);
+
+        std::jthread readerThread([this](std::stop_token readerToken) { reader(readerToken); });
+
+        auto pollPeriod = options.rate > 0
+                          ? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / options.rate))
+                          : clock::duration::zero();
+
+        auto start = clock::now();
+        auto end = start + options.duration;
+        auto nextPoll = start;
+        auto nextBurst = start;
+        std::size_t burstLeft = 0;
+        std::size_t commandIndex = 0;
+
+        std::mutex sleepMutex;
+        std::condition_variable_any sleeper;
+
+        while (!stopToken.stop_requested()) {
+            auto now = clock::now();
+            if (now >= end) {
+                break;
+            }
+
+            // Commands go first, same as in the daemon
+            if (bursting && burstLeft == 0 && now >= nextBurst) {
+                burstLeft = options.burst;
+                nextBurst = std::max(nextBurst + options.burstInterval, now);
+            }
+            if (burstLeft > 0) {
+                burstLeft--;
+                if (!sendAndWait(commandFrames[commandIndex++ % commandFrames.size()], FrameKind::Command, stopToken)) {
+                    break;
+                }
+                continue;
+            }
+
+            // If we've fallen behind, don't try to make up for the polls we missed. That'd just be a burst.
+            if (polling && now >= nextPoll) {
+                nextPoll = std::max(nextPoll + pollPeriod, now);
+                if (!sendAndWait(pollFrame, FrameKind::Poll, stopToken)) {
+                    break;
+                }
+                continue;
+            }
+
+            // Nothing to do until the next thing comes due
+            auto wakeAt = end;
+            if (polling) {
+                wakeAt = std::min(wakeAt, nextPoll);
+            }
+            if (bursting) {
+                wakeAt = std::min(wakeAt, nextBurst);
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeper.wait_until(lock, stopToken, wakeAt, [] { return false; });
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start);
+
+        // That's how recv() gets unblocked
+        readerThread.request_stop();
+        shutdown(socketFd, SHUT_RDWR);
+        readerThread.join();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.elapsed = elapsed;
+        return results;
+    }
+
+    void LoadRunner::reader(std::stop_token stopToken) {
+        threading::setup("reader");
+
+        Framer framer([this](const uint8_t *frame, size_t size) {
+            frameReceived(frame, size);
+        });
+
+        std::array<uint8_t, 1024> tempBuffer{};
+        while (!stopToken.stop_requested()) {
+            ssize_t received = recv(socketFd, tempBuffer.data(), tempBuffer.size(), 0);
+            if (received <= 0) {
+                if (!stopToken.stop_requested()) {
+                    logger().error("the gateway hung up on us");
+                }
+                break;
+            }
+            framer.feed(tempBuffer.data(), received);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.checksumErrors = framer.getChecksumErrors();
+        results.discardedBytes = framer.getDiscardedBytes();
+        closed = true;
+        replied.notify_all();
+    }
+
+    void LoadRunner::frameReceived(const uint8_t *frame, size_t size) {
+        auto now = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (awaitingLate && answers(awaitingKind, frame[2])) {
+            logger().debug("the answer to the last frame showed up late");
+            results.late++;
+            awaitingLate = false;
+            replied.notify_all();
+            return;
+        }
+        if (!awaitingReply || !answers(awaitingKind, frame[2])) {
+            logger().debug("got a {} byte frame (type 0x{:02X}) we weren't waiting on", size, frame[2]);
+            results.stray++;
+            return;
+        }
+
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - sentAt);
+        results.replies++;
+        results.all.record(latency);
+        if (awaitingKind == FrameKind::Poll) {
+            results.pollLatency.record(latency);
+        } else {
+            results.commandLatency.record(latency);
+        }
+
+        switch (frame[2]) {
+            case CMD_STATUS_WITH_POLL:
+            case CMD_STATUS_WITHOUT_POLL:
+                results.statuses++;
+                break;
+            case CONTROLLER_ACK:
+                results.acks++;
+                break;
+            case CONTROLLER_BUSY:
+                results.busy++;
+                break;
+            default:
+                break;
+        }
+
+        awaitingReply = false;
+        replied.notify_all();
+    }
+
+    bool LoadRunner::answers(FrameKind kind, uint8_t replyType) {
+        if (kind == FrameKind::Poll) {
+            return replyType == CMD_STATUS_WITHOUT_POLL || replyType == CMD_STATUS_WITH_POLL;
+        }
+        return replyType == CONTROLLER_ACK || replyType == CONTROLLER_BUSY;
+    }
+
+    bool LoadRunner::sendAndWait(const std::vector<uint8_t> &frame, FrameKind kind, std::stop_token stopToken) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed) {
+                return false;
+            }
+            awaitingReply = true;
+            awaitingKind = kind;
+            results.sent++;
+            if (kind == FrameKind::Poll) {
+                results.polls++;
+            } else {
+                results.commands++;
+            }
+            sentAt = std::chrono::steady_clock::now();
+        }
+
+        if (send(socketFd, frame.data(), frame.size(), MSG_NOSIGNAL) < 0) {
+            logger().error("couldn't send to the gateway: {}", std::strerror(errno));
+            return false;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            bool answered = replied.wait_for(lock, stopToken, options.replyTimeout,
+                                             [this] { return !awaitingReply || closed; });
+            if (closed) {
+                return false;
+            }
+
+            // Being asked to stop isn't the gateway's fault
+            if (!answered && !stopToken.stop_requested()) {
+                logger().debug("no reply after {}ms", options.replyTimeout.count());
+                results.unanswered++;
+                auto timeout = std::chrono::duration_cast<std::chrono::microseconds>(options.replyTimeout);
+                results.all.recordTimeout(timeout);
+                (kind == FrameKind::Poll ? results.pollLatency : results.commandLatency).recordTimeout(timeout);
+                awaitingReply = false;
+
+                // If it's just slow, let the answer land here (see frameReceived()) rather than on
+                // the next frame. Once it has, there's nothing left to wait for.
+                awaitingLate = true;
+                replied.wait_for(lock, stopToken, options.replyTimeout, [this] { return !awaitingLate || closed; });
+                awaitingLate = false;
+                if (closed) {
+                    return false;
+                }
+            }
+            awaitingReply = false;
+        }
+
+        std::this_thread::sleep_for(options.gap);
+        return true;
+    }
+
+} // creatures
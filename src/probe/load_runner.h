@@ -0,0 +1,142 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_LOAD_RUNNER_H
+#define ANDERSEN_MQTT_LOAD_RUNNER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include "latency_stats.h"
+#include "window/window.h"
+
+namespace creatures {
+
+    enum class ProbeLoad {
+        Polls,          // STATUS polls, nothing else
+        Commands,       // bursts of commands, nothing else
+        Mixed           // polls, with the bursts cutting in line like they do in the daemon
+    };
+
+    /**
+     * What to throw at the gateway
+     */
+    struct ProbeOptions {
+        ProbeLoad load = ProbeLoad::Polls;
+
+        // Polls a second. Zero means as fast as the gateway answers.
+        double rate = 10;
+
+        // Commands per burst, and how often a burst starts
+        std::size_t burst = 4;
+        std::chrono::milliseconds burstInterval{1000};
+
+        uint8_t panel = DST_PANEL_1;
+        uint8_t command = CMD_STOP;
+
+        std::chrono::seconds duration{10};
+
+        // How long to wait on a reply before counting it as unanswered
+        std::chrono::milliseconds replyTimeout{500};
+
+        // Quiet time left on the bus after every reply, like the daemon's minimum gap
+        std::chrono::milliseconds gap{5};
+    };
+
+    /**
+     * How it went
+     */
+    struct ProbeResults {
+        std::chrono::microseconds elapsed{0};
+
+        uint64_t sent = 0;
+        uint64_t polls = 0;
+        uint64_t commands = 0;
+
+        uint64_t replies = 0;
+        uint64_t statuses = 0;
+        uint64_t acks = 0;
+        uint64_t busy = 0;
+        uint64_t unanswered = 0;
+        uint64_t late = 0;              // answered, but after we'd given up on it
+        uint64_t stray = 0;             // showed up when we weren't waiting on one like it
+
+        uint64_t checksumErrors = 0;
+        uint64_t discardedBytes = 0;
+
+        // Every frame we sent, answered or not. One that wasn't counts as taking the reply timeout.
+        LatencyStats all;
+        LatencyStats pollLatency;
+        LatencyStats commandLatency;
+
+        [[nodiscard]] double seconds() const { return static_cast<double>(elapsed.count()) / 1e6; }
+    };
+
+    /**
+     * Runs one scripted load against a gateway we're already connected to.
+     *
+     * The bus is half duplex, so just like the daemon we only ever have one frame out at a
+     * time: send, wait for the reply (or give up on it), leave the gap, go again. That means
+     * the achieved rate is an honest measure of what the gateway and panel can keep up with.
+     *
+     * Replies don't say what they're answering, though. Only a STATUS counts for a poll, and
+     * only an ACK or BUSY for a command, so a late reply to one kind can't be taken for the
+     * other. A late reply to the same kind would look just like the real one, so after a
+     * frame goes unanswered we stay quiet for another reply timeout. If its answer turns up
+     * then, it's counted as late, and we carry on right away.
+     */
+    class LoadRunner {
+
+    public:
+        LoadRunner(int socketFd, ProbeOptions options);
+
+        /**
+         * Runs for the whole duration, unless we're asked to stop first. Either way we get
+         * the results up to that point.
+         */
+        ProbeResults run(std::stop_token stopToken);
+
+        [[nodiscard]] static std::optional<ProbeLoad> loadFromName(const std::string &name);
+        [[nodiscard]] static std::string loadName(ProbeLoad load);
+
+    private:
+        enum class FrameKind {
+            Poll,
+            Command
+        };
+
+        void reader(std::stop_token stopToken);
+        void frameReceived(const uint8_t *frame, size_t size);
+        [[nodiscard]] static bool answers(FrameKind kind, uint8_t replyType);
+        bool sendAndWait(const std::vector<uint8_t> &frame, FrameKind kind, std::stop_token stopToken);
+
+        int socketFd;
+        ProbeOptions options;
+
+        std::mutex mutex;
+        std::condition_variable_any replied;
+        ProbeResults results;
+
+        // The gateway's gone, so there's no point sending anything else
+        bool closed = false;
+
+        // What we're waiting to hear back about
+        bool awaitingReply = false;
+
+        // We gave up on it, but it might still turn up
+        bool awaitingLate = false;
+        FrameKind awaitingKind = FrameKind::Poll;
+        std::chrono::steady_clock::time_point sentAt;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_LOAD_RUNNER_H
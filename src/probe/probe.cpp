@@ -0,0 +1,353 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+/*
+ * andersen_probe: throws scripted traffic at a gateway (or a pretend one) and says how it held
+ * up. It talks to the bus the same way the daemon does, with none of the MQTT in the way, so
+ * it's what to reach for when sizing up new panels or comparing gateway firmware.
+ */
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <pthread.h>
+#include <stop_token>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include "namespace-stuffs.h"
+
+#include "config/config.h"
+#include "logging/logging.h"
+#include "probe/load_runner.h"
+#include "probe/simulated_gateway.h"
+#include "socket/socket.h"
+#include "window/command_compiler.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+    void usage(const char *name) {
+        fmt::print(stderr,
+                   "Usage: {} [options]\n"
+                   "\n"
+                   "Where to send it:\n"
+                   "  --host HOST             gateway (default: ANDERSEN_GATEWAY_HOST)\n"
+                   "  --port PORT             gateway port (default: ANDERSEN_GATEWAY_PORT)\n"
+                   "  --simulate              start a simulated gateway on localhost and probe that instead\n"
+                   "\n"
+                   "What to send:\n"
+                   "  --load LOAD             polls, commands, or mixed (default: polls)\n"
+                   "  --rate N                polls a second, 0 for as fast as the gateway answers (default: 10)\n"
+                   "  --burst N               commands per burst (default: 4)\n"
+                   "  --burst-interval MS     time between the start of each burst (default: 1000)\n"
+                   "  --command COMMAND       open, close, or stop (default: stop)\n"
+                   "  --panel N               which panel (default: 1)\n"
+                   "  --duration S            how long to run (default: 10)\n"
+                   "  --timeout MS            how long to wait on a reply (default: 500)\n"
+                   "  --gap MS                quiet time after every reply (default: 5)\n"
+                   "\n"
+                   "The simulated gateway:\n"
+                   "  --sim-latency MS        how long it takes to reply (default: 15)\n"
+                   "  --sim-jitter MS         replies are up to this much faster or slower (default: 5)\n"
+                   "  --sim-busy PERCENT      how often it says BUSY (default: 0)\n"
+                   "  --sim-corrupt PERCENT   how often a reply has a bad checksum (default: 0)\n"
+                   "\n"
+                   "Output:\n"
+                   "  --json                  print the report as JSON\n"
+                   "  --log-level LEVEL       (default: warn)\n",
+                   name);
+    }
+
+    bool parseNumber(const char *text, double &into) {
+        char *end = nullptr;
+        double parsed = std::strtod(text, &end);
+        if (end == text || *end != '\0' || parsed < 0) {
+            return false;
+        }
+        into = parsed;
+        return true;
+    }
+
+    double millis(std::chrono::microseconds time) {
+        return static_cast<double>(time.count()) / 1000.0;
+    }
+
+    double perSecond(uint64_t count, const creatures::ProbeResults &results) {
+        return results.seconds() > 0 ? static_cast<double>(count) / results.seconds() : 0;
+    }
+
+    double percentOf(uint64_t count, uint64_t total) {
+        return total > 0 ? 100.0 * static_cast<double>(count) / static_cast<double>(total) : 0;
+    }
+
+    json latencyJson(const creatures::LatencyStats &stats) {
+        return {
+                {"samples", stats.count()},
+                {"timeouts", stats.timeouts()},
+                {"min_ms",  millis(stats.min())},
+                {"mean_ms", millis(stats.mean())},
+                {"p50_ms",  millis(stats.percentile(50))},
+                {"p99_ms",  millis(stats.percentile(99))},
+                {"p999_ms", millis(stats.percentile(99.9))},
+                {"max_ms",  millis(stats.max())}
+        };
+    }
+
+    std::string latencyLine(const creatures::LatencyStats &stats) {
+        if (stats.count() == 0) {
+            return "no replies";
+        }
+        return fmt::format("p50 {:.2f} ms  p99 {:.2f} ms  p999 {:.2f} ms  max {:.2f} ms  ({} samples, {} timed out)",
+                           millis(stats.percentile(50)), millis(stats.percentile(99)),
+                           millis(stats.percentile(99.9)), millis(stats.max()), stats.count(), stats.timeouts());
+    }
+
+    void printReport(const creatures::ProbeResults &results, const creatures::ProbeOptions &options,
+                     const std::string &target) {
+        fmt::print("{} load against {} for {:.1f} s\n", creatures::LoadRunner::loadName(options.load), target,
+                   results.seconds());
+        fmt::print("  sent        {} frames ({:.1f}/s): {} polls, {} commands\n", results.sent,
+                   perSecond(results.sent, results), results.polls, results.commands);
+        fmt::print("  replies     {} ({:.1f}/s): {} status, {} ack, {} busy\n", results.replies,
+                   perSecond(results.replies, results), results.statuses, results.acks, results.busy);
+        fmt::print("  busy        {:.2f}% of frames sent\n", percentOf(results.busy, results.sent));
+        fmt::print("  unanswered  {} ({} of those showed up late)\n", results.unanswered, results.late);
+        fmt::print("  stray       {} frames we weren't waiting on\n", results.stray);
+        fmt::print("  checksums   {} bad, {} bytes thrown away\n", results.checksumErrors, results.discardedBytes);
+        fmt::print("  latency     {}\n", latencyLine(results.all));
+        if (options.load == creatures::ProbeLoad::Mixed) {
+            fmt::print("    polls     {}\n", latencyLine(results.pollLatency));
+            fmt::print("    commands  {}\n", latencyLine(results.commandLatency));
+        }
+    }
+
+    void printJson(const creatures::ProbeResults &results, const creatures::ProbeOptions &options,
+                   const std::string &target) {
+        json report = {
+                {"load",            creatures::LoadRunner::loadName(options.load)},
+                {"target",          target},
+                {"seconds",         results.seconds()},
+                {"sent",            results.sent},
+                {"polls",           results.polls},
+                {"commands",        results.commands},
+                {"sent_per_second", perSecond(results.sent, results)},
+                {"replies",         results.replies},
+                {"replies_per_second", perSecond(results.replies, results)},
+                {"statuses",        results.statuses},
+                {"acks",            results.acks},
+                {"busy",            results.busy},
+                {"busy_percent",    percentOf(results.busy, results.sent)},
+                {"unanswered",      results.unanswered},
+                {"late",            results.late},
+                {"stray",           results.stray},
+                {"checksum_errors", results.checksumErrors},
+                {"discarded_bytes", results.discardedBytes},
+                {"latency",         latencyJson(results.all)},
+                {"poll_latency",    latencyJson(results.pollLatency)},
+                {"command_latency", latencyJson(results.commandLatency)}
+        };
+        fmt::print("{}\n", report.dump(2));
+    }
+
+}
+
+int main(int argc, char **argv) {
+
+    // Ctrl-C cuts the run short, but we still want the report
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+    auto config = creatures::Configuration::fromEnvironment();
+    std::string host = config.getGatewayHost();
+    int port = config.getGatewayPort();
+    bool simulate = false;
+    bool asJson = false;
+    std::string logLevel = "warn";
+
+    creatures::ProbeOptions options;
+    creatures::SimulatedGatewayOptions simulatorOptions;
+
+    enum Option {
+        Host = 1, Port, Simulate, Load, Rate, Burst, BurstInterval, Command, Panel, Duration, Timeout, Gap,
+        SimLatency, SimJitter, SimBusy, SimCorrupt, Json, LogLevel, Help
+    };
+    const option longOptions[] = {
+            {"host",           required_argument, nullptr, Host},
+            {"port",           required_argument, nullptr, Port},
+            {"simulate",       no_argument,       nullptr, Simulate},
+            {"load",           required_argument, nullptr, Load},
+            {"rate",           required_argument, nullptr, Rate},
+            {"burst",          required_argument, nullptr, Burst},
+            {"burst-interval", required_argument, nullptr, BurstInterval},
+            {"command",        required_argument, nullptr, Command},
+            {"panel",          required_argument, nullptr, Panel},
+            {"duration",       required_argument, nullptr, Duration},
+            {"timeout",        required_argument, nullptr, Timeout},
+            {"gap",            required_argument, nullptr, Gap},
+            {"sim-latency",    required_argument, nullptr, SimLatency},
+            {"sim-jitter",     required_argument, nullptr, SimJitter},
+            {"sim-busy",       required_argument, nullptr, SimBusy},
+            {"sim-corrupt",    required_argument, nullptr, SimCorrupt},
+            {"json",           no_argument,       nullptr, Json},
+            {"log-level",      required_argument, nullptr, LogLevel},
+            {"help",           no_argument,       nullptr, Help},
+            {nullptr, 0,                          nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+        double number = 0;
+        bool numeric = opt == Port || opt == Rate || opt == Burst || opt == BurstInterval || opt == Panel ||
+                       opt == Duration || opt == Timeout || opt == Gap || opt == SimLatency || opt == SimJitter ||
+                       opt == SimBusy || opt == SimCorrupt;
+        if (numeric && !parseNumber(optarg, number)) {
+            fmt::print(stderr, "{} isn't a number we can use\n", optarg);
+            return 2;
+        }
+
+        switch (opt) {
+            case Host:
+                host = optarg;
+                break;
+            case Port:
+                port = static_cast<int>(number);
+                break;
+            case Simulate:
+                simulate = true;
+                break;
+            case Load: {
+                auto load = creatures::LoadRunner::loadFromName(optarg);
+                if (!load) {
+                    fmt::print(stderr, "unknown load '{}', it's polls, commands, or mixed\n", optarg);
+                    return 2;
+                }
+                options.load = *load;
+                break;
+            }
+            case Rate:
+                options.rate = number;
+                break;
+            case Burst:
+                options.burst = static_cast<std::size_t>(number);
+                break;
+            case BurstInterval:
+                options.burstInterval = std::chrono::milliseconds(static_cast<int64_t>(number));
+                break;
+            case Command: {
+                auto command = creatures::CommandCompiler::commandFromName(optarg);
+                if (!command) {
+                    fmt::print(stderr, "unknown command '{}', it's open, close, or stop\n", optarg);
+                    return 2;
+                }
+                options.command = *command;
+                break;
+            }
+            case Panel:
+                options.panel = static_cast<uint8_t>(number);
+                break;
+            case Duration:
+                options.duration = std::chrono::seconds(static_cast<int64_t>(number));
+                break;
+            case Timeout:
+                options.replyTimeout = std::chrono::milliseconds(static_cast<int64_t>(number));
+                break;
+            case Gap:
+                options.gap = std::chrono::milliseconds(static_cast<int64_t>(number));
+                break;
+            case SimLatency:
+                simulatorOptions.latency = std::chrono::microseconds(static_cast<int64_t>(number * 1000));
+                break;
+            case SimJitter:
+                simulatorOptions.jitter = std::chrono::microseconds(static_cast<int64_t>(number * 1000));
+                break;
+            case SimBusy:
+                simulatorOptions.busyPercent = number;
+                break;
+            case SimCorrupt:
+                simulatorOptions.corruptPercent = number;
+                break;
+            case Json:
+                asJson = true;
+                break;
+            case LogLevel:
+                logLevel = optarg;
+                break;
+            case Help:
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    // Nobody wants the framer's play-by-play in the middle of a report
+    creatures::logging::init(config);
+    for (const auto &component: {"main", "probe", "simulator", "threads", "window"}) {
+        creatures::logging::get(component);     // setLevel() only touches loggers that are already there
+        if (!creatures::logging::setLevel(component, logLevel)) {
+            fmt::print(stderr, "unknown log level '{}'\n", logLevel);
+            return 2;
+        }
+    }
+
+    std::stop_source stopSource;
+    std::jthread signals([&stopSource, stopSignals](std::stop_token stopToken) {
+        std::stop_callback wakeup(stopToken, [self = pthread_self()] {
+            pthread_kill(self, SIGTERM);
+        });
+
+        int signalNumber = 0;
+        if (sigwait(&stopSignals, &signalNumber) == 0 && !stopToken.stop_requested()) {
+            warn("received {}, wrapping up early", strsignal(signalNumber));
+            stopSource.request_stop();
+        }
+    });
+
+    creatures::SimulatedGateway simulator(simulatorOptions);
+    if (simulate) {
+        if (!simulator.start()) {
+            return 1;
+        }
+        host = "127.0.0.1";
+        port = simulator.getPort();
+    }
+
+    if (!simulate && options.load != creatures::ProbeLoad::Polls && options.command != CMD_STOP) {
+        warn("this is a real gateway, so the windows on panel {} are really going to move", options.panel);
+    }
+
+    std::string target = simulate ? "simulated gateway" : fmt::format("{}:{}", host, port);
+    int socketFd = connect_to_server(host.c_str(), port);
+    if (socketFd < 0) {
+        return 1;
+    }
+
+    creatures::LoadRunner runner(socketFd, options);
+    auto results = runner.run(stopSource.get_token());
+    close(socketFd);
+    simulator.stop();
+
+    if (asJson) {
+        printJson(results, options, target);
+    } else {
+        printReport(results, options, target);
+    }
+
+    signals.request_stop();
+    signals.join();
+    creatures::logging::shutdown();
+    return 0;
+}
@@ -0,0 +1,199 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "simulated_gateway.h"
+
+#include "logging/logging.h"
+#include "threading/threading.h"
+#include "window/window.h"
+
+namespace creatures {
+
+    namespace {
+        // Everything in here logs under the "simulator" component
+        constexpr auto &logger = logging::component<"simulator">;
+
+        // Everything we send to the panel is this long
+        constexpr std::size_t requestSize = 5;
+    }
+
+    SimulatedGateway::SimulatedGateway(SimulatedGatewayOptions options)
+            : options(options), random(options.seed) {}
+
+    SimulatedGateway::~SimulatedGateway() {
+        stop();
+    }
+
+    bool SimulatedGateway::start() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0) {
+            logger().error("couldn't make a socket: {}", std::strerror(errno));
+            return false;
+        }
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = 0;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        socklen_t length = sizeof(address);
+        if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+            listen(listenFd, 1) < 0 ||
+            getsockname(listenFd, reinterpret_cast<sockaddr *>(&address), &length) < 0) {
+            logger().error("couldn't listen on localhost: {}", std::strerror(errno));
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+
+        port = ntohs(address.sin_port);
+        logger().info("simulated gateway listening on 127.0.0.1:{}", port);
+
+        thread = std::jthread([this](std::stop_token stopToken) { serve(stopToken); });
+        return true;
+    }
+
+    void SimulatedGateway::stop() {
+        if (listenFd < 0) {
+            return;
+        }
+
+        // Knocks accept() and recv() loose
+        thread.request_stop();
+        shutdown(listenFd, SHUT_RDWR);
+        int fd = clientFd.load();
+        if (fd >= 0) {
+            shutdown(fd, SHUT_RDWR);
+        }
+        if (thread.joinable()) {
+            thread.join();
+        }
+
+        close(listenFd);
+        listenFd = -1;
+    }
+
+    void SimulatedGateway::serve(std::stop_token stopToken) {
+        threading::setup("simulator");
+
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (!stopToken.stop_requested()) {
+                logger().error("accept failed: {}", std::strerror(errno));
+            }
+            return;
+        }
+        clientFd = fd;
+        logger().debug("probe connected");
+
+        // Don't hold the replies back waiting for more to send, they're supposed to be timed
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        std::vector<uint8_t> buffer;
+        buffer.reserve(1024);
+        std::array<uint8_t, 256> tempBuffer{};
+        while (!stopToken.stop_requested()) {
+            ssize_t received = recv(fd, tempBuffer.data(), tempBuffer.size(), 0);
+            if (received <= 0) {
+                break;
+            }
+            buffer.insert(buffer.end(), tempBuffer.begin(), tempBuffer.begin() + received);
+
+            while (true) {
+                // Everything from the controller starts with 0xFF
+                auto header = std::find(buffer.begin(), buffer.end(), SRC_CONTROLLER);
+                buffer.erase(buffer.begin(), header);
+                if (buffer.size() < requestSize) {
+                    break;
+                }
+
+                if (!Window::validateChecksum(buffer.data(), requestSize)) {
+                    logger().warn("bad checksum from the probe, resyncing");
+                    buffer.erase(buffer.begin());
+                    continue;
+                }
+
+                answer(fd, buffer.data());
+                buffer.erase(buffer.begin(), buffer.begin() + requestSize);
+            }
+        }
+
+        clientFd = -1;
+        close(fd);
+        logger().debug("probe disconnected");
+    }
+
+    void SimulatedGateway::answer(int fd, const uint8_t *frame) {
+        uint8_t panel = frame[1];
+        uint8_t window = frame[2];
+        uint8_t command = frame[3];
+
+        // The panel takes its time no matter what it ends up saying
+        std::uniform_int_distribution<int64_t> jitter(-options.jitter.count(), options.jitter.count());
+        auto delay = std::max<int64_t>(options.latency.count() + jitter(random), 0);
+        std::this_thread::sleep_for(std::chrono::microseconds(delay));
+
+        if (roll(options.busyPercent)) {
+            reply(fd, {0xFF, panel, CONTROLLER_BUSY, window});
+            return;
+        }
+
+        switch (command) {
+            case CMD_STATUS_WITH_POLL:
+            case CMD_STATUS_WITHOUT_POLL:
+                reply(fd, {0xFF, panel, CMD_STATUS_WITHOUT_POLL, statuses[0], statuses[1], statuses[2], statuses[3]});
+                return;
+
+            case CMD_OPEN:
+            case CMD_CLOSE:
+                for (std::size_t i = 0; i < statuses.size(); i++) {
+                    if (window == WINDOW_ALL || window == i + 1) {
+                        statuses[i] = static_cast<uint8_t>(command == CMD_OPEN ? (statuses[i] | 0x01) : (statuses[i] & ~0x01));
+                    }
+                }
+                reply(fd, {0xFF, panel, CONTROLLER_ACK, window});
+                return;
+
+            case CMD_STOP:
+                reply(fd, {0xFF, panel, CONTROLLER_ACK, window});
+                return;
+
+            default:
+                // The real panel just ignores these
+                logger().debug("ignoring unknown command 0x{:02X}", command);
+                return;
+        }
+    }
+
+    void SimulatedGateway::reply(int fd, std::vector<uint8_t> frame) {
+        auto checksum = Window::calculateChecksum(frame);
+        if (roll(options.corruptPercent)) {
+            checksum ^= 0x5A;
+        }
+        frame.push_back(checksum);
+
+        if (send(fd, frame.data(), frame.size(), MSG_NOSIGNAL) < 0) {
+            logger().debug("couldn't send a reply: {}", std::strerror(errno));
+        }
+    }
+
+    bool SimulatedGateway::roll(double percent) {
+        if (percent <= 0) {
+            return false;
+        }
+        return std::uniform_real_distribution<double>(0, 100)(random) < percent;
+    }
+
+} // creatures
@@ -0,0 +1,88 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_SIMULATED_GATEWAY_H
+#define ANDERSEN_MQTT_SIMULATED_GATEWAY_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace creatures {
+
+    /**
+     * How the pretend panel behaves
+     */
+    struct SimulatedGatewayOptions {
+
+        // How long a reply takes. At 9600 baud a poll and its STATUS are about 14 ms on the wire by themselves.
+        std::chrono::microseconds latency{15000};
+
+        // Each reply is up to this much faster or slower, picked at random
+        std::chrono::microseconds jitter{5000};
+
+        // Percent of frames that get a BUSY instead of an answer
+        double busyPercent = 0;
+
+        // Percent of replies that go out with a bad checksum
+        double corruptPercent = 0;
+
+        // Same seed, same run
+        uint32_t seed = 1;
+    };
+
+    /**
+     * A gateway (and one panel's worth of windows) on localhost, for trying out the probe
+     * without a real bus.
+     *
+     * It takes one connection. Polls get a STATUS back, commands get an ACK and move the
+     * windows, and the options above decide how slow and how grumpy it is about it. It
+     * answers one frame at a time, same as the real bus.
+     */
+    class SimulatedGateway {
+
+    public:
+        explicit SimulatedGateway(SimulatedGatewayOptions options = {});
+        ~SimulatedGateway();
+
+        SimulatedGateway(const SimulatedGateway &) = delete;
+        SimulatedGateway &operator=(const SimulatedGateway &) = delete;
+
+        /**
+         * Starts listening on 127.0.0.1 on whatever port the kernel gives us
+         *
+         * @return false if we couldn't
+         */
+        bool start();
+        void stop();
+
+        [[nodiscard]] int getPort() const { return port; }
+
+    private:
+        void serve(std::stop_token stopToken);
+        void answer(int fd, const uint8_t *frame);
+        void reply(int fd, std::vector<uint8_t> frame);
+        bool roll(double percent);
+
+        SimulatedGatewayOptions options;
+        std::mt19937 random;
+
+        int listenFd = -1;
+        std::atomic<int> clientFd = -1;
+        int port = 0;
+
+        // Bit 0 is open, same as the real panel
+        std::array<uint8_t, 4> statuses{};
+
+        std::jthread thread;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_SIMULATED_GATEWAY_H
@@ -0,0 +1,199 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+#include <array>
+#include <memory_resource>
+#include <optional>
+#include <utility>
+
+#include "namespace-stuffs.h"
+
+#include "processor.h"
+
+#include "startup/startup.h"
+#include "tracing/tracing.h"
+
+using creatures::joinStrings;
+
+
+std::vector<std::unique_ptr<creatures::MQTTClient>> mqttClients;
+
+std::shared_ptr<creatures::TransmitScheduler> transmitScheduler;
+std::shared_ptr<creatures::BusPacer> busPacer;
+std::shared_ptr<creatures::CommandTracker> commandTracker;
+std::shared_ptr<creatures::GatewayWatchdog> gatewayWatchdog;
+
+std::unique_ptr<creatures::SharedStateExport> sharedState;
+std::unique_ptr<creatures::StateSnapshot> stateSnapshot;
+std::unique_ptr<creatures::StateHistory> stateHistory;
+std::unique_ptr<creatures::RuleEngine> ruleEngine;
+std::shared_ptr<creatures::HttpServer> httpServer;
+
+std::shared_ptr<creatures::Window> window1;
+std::shared_ptr<creatures::Window> window2;
+std::shared_ptr<creatures::Window> window3;
+std::shared_ptr<creatures::Window> window4;
+
+
+void send_rule_commands(const std::vector<creatures::WindowCommand> &commands) {
+    auto frames = ruleEngine->getCompiler().compile(commands);
+
+    std::vector<uint8_t> panels;
+    std::size_t queued = 0;
+    auto tag = commandTracker->newTag();
+    for (auto &frame: frames) {
+        if (std::find(panels.begin(), panels.end(), frame[1]) == panels.end()) {
+            panels.push_back(frame[1]);
+        }
+        if (transmitScheduler->enqueue(std::move(frame), creatures::TrafficClass::Safety, tag) ==
+            creatures::EnqueueResult::Queued) {
+            queued++;
+        }
+    }
+    if (queued < frames.size()) {
+        error("the bus is backed up, {} of {} frames from a rule were not sent", frames.size() - queued, frames.size());
+    }
+
+    // Nobody's waiting on a result, but the tracker has to know so ACKs line up
+    commandTracker->track(tag, {"rule", "", std::chrono::milliseconds(60000)},
+                          creatures::CommandTracker::targets(commands), queued, nullptr);
+
+    for (auto panel: panels) {
+        transmitScheduler->enqueue(creatures::CommandCompiler::createFrame(panel, WINDOW_ALL, CMD_STATUS_WITHOUT_POLL),
+                                   creatures::TrafficClass::ConfirmPoll);
+    }
+}
+
+void process_message(const std::vector<uint8_t> &message, bool &firstRun) {
+    TRACE_ZONE("process_message");
+    TRACE_ZONE_VALUE(message.size() > 2 ? message[2] : 0);  // The message type
+
+    // Log the received message
+    bool verbose = spdlog::should_log(spdlog::level::debug);
+    if (verbose) {
+        debug("Processing message: [{}]", joinStrings(creatures::Window::bytesToHexStrings(message)));
+    }
+
+    // Ensure the message has at least 3 bytes (enough to determine the type)
+    if (message.size() < 3) {
+        error("Message too short: {} bytes. Ignoring.", message.size());
+        return;
+    }
+
+    // Determine the message type
+    uint8_t messageType = message[2];
+
+    switch (messageType) {
+        case 0x5C: { // STATUS message
+            debug("Detected STATUS message.");
+            creatures::startup::mark("first status received");
+
+            // Ensure the message is the correct size for a STATUS message
+            if (message.size() != 8) {
+                error("Invalid STATUS message size: {}. Expected 8 bytes.", message.size());
+                break;
+            }
+
+            // Extract the window statuses
+            uint8_t window1Status = message[3];
+            uint8_t window2Status = message[4];
+            uint8_t window3Status = message[5];
+            uint8_t window4Status = message[6];
+
+            // Remember which ones actually changed (and from what) so the event stream and the rules only hear about those.
+            // This happens for every poll, so it's all carved out of the stack rather than the heap.
+            std::array<std::byte, 512> scratchSpace;
+            std::pmr::monotonic_buffer_resource scratch(scratchSpace.data(), scratchSpace.size());
+            std::pmr::vector<std::shared_ptr<creatures::Window>> changed(&scratch);
+            std::pmr::vector<creatures::StatusChange> statusChanges(&scratch);
+            changed.reserve(4);
+            statusChanges.reserve(4);
+            for (const auto &[window, status]: {std::pair{window1, window1Status}, std::pair{window2, window2Status},
+                                                std::pair{window3, window3Status}, std::pair{window4, window4Status}}) {
+                if (!window->hasStatus() || window->getStatusByte() != status) {
+                    changed.push_back(window);
+                    statusChanges.push_back({window, window->hasStatus() ? std::optional(window->getStatusByte())
+                                                                         : std::nullopt});
+                }
+            }
+
+            // Update the window statuses
+            window1->setStatus(window1Status);
+            window2->setStatus(window2Status);
+            window3->setStatus(window3Status);
+            window4->setStatus(window4Status);
+
+            // Anything that has to happen right now goes out before we do anything else
+            if (!statusChanges.empty()) {
+                auto ruleCommands = ruleEngine->evaluate(statusChanges);
+                if (!ruleCommands.empty()) {
+                    send_rule_commands(ruleCommands);
+                }
+            }
+
+            if (stateHistory) {
+                for (const auto &window: {window1, window2, window3, window4}) {
+                    stateHistory->record(window->getName(), window->getStatusByte(), window->getLastPolledTime());
+                }
+            }
+
+            // The gateway (and so every window) is still with us
+            gatewayWatchdog->frameReceived();
+
+            // Did that get any commands where they were going?
+            commandTracker->onStatus({0, window1Status, window2Status, window3Status, window4Status});
+
+            // Local readers get it first, no broker involved
+            if (sharedState) {
+                sharedState->update(&message[3], 4, window1->getLastPolledTime());
+            }
+            if (httpServer) {
+                for (const auto &window: changed) {
+                    httpServer->broadcast("window", window->toJson());
+                }
+            }
+
+            // Log the updated statuses
+            debug("Updated window statuses");
+            if (verbose) {
+                debug("Window 1: {}", window1->toJson());
+                debug("Window 2: {}", window2->toJson());
+                debug("Window 3: {}", window3->toJson());
+                debug("Window 4: {}", window4->toJson());
+            }
+
+            // Publish this update on MQTT. Each broker does this on its own thread.
+            for (const auto &mqttClient: mqttClients) {
+                mqttClient->publishWindows(firstRun);
+            }
+            firstRun = false;
+
+            // Saving hits the disk, so it's done on its own thread after everyone else has heard
+            if (stateSnapshot && !changed.empty()) {
+                stateSnapshot->saveSoon();
+            }
+            break;
+        }
+
+        case 0xB1: { // ACK message
+            debug("Detected ACK message.");
+            gatewayWatchdog->frameReceived();
+            commandTracker->onAck();
+            break;
+        }
+
+        case 0x27: { // BUSY message
+            debug("Detected BUSY message.");
+            gatewayWatchdog->frameReceived();
+            commandTracker->onBusy();
+            break;
+        }
+
+        default:
+            debug("Unknown message type: 0x{:02X}. Ignoring message.", messageType);
+            gatewayWatchdog->frameReceived();
+            break;
+    }
+}
@@ -0,0 +1,71 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_PROCESSOR_H
+#define ANDERSEN_MQTT_PROCESSOR_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bus/bus_pacer.h"
+#include "bus/gateway_watchdog.h"
+#include "bus/transmit_scheduler.h"
+#include "http/http_server.h"
+#include "mqtt/command_tracker.h"
+#include "mqtt/mqtt.h"
+#include "rules/rule_engine.h"
+#include "shm/shared_state.h"
+#include "state/state_history.h"
+#include "state/state_snapshot.h"
+#include "window/window.h"
+
+/*
+ * What happens to a frame from the gateway once it's off the wire, and everything that hears
+ * about it.
+ *
+ * These live here instead of in main.cpp so the tests can set up just the parts they need
+ * and push frames through exactly what the daemon does. Anything that's optional is null
+ * when it's turned off.
+ */
+
+extern std::vector<std::unique_ptr<creatures::MQTTClient>> mqttClients;
+
+extern std::shared_ptr<creatures::TransmitScheduler> transmitScheduler;
+extern std::shared_ptr<creatures::BusPacer> busPacer;
+extern std::shared_ptr<creatures::CommandTracker> commandTracker;
+extern std::shared_ptr<creatures::GatewayWatchdog> gatewayWatchdog;
+
+// Only set if we've been asked to export state to shared memory
+extern std::unique_ptr<creatures::SharedStateExport> sharedState;
+
+// Where the last known state gets saved, if anywhere
+extern std::unique_ptr<creatures::StateSnapshot> stateSnapshot;
+
+// Every change to every window, for answering questions about the past
+extern std::unique_ptr<creatures::StateHistory> stateHistory;
+
+// What has to happen right away when a window changes, no broker required
+extern std::unique_ptr<creatures::RuleEngine> ruleEngine;
+
+// The local HTTP API, if it's turned on
+extern std::shared_ptr<creatures::HttpServer> httpServer;
+
+extern std::shared_ptr<creatures::Window> window1;
+extern std::shared_ptr<creatures::Window> window2;
+extern std::shared_ptr<creatures::Window> window3;
+extern std::shared_ptr<creatures::Window> window4;
+
+
+// Rules don't wait on the broker, and they go out ahead of everything else on the bus
+void send_rule_commands(const std::vector<creatures::WindowCommand> &commands);
+
+/**
+ * Handles one whole frame from the gateway
+ *
+ * @param firstRun publish everything, not just what changed. Cleared once that's happened.
+ */
+void process_message(const std::vector<uint8_t> &message, bool &firstRun);
+
+#endif //ANDERSEN_MQTT_PROCESSOR_H
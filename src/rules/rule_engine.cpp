@@ -0,0 +1,178 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+#include <sstream>
+
+#include "namespace-stuffs.h"
+
+#include "rule_engine.h"
+
+namespace creatures {
+
+    RuleEngine::RuleEngine() {
+
+        // Keep the house dry, even if the broker (or Home Assistant) isn't around to help
+        Rule rainClose;
+        rainClose.when = WindowField::RainSensed;
+        rainClose.value = true;
+        rainClose.command = CMD_CLOSE;
+        rainClose.scope = RuleScope::Panel;
+        rainClose.unless = WindowField::RainOverrideActive;
+        rules["rain_close"] = rainClose;
+    }
+
+    void RuleEngine::addWindow(std::shared_ptr<Window> window) {
+        compiler.addWindow(window);
+        windows.push_back(std::move(window));
+    }
+
+    bool RuleEngine::applyOption(Rule &rule, const std::string &option, const std::string &value) {
+
+        if (option == "enabled" || option == "value") {
+            bool on;
+            if (value == "yes" || value == "true" || value == "1") {
+                on = true;
+            } else if (value == "no" || value == "false" || value == "0") {
+                on = false;
+            } else {
+                return false;
+            }
+            (option == "enabled" ? rule.enabled : rule.value) = on;
+            return true;
+        }
+
+        if (option == "when" || option == "unless") {
+            if (option == "unless" && value == "none") {
+                rule.unless.reset();
+                return true;
+            }
+            auto field = windowFieldFromName(value);
+            if (!field || *field == WindowField::LastPolled) {
+                return false;
+            }
+            if (option == "when") {
+                rule.when = *field;
+            } else {
+                rule.unless = *field;
+            }
+            return true;
+        }
+
+        if (option == "do") {
+            auto command = CommandCompiler::commandFromName(value);
+            if (!command) {
+                return false;
+            }
+            rule.command = *command;
+            return true;
+        }
+
+        if (option == "scope") {
+            if (value == "window") {
+                rule.scope = RuleScope::Window;
+            } else if (value == "panel") {
+                rule.scope = RuleScope::Panel;
+            } else if (value == "all") {
+                rule.scope = RuleScope::All;
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+    bool RuleEngine::apply(const std::string &overrides) {
+
+        bool good = true;
+
+        std::istringstream entries(overrides);
+        std::string entry;
+        while (std::getline(entries, entry, ';')) {
+            if (entry.empty()) {
+                continue;
+            }
+
+            auto colon = entry.find(':');
+            if (colon == std::string::npos || colon == 0) {
+                warn("ignoring bad rule: {}", entry);
+                good = false;
+                continue;
+            }
+
+            // Start from what's there already, so turning off the built in rule is just "rain_close:enabled=no"
+            auto name = entry.substr(0, colon);
+            bool existing = rules.contains(name);
+            Rule rule = existing ? rules[name] : Rule();
+
+            bool optionsGood = true;
+            std::istringstream options(entry.substr(colon + 1));
+            std::string option;
+            while (std::getline(options, option, ',')) {
+                auto equals = option.find('=');
+                if (equals == std::string::npos ||
+                    !applyOption(rule, option.substr(0, equals), option.substr(equals + 1))) {
+                    warn("ignoring bad option for rule {}: {}", name, option);
+                    optionsGood = false;
+                }
+            }
+            good = good && optionsGood;
+
+            // Half of a new rule could end up doing something nobody asked for
+            if (!existing && !optionsGood) {
+                warn("not adding rule {}", name);
+                continue;
+            }
+
+            debug("rule {} is {}", name, rule.enabled ? "enabled" : "disabled");
+            rules[name] = rule;
+        }
+
+        return good;
+    }
+
+    bool RuleEngine::fieldValue(uint8_t status, WindowField field) {
+        return (status >> static_cast<uint8_t>(field)) & 0x01;
+    }
+
+    std::vector<WindowCommand> RuleEngine::evaluate(std::span<const StatusChange> changes) const {
+
+        std::vector<WindowCommand> commands;
+
+        for (const auto &[name, rule]: rules) {
+            if (!rule.enabled) {
+                continue;
+            }
+
+            for (const auto &change: changes) {
+                bool now = fieldValue(change.window->getStatusByte(), rule.when);
+                bool was = change.before ? fieldValue(*change.before, rule.when) : !rule.value;
+                if (now != rule.value || was == rule.value) {
+                    continue;
+                }
+
+                std::vector<std::string> targets;
+                for (const auto &window: windows) {
+                    bool inScope = rule.scope == RuleScope::All ||
+                                   (rule.scope == RuleScope::Panel && window->getPanel() == change.window->getPanel()) ||
+                                   window == change.window;
+                    if (!inScope || (rule.unless && fieldValue(window->getStatusByte(), *rule.unless))) {
+                        continue;
+                    }
+                    commands.push_back({window, rule.command});
+                    targets.push_back(window->getName());
+                }
+
+                warn("rule {}: {} on {} went {}, sending command 0x{:02X} to {}", name, windowFieldName(rule.when),
+                     change.window->getName(), rule.value ? "on" : "off", rule.command,
+                     targets.empty() ? "nobody" : joinStrings(targets));
+            }
+        }
+
+        return commands;
+    }
+
+} // creatures
@@ -0,0 +1,98 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_RULE_ENGINE_H
+#define ANDERSEN_MQTT_RULE_ENGINE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "mqtt/publish_policy.h"
+#include "window/command_compiler.h"
+#include "window/window.h"
+
+namespace creatures {
+
+    /**
+     * Which windows a rule's command goes to
+     */
+    enum class RuleScope : uint8_t {
+        Window,     // only the one that set it off
+        Panel,      // every window on the same panel
+        All         // every window we have
+    };
+
+    /**
+     * When a field on a window changes to a value, send a command to some windows
+     */
+    struct Rule {
+        bool enabled = true;
+        WindowField when = WindowField::RainSensed;
+        bool value = true;
+        uint8_t command = CMD_CLOSE;
+        RuleScope scope = RuleScope::Panel;
+
+        // Windows with this field set are left alone
+        std::optional<WindowField> unless;
+    };
+
+    /**
+     * One window's status before the frame we just got
+     */
+    struct StatusChange {
+        std::shared_ptr<Window> window;
+        std::optional<uint8_t> before;      // nothing if we'd never heard from it
+    };
+
+    /**
+     * Things that have to happen right now, without waiting on a round trip through the
+     * broker (and whatever's on the other side of it) first.
+     *
+     * Rules are checked on every status frame, on the processor thread. A rule only fires
+     * when its field changes to the value it's looking for, so it doesn't keep sending the
+     * same command every poll while it's raining.
+     *
+     * Out of the box there's one, rain_close: when any window on a panel senses rain, close
+     * every window on that panel that doesn't have its rain override on.
+     */
+    class RuleEngine {
+
+    public:
+        RuleEngine();
+
+        void addWindow(std::shared_ptr<Window> window);
+
+        /**
+         * Adds or changes rules, in the form "name:option=value,...;name:...". Options are
+         * when, value, do, scope, unless, and enabled.
+         *
+         * @return false if any of it didn't make sense (the parts that did are still applied)
+         */
+        bool apply(const std::string &overrides);
+
+        /**
+         * The commands any rules want sent, given what just changed. The windows should
+         * already have their new status.
+         */
+        [[nodiscard]] std::vector<WindowCommand> evaluate(std::span<const StatusChange> changes) const;
+
+        [[nodiscard]] const CommandCompiler &getCompiler() const { return compiler; }
+
+    private:
+        static bool applyOption(Rule &rule, const std::string &option, const std::string &value);
+        static bool fieldValue(uint8_t status, WindowField field);
+
+        std::map<std::string, Rule> rules;
+        std::vector<std::shared_ptr<Window>> windows;
+        CommandCompiler compiler;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_RULE_ENGINE_H
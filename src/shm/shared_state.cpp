@@ -0,0 +1,113 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "namespace-stuffs.h"
+
+#include "shared_state.h"
+
+namespace creatures {
+
+    SharedStateExport::~SharedStateExport() {
+        if (region != nullptr) {
+            munmap(region, sizeof(SharedStateRegion));
+        }
+    }
+
+    bool SharedStateExport::open() {
+
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            error("unable to open shared state {}: {}", path, strerror(errno));
+            return false;
+        }
+
+        if (ftruncate(fd, sizeof(SharedStateRegion)) != 0) {
+            error("unable to size shared state {}: {}", path, strerror(errno));
+            close(fd);
+            return false;
+        }
+
+        void *address = mmap(nullptr, sizeof(SharedStateRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED) {
+            error("unable to map shared state {}: {}", path, strerror(errno));
+            return false;
+        }
+
+        region = static_cast<SharedStateRegion *>(address);
+
+        // Start from scratch, leaving the generation odd until we're done so nobody reads half of it
+        region->generation.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        region->windowCount = 0;
+        std::memset(region->windows, 0, sizeof(region->windows));
+        std::memcpy(region->magic, sharedStateMagic, sizeof(sharedStateMagic));
+        region->version = sharedStateVersion;
+        region->generation.store(2, std::memory_order_release);
+
+        info("exporting window state to {}", path);
+        return true;
+    }
+
+    void SharedStateExport::addWindow(const std::string &name, uint8_t number) {
+        if (region == nullptr) {
+            return;
+        }
+
+        if (number == 0 || number > sharedStateMaxWindows) {
+            warn("window {} has a number ({}) that won't fit in the shared state", name, number);
+            return;
+        }
+
+        auto generation = region->generation.load(std::memory_order_relaxed);
+        region->generation.store(generation + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        auto &slot = region->windows[number - 1];
+        std::memset(slot.name, 0, sizeof(slot.name));
+        std::strncpy(slot.name, name.c_str(), sizeof(slot.name) - 1);
+        slot.number = number;
+        if (number > region->windowCount) {
+            region->windowCount = number;
+        }
+
+        region->generation.store(generation + 2, std::memory_order_release);
+    }
+
+    void SharedStateExport::update(const uint8_t *statuses, std::size_t count,
+                                   std::chrono::system_clock::time_point polledAt) {
+        if (region == nullptr) {
+            return;
+        }
+
+        auto polledNs = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(polledAt.time_since_epoch()).count());
+
+        // Only the processor thread writes, so the seqlock doesn't need anything more than this
+        auto generation = region->generation.load(std::memory_order_relaxed);
+        region->generation.store(generation + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t i = 0; i < count && i < sharedStateMaxWindows; i++) {
+            auto &slot = region->windows[i];
+            if (slot.number == 0) {
+                continue;
+            }
+            if (slot.status != statuses[i] || slot.lastChangedNs == 0) {
+                slot.status = statuses[i];
+                slot.lastChangedNs = polledNs;
+            }
+            slot.lastPolledNs = polledNs;
+        }
+
+        region->generation.store(generation + 2, std::memory_order_release);
+    }
+
+} // creatures
@@ -0,0 +1,53 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_SHARED_STATE_H
+#define ANDERSEN_MQTT_SHARED_STATE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "shm/shared_state_reader.h"
+
+namespace creatures {
+
+    /**
+     * Keeps window state in a shared memory region so local processes can read it without
+     * going through the broker. See shared_state_reader.h for the other side.
+     */
+    class SharedStateExport {
+
+    public:
+        explicit SharedStateExport(std::string path) : path(std::move(path)) {}
+        ~SharedStateExport();
+
+        SharedStateExport(const SharedStateExport &) = delete;
+        SharedStateExport &operator=(const SharedStateExport &) = delete;
+
+        /**
+         * Makes (or takes over) the region
+         *
+         * @return true if we're ready to go
+         */
+        bool open();
+
+        /**
+         * Claims the slot for a window. Call these before any updates.
+         */
+        void addWindow(const std::string &name, uint8_t number);
+
+        /**
+         * Updates windows 1 through count from a STATUS frame
+         */
+        void update(const uint8_t *statuses, std::size_t count, std::chrono::system_clock::time_point polledAt);
+
+    private:
+        std::string path;
+        SharedStateRegion *region = nullptr;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_SHARED_STATE_H
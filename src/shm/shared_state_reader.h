@@ -0,0 +1,156 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_SHARED_STATE_READER_H
+#define ANDERSEN_MQTT_SHARED_STATE_READER_H
+
+/*
+ * Everything another process needs to read the window state we export to shared memory.
+ * This is header-only and doesn't depend on anything else in this repo, so feel free to
+ * copy it into whatever wants to read the state.
+ *
+ *   creatures::SharedStateReader reader("/dev/shm/andersen-mqtt");
+ *   creatures::SharedStateSnapshot snapshot;
+ *   if (reader.read(snapshot)) {
+ *       bool raining = snapshot.windows[0].isRainSensed();
+ *   }
+ *
+ * The daemon updates the region in place. It's guarded by a seqlock, so reading never blocks
+ * the daemon and a read just tries again if it raced with an update.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace creatures {
+
+    constexpr char sharedStateMagic[8] = {'A', 'N', 'D', 'S', 'T', 'A', 'T', 'E'};
+    constexpr uint32_t sharedStateVersion = 1;
+    constexpr std::size_t sharedStateMaxWindows = 16;
+    constexpr std::size_t sharedStateNameLength = 16;
+
+    /**
+     * One window. The status byte is exactly what the panel sent us.
+     */
+    struct SharedWindowState {
+        char name[sharedStateNameLength];   // NUL terminated
+        uint8_t number;                     // 0 means this slot isn't used
+        uint8_t status;
+        uint8_t reserved[6];
+        uint64_t lastPolledNs;              // when we last heard about it (epoch ns)
+        uint64_t lastChangedNs;             // when the status byte last changed (epoch ns)
+
+        [[nodiscard]] bool isOpen() const { return status & 0x01; }
+        [[nodiscard]] bool isMovementObstructed() const { return status & 0x02; }
+        [[nodiscard]] bool isScreenMissing() const { return status & 0x04; }
+        [[nodiscard]] bool isRfHeard() const { return status & 0x08; }
+        [[nodiscard]] bool isRainSensed() const { return status & 0x10; }
+        [[nodiscard]] bool isRainOverrideActive() const { return status & 0x20; }
+    };
+
+    static_assert(sizeof(SharedWindowState) == 40);
+
+    /**
+     * The whole shared region. Windows live in the slot for their number (window1 is slot 0).
+     */
+    struct SharedStateRegion {
+        char magic[8];
+        uint32_t version;
+        uint32_t windowCount;
+
+        // Odd while the daemon is in the middle of an update
+        std::atomic<uint64_t> generation;
+        uint64_t reserved;
+
+        SharedWindowState windows[sharedStateMaxWindows];
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "the seqlock has to work across processes");
+
+    /**
+     * A consistent copy of the region
+     */
+    struct SharedStateSnapshot {
+        uint64_t generation = 0;
+        uint32_t windowCount = 0;
+        SharedWindowState windows[sharedStateMaxWindows]{};
+    };
+
+
+    class SharedStateReader {
+
+    public:
+        explicit SharedStateReader(const std::string &path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return;
+            }
+
+            struct stat st{};
+            if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(SharedStateRegion)) {
+                void *address = mmap(nullptr, sizeof(SharedStateRegion), PROT_READ, MAP_SHARED, fd, 0);
+                if (address != MAP_FAILED) {
+                    region = static_cast<const SharedStateRegion *>(address);
+                }
+            }
+            ::close(fd);
+
+            if (region != nullptr && (std::memcmp(region->magic, sharedStateMagic, sizeof(sharedStateMagic)) != 0 ||
+                                      region->version != sharedStateVersion)) {
+                munmap(const_cast<SharedStateRegion *>(region), sizeof(SharedStateRegion));
+                region = nullptr;
+            }
+        }
+
+        ~SharedStateReader() {
+            if (region != nullptr) {
+                munmap(const_cast<SharedStateRegion *>(region), sizeof(SharedStateRegion));
+            }
+        }
+
+        SharedStateReader(const SharedStateReader &) = delete;
+        SharedStateReader &operator=(const SharedStateReader &) = delete;
+
+        [[nodiscard]] bool isOpen() const { return region != nullptr; }
+
+        /**
+         * Copies out the current state. Returns false if we aren't open, or if the daemon
+         * was updating the whole time we were trying (which shouldn't really happen).
+         */
+        bool read(SharedStateSnapshot &snapshot, int attempts = 1000) const {
+            if (region == nullptr) {
+                return false;
+            }
+
+            for (int i = 0; i < attempts; i++) {
+                uint64_t before = region->generation.load(std::memory_order_acquire);
+                if (before & 1) {
+                    continue;
+                }
+
+                snapshot.windowCount = region->windowCount;
+                std::memcpy(snapshot.windows, region->windows, sizeof(snapshot.windows));
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (region->generation.load(std::memory_order_relaxed) == before) {
+                    snapshot.generation = before;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        const SharedStateRegion *region = nullptr;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_SHARED_STATE_READER_H
@@ -0,0 +1,75 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "namespace-stuffs.h"
+
+#include "startup.h"
+
+#include "logging/logging.h"
+
+namespace creatures::startup {
+
+    namespace {
+        // Everything in here logs under the "startup" component
+        constexpr auto &logger = logging::component<"startup">;
+
+        // Close enough to when the process started. Statics get set up before main() runs.
+        const auto processStart = std::chrono::steady_clock::now();
+
+        std::mutex startupMutex;
+        std::atomic<bool> finished = false;
+        std::vector<std::pair<std::string, std::chrono::microseconds>> phases;
+
+        bool record(std::string_view phase) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - processStart);
+
+            for (const auto &existing: phases) {
+                if (existing.first == phase) {
+                    return false;
+                }
+            }
+            phases.emplace_back(phase, elapsed);
+            return true;
+        }
+    }
+
+    void mark(std::string_view phase) {
+        if (finished) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(startupMutex);
+        if (!finished) {
+            record(phase);
+        }
+    }
+
+    void finish(std::string_view phase) {
+        if (finished) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(startupMutex);
+        if (finished.exchange(true)) {
+            return;
+        }
+        record(phase);
+
+        std::chrono::microseconds previous{0};
+        logger().info("startup timeline:");
+        for (const auto &[name, at]: phases) {
+            logger().info("  {:>10}us  (+{:>9}us)  {}", at.count(), (at - previous).count(), name);
+            previous = at;
+        }
+        logger().info("time to {}: {}us", phase, phases.back().second.count());
+    }
+
+} // creatures::startup
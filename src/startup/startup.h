@@ -0,0 +1,29 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_STARTUP_H
+#define ANDERSEN_MQTT_STARTUP_H
+
+#include <string>
+#include <string_view>
+
+namespace creatures::startup {
+
+    /**
+     * Notes that a phase of starting up is done, in microseconds since the process started.
+     * Only the first mark for a phase counts, and once the timeline has been logged these
+     * are all no-ops, so it's fine to call from places that run all the time. Safe from
+     * any thread.
+     */
+    void mark(std::string_view phase);
+
+    /**
+     * Marks the last phase (our first publish) and logs the whole timeline. Only the first
+     * call does anything.
+     */
+    void finish(std::string_view phase);
+
+} // creatures::startup
+
+#endif //ANDERSEN_MQTT_STARTUP_H
@@ -0,0 +1,129 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include "state_history.h"
+
+namespace creatures {
+
+    namespace {
+
+        // The most a change can take: a 64 bit varint, and the mask
+        constexpr std::size_t largestChange = 11;
+
+        // LEB128, seven bits at a time, low bits first
+        template<typename Ring>
+        void appendVarint(Ring &ring, uint64_t value) {
+            while (value >= 0x80) {
+                ring.push(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            ring.push(static_cast<uint8_t>(value));
+        }
+
+        template<typename Ring>
+        uint64_t readVarint(const Ring &ring, std::size_t &i) {
+            uint64_t value = 0;
+            int shift = 0;
+            uint8_t byte;
+            do {
+                byte = ring.at(i++);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            return value;
+        }
+    }
+
+    void StateHistory::record(const std::string &window, uint8_t status, std::chrono::system_clock::time_point when) {
+
+        auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(when.time_since_epoch()).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto [it, first] = rings.try_emplace(window);
+        auto &ring = it->second;
+
+        // The first status we ever hear is where everything starts from
+        if (first) {
+            ring.bytes.resize(bytesPerWindow + largestChange);
+            ring.baseMs = ring.lastMs = nowMs;
+            ring.baseStatus = ring.lastStatus = status;
+            return;
+        }
+
+        if (status == ring.lastStatus) {
+            return;
+        }
+
+        // The clock can go backwards (NTP, etc). Call that no time at all rather than wrapping.
+        auto delta = nowMs > ring.lastMs ? static_cast<uint64_t>(nowMs - ring.lastMs) : 0;
+        appendVarint(ring, delta);
+        ring.push(status ^ ring.lastStatus);
+
+        ring.lastMs += static_cast<int64_t>(delta);
+        ring.lastStatus = status;
+
+        while (ring.used > bytesPerWindow) {
+            evictOldest(ring);
+        }
+    }
+
+    void StateHistory::evictOldest(Ring &ring) {
+        std::size_t i = 0;
+        ring.baseMs += static_cast<int64_t>(readVarint(ring, i));
+        ring.baseStatus ^= ring.at(i++);
+        ring.head = (ring.head + i) % ring.bytes.size();
+        ring.used -= i;
+    }
+
+    std::optional<HistoryResult> StateHistory::query(const std::string &window, uint8_t mask, int64_t sinceMs,
+                                                     int64_t untilMs) const {
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto found = rings.find(window);
+        if (found == rings.end()) {
+            return std::nullopt;
+        }
+        const auto &ring = found->second;
+
+        HistoryResult result;
+        result.complete = ring.baseMs <= sinceMs;
+
+        int64_t timeMs = ring.baseMs;
+        uint8_t status = ring.baseStatus;
+        if (timeMs <= sinceMs) {
+            result.initialStatus = status;
+        }
+
+        std::size_t i = 0;
+        while (i < ring.used) {
+            timeMs += static_cast<int64_t>(readVarint(ring, i));
+            uint8_t changed = ring.at(i++);
+            status ^= changed;
+
+            if (timeMs > untilMs) {
+                break;
+            }
+            if (timeMs <= sinceMs) {
+                result.initialStatus = status;
+            } else if (changed & mask) {
+                result.transitions.push_back({timeMs, status, changed});
+            }
+        }
+
+        return result;
+    }
+
+    std::size_t StateHistory::size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::size_t total = 0;
+        for (const auto &[name, ring]: rings) {
+            total += ring.used;
+        }
+        return total;
+    }
+
+} // creatures
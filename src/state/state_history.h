@@ -0,0 +1,108 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_STATE_HISTORY_H
+#define ANDERSEN_MQTT_STATE_HISTORY_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace creatures {
+
+    /**
+     * One time a window's status changed
+     */
+    struct StatusTransition {
+        int64_t timeMs;         // ms since the epoch
+        uint8_t status;         // the whole status byte after the change
+        uint8_t changed;        // which bits changed
+    };
+
+    /**
+     * What a query found
+     */
+    struct HistoryResult {
+
+        // The status going into the window we asked about, if we know it
+        std::optional<uint8_t> initialStatus;
+
+        std::vector<StatusTransition> transitions;
+
+        // False if the history doesn't go back as far as we asked
+        bool complete = false;
+    };
+
+    /**
+     * Every status change for every window, kept in memory as small as we can make it.
+     *
+     * Each window gets its own ring of bytes. A change is the time since the one before it
+     * (as a varint, in ms) and an XOR mask of the bits that flipped, so most are four or five
+     * bytes. A 4 KiB ring holds somewhere around 800 of them, which is days of a window opening,
+     * closing, and seeing rain. When a ring is full the oldest changes get folded into the
+     * starting point, so we always know the state at the start of what's left. Each ring is
+     * allocated once, the first time we hear about its window, so recording a change never goes to
+     * the heap.
+     *
+     * The processor records and the MQTT threads query, so it's all behind one mutex.
+     */
+    class StateHistory {
+
+    public:
+        explicit StateHistory(std::size_t bytesPerWindow) : bytesPerWindow(bytesPerWindow) {}
+
+        /**
+         * Remembers a status we just got. Nothing is stored unless it changed.
+         */
+        void record(const std::string &window, uint8_t status, std::chrono::system_clock::time_point when);
+
+        /**
+         * Changes to any of the bits in mask between since and until (ms since the epoch)
+         *
+         * @return nothing if we've never heard about this window
+         */
+        std::optional<HistoryResult> query(const std::string &window, uint8_t mask, int64_t sinceMs,
+                                           int64_t untilMs) const;
+
+        /**
+         * Bytes of history kept across every window
+         */
+        std::size_t size() const;
+
+    private:
+        struct Ring {
+
+            // Sized once, the first time we hear about the window, and wrapped around after that
+            std::vector<uint8_t> bytes;
+            std::size_t head = 0;           // where the oldest byte is
+            std::size_t used = 0;
+
+            uint8_t at(std::size_t i) const { return bytes[(head + i) % bytes.size()]; }
+            void push(uint8_t byte) { bytes[(head + used++) % bytes.size()] = byte; }
+
+            // Where the oldest change still in the ring starts from
+            int64_t baseMs = 0;
+            uint8_t baseStatus = 0;
+
+            // ...and where the newest left off
+            int64_t lastMs = 0;
+            uint8_t lastStatus = 0;
+        };
+
+        static void evictOldest(Ring &ring);
+
+        std::size_t bytesPerWindow;
+
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Ring> rings;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_STATE_HISTORY_H
@@ -0,0 +1,167 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+
+#include "namespace-stuffs.h"
+
+#include <nlohmann/json.hpp>
+
+#include "state_snapshot.h"
+
+#include "threading/threading.h"
+
+using json = nlohmann::json;
+
+namespace creatures {
+
+    namespace {
+        constexpr int snapshotVersion = 1;
+
+        // Makes the rename itself stick, not just the file contents
+        void syncDirectory(const std::string &path) {
+            auto slash = path.find_last_of('/');
+            std::string directory = slash == std::string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+
+            int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+            if (fd >= 0) {
+                fsync(fd);
+                close(fd);
+            }
+        }
+    }
+
+    bool StateSnapshot::load(const std::vector<std::shared_ptr<Window>> &windows) {
+
+        std::ifstream file(path);
+        if (!file) {
+            info("no saved state at {}, starting fresh", path);
+            return false;
+        }
+
+        json snapshot = json::parse(file, nullptr, false);
+        if (snapshot.is_discarded() || snapshot.value("version", 0) != snapshotVersion ||
+            !snapshot.contains("windows") || !snapshot["windows"].is_array()) {
+            warn("ignoring saved state at {} since it doesn't make sense", path);
+            return false;
+        }
+
+        std::size_t restored = 0;
+        for (const auto &saved: snapshot["windows"]) {
+            if (!saved.is_object()) {
+                continue;
+            }
+
+            auto name = saved.value("name", std::string());
+            for (const auto &window: windows) {
+                if (window->getName() == name && saved.contains("status")) {
+                    auto polledAt = std::chrono::system_clock::time_point(
+                            std::chrono::milliseconds(saved.value("lastPolled", int64_t(0))));
+                    window->restore(saved.value("status", uint8_t(0)), polledAt);
+                    restored++;
+                }
+            }
+        }
+
+        info("restored {} windows from {}", restored, path);
+        return restored > 0;
+    }
+
+    bool StateSnapshot::save(const std::vector<std::shared_ptr<Window>> &windows) {
+
+        json snapshot;
+        snapshot["version"] = snapshotVersion;
+        snapshot["windows"] = json::array();
+        for (const auto &window: windows) {
+            auto state = window->getState();
+            if (!state.known) {
+                continue;
+            }
+            snapshot["windows"].push_back({
+                    {"name", window->getName()},
+                    {"status", state.statusByte},
+                    {"lastPolled", std::chrono::duration_cast<std::chrono::milliseconds>(
+                            state.lastPolled.time_since_epoch()).count()}
+            });
+        }
+        std::string contents = snapshot.dump();
+
+        std::string temporary = path + ".tmp";
+        int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            error("unable to write saved state {}: {}", temporary, strerror(errno));
+            return false;
+        }
+
+        bool good = ::write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size()) &&
+                    fsync(fd) == 0;
+        close(fd);
+
+        if (!good || rename(temporary.c_str(), path.c_str()) != 0) {
+            error("unable to save state to {}: {}", path, strerror(errno));
+            unlink(temporary.c_str());
+            return false;
+        }
+
+        syncDirectory(path);
+        debug("saved state to {}", path);
+        return true;
+    }
+
+    StateSnapshot::~StateSnapshot() {
+        stop();
+    }
+
+    void StateSnapshot::start(std::vector<std::shared_ptr<Window>> windowsToSave, std::chrono::milliseconds interval) {
+        windows = std::move(windowsToSave);
+        minInterval = interval;
+        thread = std::jthread([this](std::stop_token stopToken) { saver(stopToken); });
+    }
+
+    void StateSnapshot::saveSoon() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (dirty) {
+                return;
+            }
+            dirty = true;
+        }
+        changed.notify_one();
+    }
+
+    void StateSnapshot::stop() {
+        if (thread.joinable()) {
+            thread.request_stop();
+            thread.join();
+        }
+    }
+
+    void StateSnapshot::saver(std::stop_token stopToken) {
+        threading::setup("state");
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, stopToken, [this] { return dirty; });
+                if (!dirty) {
+                    return;     // Asked to stop with nothing left to save
+                }
+                dirty = false;
+            }
+
+            // The windows are safe to read from here, and whatever they say now is the latest
+            save(windows);
+
+            // Anything that changes while we wait goes out in one go after. Stopping cuts the wait
+            // short, and then we save one last time if we need to.
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait_for(lock, stopToken, minInterval, [] { return false; });
+        }
+    }
+
+} // creatures
@@ -0,0 +1,85 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_STATE_SNAPSHOT_H
+#define ANDERSEN_MQTT_STATE_SNAPSHOT_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "window/window.h"
+
+namespace creatures {
+
+    /**
+     * The last thing we knew about every window, kept in a small file so we don't start
+     * from nothing every time we're restarted.
+     *
+     * It's written to a temporary file and renamed into place, so a crash (or the power
+     * going out) leaves either the old snapshot or the new one, never half of one.
+     *
+     * All those fsync()s are slow, so while we're running the saving happens on a thread of
+     * its own (see start()), and a burst of changes only gets written once.
+     */
+    class StateSnapshot {
+
+    public:
+        explicit StateSnapshot(std::string path) : path(std::move(path)) {}
+        ~StateSnapshot();
+
+        /**
+         * Restores any windows we have a saved status for
+         *
+         * @return true if at least one window was restored
+         */
+        bool load(const std::vector<std::shared_ptr<Window>> &windows);
+
+        /**
+         * Writes out the current status of every window that has one
+         *
+         * @return false if it couldn't be written (the old snapshot is left alone)
+         */
+        bool save(const std::vector<std::shared_ptr<Window>> &windows);
+
+        /**
+         * Starts the thread that does the saving for saveSoon(). Saves are at least minInterval
+         * apart, and whatever changed in between goes out in the next one.
+         */
+        void start(std::vector<std::shared_ptr<Window>> windows,
+                   std::chrono::milliseconds minInterval = std::chrono::milliseconds(1000));
+
+        /**
+         * Lets the saving thread know something changed. Never waits on the disk, so it's fine
+         * to call for every frame.
+         */
+        void saveSoon();
+
+        /**
+         * Stops the saving thread. Anything it hadn't gotten to yet is saved first.
+         */
+        void stop();
+
+    private:
+        void saver(std::stop_token stopToken);
+
+        std::string path;
+
+        std::vector<std::shared_ptr<Window>> windows;
+        std::chrono::milliseconds minInterval{1000};
+
+        std::mutex mutex;
+        std::condition_variable_any changed;
+        bool dirty = false;
+        std::jthread thread;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_STATE_SNAPSHOT_H
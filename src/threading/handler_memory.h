@@ -0,0 +1,121 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_HANDLER_MEMORY_H
+#define ANDERSEN_MQTT_HANDLER_MEMORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace creatures {
+
+    /**
+     * A spot for asio to build a posted handler in, so handing work to an io_context from one of
+     * our own threads doesn't go to the heap every time. (asio only recycles handler memory for
+     * threads that are running an io_context, and the processor isn't one of those.)
+     *
+     * There's only room for one at a time. If it's in use, or the handler is too big, we fall
+     * back to operator new, so the worst this can do is nothing.
+     */
+    class HandlerMemory {
+
+    public:
+        HandlerMemory() = default;
+        HandlerMemory(const HandlerMemory &) = delete;
+        HandlerMemory &operator=(const HandlerMemory &) = delete;
+
+        void *allocate(std::size_t size) {
+            if (size <= sizeof(storage) && !inUse.exchange(true, std::memory_order_acquire)) {
+                return storage;
+            }
+            return ::operator new(size);
+        }
+
+        // This is usually called on the io thread, not the one that allocated
+        void deallocate(void *pointer) {
+            if (pointer == storage) {
+                inUse.store(false, std::memory_order_release);
+            } else {
+                ::operator delete(pointer);
+            }
+        }
+
+    private:
+        alignas(std::max_align_t) std::byte storage[256];
+        std::atomic<bool> inUse = false;
+    };
+
+
+    /**
+     * The allocator asio finds on a handler wrapped by withMemory()
+     */
+    template<typename T>
+    class HandlerAllocator {
+
+    public:
+        using value_type = T;
+
+        explicit HandlerAllocator(HandlerMemory &memory) noexcept : memory(&memory) {}
+
+        template<typename U>
+        HandlerAllocator(const HandlerAllocator<U> &other) noexcept : memory(other.memory) {}
+
+        T *allocate(std::size_t n) const {
+            return static_cast<T *>(memory->allocate(sizeof(T) * n));
+        }
+
+        void deallocate(T *pointer, std::size_t) const {
+            memory->deallocate(pointer);
+        }
+
+        template<typename U>
+        bool operator==(const HandlerAllocator<U> &other) const noexcept { return memory == other.memory; }
+
+        template<typename U>
+        bool operator!=(const HandlerAllocator<U> &other) const noexcept { return memory != other.memory; }
+
+    private:
+        template<typename> friend class HandlerAllocator;
+
+        HandlerMemory *memory;
+    };
+
+
+    template<typename Handler>
+    class MemoryBoundHandler {
+
+    public:
+        using allocator_type = HandlerAllocator<Handler>;
+
+        MemoryBoundHandler(HandlerMemory &memory, Handler handler) : memory(&memory), handler(std::move(handler)) {}
+
+        allocator_type get_allocator() const noexcept { return allocator_type(*memory); }
+
+        template<typename... Args>
+        void operator()(Args &&... args) {
+            handler(std::forward<Args>(args)...);
+        }
+
+    private:
+        HandlerMemory *memory;
+        Handler handler;
+    };
+
+    /**
+     * Wraps a handler so asio builds it in memory instead of on the heap, like
+     * boost::asio::post(ioc, withMemory(memory, [this] { ... }));
+     *
+     * The memory has to outlive anything posted with it.
+     */
+    template<typename Handler>
+    MemoryBoundHandler<std::decay_t<Handler>> withMemory(HandlerMemory &memory, Handler &&handler) {
+        return {memory, std::forward<Handler>(handler)};
+    }
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_HANDLER_MEMORY_H
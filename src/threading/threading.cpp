@@ -0,0 +1,244 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "namespace-stuffs.h"
+
+#include "threading.h"
+
+#include "logging/logging.h"
+#include "tracing/tracing.h"
+
+namespace creatures::threading {
+
+    namespace {
+        // Everything in here logs under the "threads" component
+        constexpr auto &logger = logging::component<"threads">;
+
+        struct Placement {
+            std::vector<int> cpus;
+            int fifoPriority = 0;           // 0 means stay on the normal scheduler
+            std::optional<int> nice;
+        };
+
+        struct Tracked {
+            std::string name;
+            clockid_t clock;
+            bool running = true;
+            std::chrono::microseconds finalCpu{0};
+        };
+
+        std::mutex threadingMutex;
+        std::unordered_map<std::string, Placement> placements;
+        std::vector<Tracked> tracked;
+
+        std::chrono::microseconds readClock(clockid_t clock) {
+            timespec ts{};
+            if (clock_gettime(clock, &ts) != 0) {
+                return std::chrono::microseconds(0);
+            }
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec));
+        }
+
+        // Grabs the final tally when a tracked thread goes away, since its clock goes with it
+        struct ExitRecorder {
+            std::optional<std::size_t> index;
+
+            ~ExitRecorder() {
+                if (!index) {
+                    return;
+                }
+                auto cpu = readClock(CLOCK_THREAD_CPUTIME_ID);
+                std::lock_guard<std::mutex> lock(threadingMutex);
+                tracked[*index].finalCpu = cpu;
+                tracked[*index].running = false;
+            }
+        };
+        thread_local ExitRecorder exitRecorder;
+
+        // "0-1,3" -> {0, 1, 3}
+        bool parseCpus(const std::string &value, std::vector<int> &cpus) {
+            std::istringstream ranges(value);
+            std::string range;
+            while (std::getline(ranges, range, ',')) {
+                auto dash = range.find('-');
+                char *end = nullptr;
+                long first = std::strtol(range.c_str(), &end, 10);
+                if (end == range.c_str() || first < 0) {
+                    return false;
+                }
+                long last = first;
+                if (dash != std::string::npos) {
+                    const char *start = range.c_str() + dash + 1;
+                    last = std::strtol(start, &end, 10);
+                    if (end == start || last < first) {
+                        return false;
+                    }
+                }
+                if (*end != '\0') {
+                    return false;
+                }
+                for (long cpu = first; cpu <= last; cpu++) {
+                    cpus.push_back(static_cast<int>(cpu));
+                }
+            }
+            return !cpus.empty();
+        }
+
+        bool applyOption(Placement &placement, const std::string &option, const std::string &value) {
+            if (option == "cpus") {
+                placement.cpus.clear();
+                return parseCpus(value, placement.cpus);
+            }
+
+            char *end = nullptr;
+            long number = std::strtol(value.c_str(), &end, 10);
+            if (end == value.c_str() || *end != '\0') {
+                return false;
+            }
+
+            if (option == "fifo" && number >= 1 && number <= 99) {
+                placement.fifoPriority = static_cast<int>(number);
+            } else if (option == "nice" && number >= -20 && number <= 19) {
+                placement.nice = static_cast<int>(number);
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        // "reader:cpus=3,fifo=50;mqtt:nice=5"
+        void parsePlacements(const std::string &spec) {
+            std::istringstream roles(spec);
+            std::string entry;
+            while (std::getline(roles, entry, ';')) {
+                if (entry.empty()) {
+                    continue;
+                }
+
+                auto colon = entry.find(':');
+                if (colon == std::string::npos || colon == 0) {
+                    logger().warn("ignoring thread settings that don't name a role: {}", entry);
+                    continue;
+                }
+
+                auto role = entry.substr(0, colon);
+                Placement placement;
+
+                std::istringstream options(entry.substr(colon + 1));
+                std::string option;
+                while (std::getline(options, option, ',')) {
+                    auto equals = option.find('=');
+                    if (equals == std::string::npos ||
+                        !applyOption(placement, option.substr(0, equals), option.substr(equals + 1))) {
+                        logger().warn("ignoring bad thread setting for {}: {}", role, option);
+                    }
+                }
+
+                placements[role] = placement;
+            }
+        }
+    }
+
+    void init(const Configuration &config) {
+
+        {
+            std::lock_guard<std::mutex> lock(threadingMutex);
+            parsePlacements(config.getThreads());
+        }
+
+        // Keep page faults out of the bus timing
+        if (config.isMlockAll()) {
+            if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+                logger().info("locked all of our memory");
+            } else {
+                logger().warn("unable to lock our memory: {} (does the container have IPC_LOCK?)", strerror(errno));
+            }
+        }
+    }
+
+    void setup(const std::string &role, const std::string &name) {
+
+        std::string threadName = (name.empty() ? role : name).substr(0, 15);
+        pthread_setname_np(pthread_self(), threadName.c_str());
+        TRACE_THREAD_NAME(threadName.c_str());
+
+        Placement placement;
+        {
+            std::lock_guard<std::mutex> lock(threadingMutex);
+            auto found = placements.find(role);
+            if (found != placements.end()) {
+                placement = found->second;
+            }
+
+            clockid_t clock;
+            if (!exitRecorder.index && pthread_getcpuclockid(pthread_self(), &clock) == 0) {
+                exitRecorder.index = tracked.size();
+                tracked.push_back({threadName, clock});
+            }
+        }
+
+        if (!placement.cpus.empty()) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            for (auto cpu: placement.cpus) {
+                CPU_SET(cpu, &cpus);
+            }
+            if (int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus); result != 0) {
+                logger().warn("unable to pin {} to its CPUs: {}", threadName, strerror(result));
+            }
+        }
+
+        if (placement.fifoPriority > 0) {
+            sched_param param{};
+            param.sched_priority = placement.fifoPriority;
+            if (int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param); result != 0) {
+                logger().warn("unable to make {} SCHED_FIFO: {} (does the container have SYS_NICE?)",
+                              threadName, strerror(result));
+            }
+        }
+
+        // Nice is per thread on Linux, as long as we go by the thread's own id
+        if (placement.nice) {
+            if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), *placement.nice) != 0) {
+                logger().warn("unable to set the nice value of {}: {}", threadName, strerror(errno));
+            }
+        }
+
+        logger().debug("thread {} is set up", threadName);
+    }
+
+    std::vector<ThreadCpuTime> cpuTimes() {
+        std::lock_guard<std::mutex> lock(threadingMutex);
+
+        std::vector<ThreadCpuTime> times;
+        for (const auto &thread: tracked) {
+            times.push_back({thread.name, thread.running ? readClock(thread.clock) : thread.finalCpu, thread.running});
+        }
+        return times;
+    }
+
+    void logCpuTimes() {
+        for (const auto &thread: cpuTimes()) {
+            logger().info("thread {} used {}us of CPU", thread.name, thread.cpu.count());
+        }
+    }
+
+} // creatures::threading
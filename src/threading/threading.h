@@ -0,0 +1,52 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_THREADING_H
+#define ANDERSEN_MQTT_THREADING_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "config/config.h"
+
+namespace creatures::threading {
+
+    /**
+     * Reads where each kind of thread should run (ANDERSEN_THREADS) and locks our memory if
+     * asked to (ANDERSEN_MLOCKALL). Call this before starting any of the threads below.
+     *
+     * Roles are reader, writer, processor, poll, signals, state (saving the snapshot), and mqtt
+     * (every broker's io thread).
+     */
+    void init(const Configuration &config);
+
+    /**
+     * Called from inside a thread when it starts. Names it (so it shows up in top -H, perf,
+     * and gdb), applies whatever placement its role was given, and starts tracking its CPU time.
+     *
+     * @param role which settings to use
+     * @param name what to call it, if it isn't just the role (trimmed to 15 characters)
+     */
+    void setup(const std::string &role, const std::string &name = "");
+
+    struct ThreadCpuTime {
+        std::string name;
+        std::chrono::microseconds cpu;
+        bool running;
+    };
+
+    /**
+     * CPU time used by every thread that's called setup(), including the ones that have finished
+     */
+    std::vector<ThreadCpuTime> cpuTimes();
+
+    /**
+     * Logs cpuTimes()
+     */
+    void logCpuTimes();
+
+} // creatures::threading
+
+#endif //ANDERSEN_MQTT_THREADING_H
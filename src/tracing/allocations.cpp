@@ -0,0 +1,43 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <atomic>
+
+#include "allocations.h"
+
+namespace creatures::allocations {
+
+    namespace {
+        // Per thread, so the count for one thread doesn't need any locking (or atomics) at all
+        thread_local uint64_t heapAllocations = 0;
+        thread_local uint32_t exemptions = 0;
+
+        std::atomic<uint64_t> allHeapAllocations = 0;
+    }
+
+    uint64_t count() {
+        return heapAllocations;
+    }
+
+    uint64_t total() {
+        return allHeapAllocations.load(std::memory_order_relaxed);
+    }
+
+    void counted() {
+        if (exemptions > 0) {
+            return;
+        }
+        heapAllocations++;
+        allHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Exempt::Exempt() {
+        exemptions++;
+    }
+
+    Exempt::~Exempt() {
+        exemptions--;
+    }
+
+} // creatures::allocations
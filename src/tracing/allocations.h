@@ -0,0 +1,58 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_ALLOCATIONS_H
+#define ANDERSEN_MQTT_ALLOCATIONS_H
+
+#include <cstdint>
+
+/*
+ * Counts trips to the heap, so we can make sure handling a frame doesn't make any once
+ * things have settled down.
+ *
+ * The counting operator new is in counting_new.cpp, and only the programs that want it link it
+ * in: the daemon when we're built with -DANDERSEN_ALLOC_AUDIT=ON, and the allocations test.
+ * Without it the counts are always 0 and nothing else changes.
+ */
+
+namespace creatures::allocations {
+
+#ifdef ANDERSEN_ALLOC_AUDIT
+    inline constexpr bool audited = true;
+#else
+    inline constexpr bool audited = false;
+#endif
+
+    /**
+     * How many allocations the calling thread has made so far
+     */
+    uint64_t count();
+
+    /**
+     * How many allocations every thread has made so far
+     */
+    uint64_t total();
+
+    /**
+     * Called by the counting operator new for every allocation
+     */
+    void counted();
+
+    /**
+     * Allocations on this thread don't count while one of these is around. This is for code that
+     * isn't ours to fix, like the MQTT library copying what we hand it to publish.
+     */
+    class Exempt {
+
+    public:
+        Exempt();
+        ~Exempt();
+
+        Exempt(const Exempt &) = delete;
+        Exempt &operator=(const Exempt &) = delete;
+    };
+
+} // creatures::allocations
+
+#endif //ANDERSEN_MQTT_ALLOCATIONS_H
@@ -0,0 +1,69 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+/*
+ * The global operator new, swapped for one that counts (see allocations.h). This is its own
+ * object library rather than part of andersen_core, since only one of these can be in a program.
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "allocations.h"
+
+namespace {
+    void *allocate(std::size_t size, std::size_t alignment) {
+        creatures::allocations::counted();
+
+        void *pointer = nullptr;
+        if (alignment <= alignof(std::max_align_t)) {
+            pointer = std::malloc(size ? size : 1);
+        } else {
+            // aligned_alloc() wants the size to be a multiple of the alignment
+            pointer = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+        }
+        return pointer;
+    }
+}
+
+// The array versions all end up in these
+
+void *operator new(std::size_t size) {
+    if (void *pointer = allocate(size, alignof(std::max_align_t))) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    if (void *pointer = allocate(size, static_cast<std::size_t>(alignment))) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return allocate(size, alignof(std::max_align_t));
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
@@ -0,0 +1,47 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_TRACING_H
+#define ANDERSEN_MQTT_TRACING_H
+
+/*
+ * Profiler zones, for when we want to see where the time goes between a byte showing up
+ * from the gateway and a publish going out.
+ *
+ * These are only real when we're built with -DANDERSEN_TRACING=ON, which pulls in Tracy.
+ * Otherwise every one of these is nothing at all (the arguments aren't even evaluated), so
+ * a normal build doesn't pay for them.
+ *
+ * Plot names have to be string literals (or otherwise live forever), since Tracy only
+ * keeps the pointer.
+ */
+
+#ifdef ANDERSEN_TRACING
+
+#include <cstdint>
+
+#include <tracy/Tracy.hpp>
+
+// Times the rest of the enclosing scope
+#define TRACE_ZONE(name) ZoneScopedN(name)
+
+// Tags the current zone with a number (a window, a message type, etc)
+#define TRACE_ZONE_VALUE(value) ZoneValue(static_cast<uint64_t>(value))
+
+// Graphs a value over time, like a queue depth
+#define TRACE_PLOT(name, value) TracyPlot(name, static_cast<int64_t>(value))
+
+// Names the calling thread in the timeline
+#define TRACE_THREAD_NAME(name) tracy::SetThreadName(name)
+
+#else
+
+#define TRACE_ZONE(name)
+#define TRACE_ZONE_VALUE(value) ((void)0)
+#define TRACE_PLOT(name, value) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+
+#endif
+
+#endif //ANDERSEN_MQTT_TRACING_H
@@ -0,0 +1,90 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+
+#include "namespace-stuffs.h"
+
+#include "command_compiler.h"
+
+namespace creatures {
+
+    void CommandCompiler::addWindow(std::shared_ptr<Window> window) {
+        windows.push_back(std::move(window));
+    }
+
+    std::optional<uint8_t> CommandCompiler::commandFromName(const std::string &name) {
+        if (name.empty()) {
+            return std::nullopt;
+        }
+
+        switch (name[0]) {
+            case 'o':
+                return CMD_OPEN;
+            case 'c':
+                return CMD_CLOSE;
+            case 's':
+                return CMD_STOP;
+            default:
+                return std::nullopt;
+        }
+    }
+
+    std::vector<uint8_t> CommandCompiler::createFrame(uint8_t panel, uint8_t window, uint8_t command) {
+        std::vector<uint8_t> frame = {SRC_CONTROLLER, panel, window, command};
+        frame.push_back(Window::calculateChecksum(frame));
+        return frame;
+    }
+
+    std::vector<std::vector<uint8_t>> CommandCompiler::compile(const std::vector<WindowCommand> &commands) const {
+
+        // Last one wins, but keep the order things were first asked for in
+        std::vector<WindowCommand> wanted;
+        for (const auto &command: commands) {
+            auto existing = std::find_if(wanted.begin(), wanted.end(),
+                                         [&](const WindowCommand &w) { return w.window == command.window; });
+            if (existing != wanted.end()) {
+                existing->command = command.command;
+            } else {
+                wanted.push_back(command);
+            }
+        }
+
+        // Panels in the order they first show up
+        std::vector<uint8_t> panels;
+        for (const auto &command: wanted) {
+            if (std::find(panels.begin(), panels.end(), command.window->getPanel()) == panels.end()) {
+                panels.push_back(command.window->getPanel());
+            }
+        }
+
+        std::vector<std::vector<uint8_t>> frames;
+        for (auto panel: panels) {
+
+            std::vector<WindowCommand> onPanel;
+            std::copy_if(wanted.begin(), wanted.end(), std::back_inserter(onPanel),
+                         [panel](const WindowCommand &w) { return w.window->getPanel() == panel; });
+
+            auto panelSize = std::count_if(windows.begin(), windows.end(),
+                                           [panel](const std::shared_ptr<Window> &w) { return w->getPanel() == panel; });
+
+            // Every window on the panel doing the same thing? That's what WINDOW_ALL is for.
+            bool allSame = std::all_of(onPanel.begin(), onPanel.end(),
+                                       [&](const WindowCommand &w) { return w.command == onPanel.front().command; });
+            if (onPanel.size() > 1 && static_cast<std::size_t>(panelSize) == onPanel.size() && allSame) {
+                debug("sending command {} to all {} windows on panel {} in one frame",
+                      onPanel.front().command, onPanel.size(), panel);
+                frames.push_back(createFrame(panel, WINDOW_ALL, onPanel.front().command));
+                continue;
+            }
+
+            for (const auto &command: onPanel) {
+                frames.push_back(createFrame(panel, command.window->getNumber(), command.command));
+            }
+        }
+
+        return frames;
+    }
+
+} // creatures
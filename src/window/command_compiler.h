@@ -0,0 +1,62 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_COMMAND_COMPILER_H
+#define ANDERSEN_MQTT_COMMAND_COMPILER_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "window.h"
+
+namespace creatures {
+
+    /**
+     * One thing we want one window to do
+     */
+    struct WindowCommand {
+        std::shared_ptr<Window> window;
+        uint8_t command;
+    };
+
+    /**
+     * Turns a set of window commands into as few frames on the bus as we can get away with.
+     *
+     * The bus runs at 9600 baud and every frame gets its own ACK, so "close everything" should
+     * be one WINDOW_ALL frame per panel, not one frame per window. When a panel's windows
+     * aren't all doing the same thing we fall back to one frame each, in the order asked for.
+     */
+    class CommandCompiler {
+
+    public:
+        /**
+         * Windows have to be added here so we know what "all" means on each panel
+         */
+        void addWindow(std::shared_ptr<Window> window);
+
+        /**
+         * If a window shows up more than once, the last command for it wins
+         */
+        [[nodiscard]] std::vector<std::vector<uint8_t>> compile(const std::vector<WindowCommand> &commands) const;
+
+        /**
+         * "open", "close", or "stop" (only the first letter matters, same as the window topics)
+         */
+        static std::optional<uint8_t> commandFromName(const std::string &name);
+
+        /**
+         * A single frame from us, with its checksum
+         */
+        static std::vector<uint8_t> createFrame(uint8_t panel, uint8_t window, uint8_t command);
+
+    private:
+        std::vector<std::shared_ptr<Window>> windows;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_COMMAND_COMPILER_H
@@ -0,0 +1,105 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+#include <vector>
+
+#include "namespace-stuffs.h"
+
+#include "framer.h"
+#include "window.h"
+
+#include "tracing/tracing.h"
+
+namespace creatures {
+
+    void Framer::feed(const uint8_t *bytes, size_t size) {
+        TRACE_ZONE("Framer::feed");
+
+        // Append newly received bytes to the persistent buffer
+        buffer.insert(buffer.end(), bytes, bytes + size);
+
+        // Process complete messages
+        while (!buffer.empty()) {
+            // Synchronize to the header byte (0xFF)
+            auto it = std::find(buffer.begin(), buffer.end(), 0xFF);
+            if (it != buffer.begin()) {
+                if (it == buffer.end()) {
+                    debug("No valid header found. Clearing buffer.");
+                    discardedBytes += buffer.size();
+                    buffer.clear();
+                    break;
+                }
+                debug("Synchronizing buffer. Removing {} invalid bytes.", std::distance(buffer.begin(), it));
+                discardedBytes += std::distance(buffer.begin(), it);
+                buffer.erase(buffer.begin(), it); // Remove invalid bytes
+            }
+
+            // Ensure we have enough bytes to determine the message type (at least 3 bytes)
+            if (buffer.size() < 3) {
+                debug("Not enough bytes to determine message type. Waiting for more data...");
+                break;
+            }
+
+            // Determine the expected message size
+            size_t expectedSize = 0;
+            uint8_t messageType = buffer[2]; // Assuming the third byte is the message type
+
+            if (messageType == CMD_STATUS_WITHOUT_POLL || messageType == CMD_STATUS_WITH_POLL) { // STATUS message (always all windows)
+                expectedSize = 8; // Always 8 bytes for STATUS with all windows
+                debug("Detected STATUS message for all windows. Expected size: 8 bytes.");
+            } else if (messageType == CONTROLLER_ACK || messageType == CONTROLLER_BUSY) { // ACK or BUSY
+                expectedSize = 5;
+                debug("Detected ACK or BUSY message. Expected size: 5 bytes.");
+            } else {
+                debug("Unknown message type: 0x{:02X}. Discarding header byte.", messageType);
+                discardedBytes++;
+                buffer.erase(buffer.begin()); // Remove the header and try again
+                continue;
+            }
+
+            // If we don't have enough bytes for the full message, wait for more
+            if (buffer.size() < expectedSize) {
+                debug("Not enough bytes yet. Expected {}, but have {}.", expectedSize, buffer.size());
+                break;
+            }
+
+            // The full message, right where it sits
+            const uint8_t *message = buffer.data();
+
+            // Debug: Log the full message being processed (the hex strings aren't free, so only if it'll be seen)
+            bool verbose = spdlog::should_log(spdlog::level::debug);
+            if (verbose) {
+                debug("Processing full message: [{}]", joinStrings(Window::bytesToHexStrings(message, expectedSize)));
+            }
+
+            // Validate the checksum
+            if (!Window::validateChecksum(message, expectedSize)) {
+                if (verbose) {
+                    debug("Checksum validation failed. Message: [{}], Provided checksum: 0x{:x}",
+                          joinStrings(Window::bytesToHexStrings(message, expectedSize)),
+                          message[expectedSize - 1]);
+                }
+                warn("Invalid checksum received. Discarding message.");
+                checksumErrors++;
+                discardedBytes += expectedSize;
+                buffer.erase(buffer.begin(), buffer.begin() + expectedSize); // Remove processed bytes
+                continue;
+            }
+
+            // Log the valid message
+            if (verbose) {
+                debug("Valid message received: [{}]", joinStrings(Window::bytesToHexStrings(message, expectedSize)));
+            }
+
+            // Hand it off before it goes away
+            frames++;
+            handler(message, expectedSize);
+
+            // Remove the processed message from the buffer
+            buffer.erase(buffer.begin(), buffer.begin() + expectedSize);
+        }
+    }
+
+} // creatures
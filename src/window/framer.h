@@ -0,0 +1,57 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_FRAMER_H
+#define ANDERSEN_MQTT_FRAMER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace creatures {
+
+    /**
+     * Turns the raw byte stream from the gateway into complete, checksum-validated frames.
+     *
+     * Bytes can show up in any size chunks, so anything that isn't a whole frame yet is held
+     * on to until the next call to feed().
+     *
+     * Frames are handed over in place, straight out of our buffer. Nothing is copied (or allocated)
+     * unless the handler wants to keep it around.
+     */
+    class Framer {
+
+    public:
+        // The frame is only good until the handler returns
+        using FrameHandler = std::function<void(const uint8_t *frame, size_t size)>;
+
+        explicit Framer(FrameHandler handler) : handler(std::move(handler)) {
+            buffer.reserve(2048);
+        }
+
+        /**
+         * Adds bytes from the wire. The handler is called once for every valid frame they complete.
+         */
+        void feed(const uint8_t *bytes, size_t size);
+
+        [[nodiscard]] uint64_t getFrames() const { return frames; }
+        [[nodiscard]] uint64_t getChecksumErrors() const { return checksumErrors; }
+        [[nodiscard]] uint64_t getDiscardedBytes() const { return discardedBytes; }
+
+    private:
+
+        FrameHandler handler;
+
+        // Persistent buffer for accumulating bytes
+        std::vector<uint8_t> buffer;
+
+        uint64_t frames = 0;
+        uint64_t checksumErrors = 0;
+        uint64_t discardedBytes = 0;
+
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_FRAMER_H
@@ -0,0 +1,112 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <sstream>
+
+#include "namespace-stuffs.h"
+
+#include "groups.h"
+#include "command_compiler.h"
+
+namespace creatures {
+
+    namespace {
+
+        // Splits "name=stuff" apart, and complains if it isn't
+        bool splitEntry(const std::string &entry, std::string &name, std::string &members) {
+            auto equals = entry.find('=');
+            if (equals == std::string::npos || equals == 0) {
+                return false;
+            }
+            name = entry.substr(0, equals);
+            members = entry.substr(equals + 1);
+            return true;
+        }
+    }
+
+    bool WindowGroups::applyGroups(const std::string &spec) {
+
+        bool good = true;
+
+        std::istringstream entries(spec);
+        std::string entry;
+        while (std::getline(entries, entry, ';')) {
+            if (entry.empty()) {
+                continue;
+            }
+
+            std::string name, members;
+            if (!splitEntry(entry, name, members)) {
+                warn("ignoring bad group: {}", entry);
+                good = false;
+                continue;
+            }
+
+            std::vector<std::string> windows;
+            std::istringstream names(members);
+            std::string window;
+            while (std::getline(names, window, ',')) {
+                if (!window.empty()) {
+                    windows.push_back(window);
+                }
+            }
+
+            debug("group {} has {} windows", name, windows.size());
+            groups[name] = std::move(windows);
+        }
+
+        return good;
+    }
+
+    bool WindowGroups::applyScenes(const std::string &spec) {
+
+        bool good = true;
+
+        std::istringstream entries(spec);
+        std::string entry;
+        while (std::getline(entries, entry, ';')) {
+            if (entry.empty()) {
+                continue;
+            }
+
+            std::string name, members;
+            if (!splitEntry(entry, name, members)) {
+                warn("ignoring bad scene: {}", entry);
+                good = false;
+                continue;
+            }
+
+            std::vector<std::pair<std::string, uint8_t>> commands;
+            std::istringstream parts(members);
+            std::string part;
+            while (std::getline(parts, part, ',')) {
+                auto colon = part.find(':');
+                auto command = colon == std::string::npos
+                               ? std::nullopt : CommandCompiler::commandFromName(part.substr(colon + 1));
+                if (!command) {
+                    warn("ignoring bad command in scene {}: {}", name, part);
+                    good = false;
+                    continue;
+                }
+                commands.emplace_back(part.substr(0, colon), *command);
+            }
+
+            debug("scene {} has {} commands", name, commands.size());
+            scenes[name] = std::move(commands);
+        }
+
+        return good;
+    }
+
+    const std::vector<std::string> *WindowGroups::group(const std::string &name) const {
+        auto found = groups.find(name);
+        return found == groups.end() ? nullptr : &found->second;
+    }
+
+    const std::vector<std::pair<std::string, uint8_t>> *WindowGroups::scene(const std::string &name) const {
+        auto found = scenes.find(name);
+        return found == scenes.end() ? nullptr : &found->second;
+    }
+
+} // creatures
@@ -0,0 +1,55 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_GROUPS_H
+#define ANDERSEN_MQTT_GROUPS_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace creatures {
+
+    /**
+     * Named sets of windows (groups) and named sets of window commands (scenes).
+     *
+     * These only hold window names. Turning them into frames is the CommandCompiler's job.
+     */
+    class WindowGroups {
+
+    public:
+        /**
+         * Adds groups in the form "name=window1,window2;name=..."
+         *
+         * @return false if any of it didn't make sense (the parts that did are still applied)
+         */
+        bool applyGroups(const std::string &spec);
+
+        /**
+         * Adds scenes in the form "name=window1:close,window2:open;name=..."
+         *
+         * @return false if any of it didn't make sense (the parts that did are still applied)
+         */
+        bool applyScenes(const std::string &spec);
+
+        /**
+         * @return the windows in a group, or nullptr if there's no such group
+         */
+        [[nodiscard]] const std::vector<std::string> *group(const std::string &name) const;
+
+        /**
+         * @return the window name and command pairs in a scene, or nullptr if there's no such scene
+         */
+        [[nodiscard]] const std::vector<std::pair<std::string, uint8_t>> *scene(const std::string &name) const;
+
+    private:
+        std::map<std::string, std::vector<std::string>> groups;
+        std::map<std::string, std::vector<std::pair<std::string, uint8_t>>> scenes;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_GROUPS_H
@@ -3,7 +3,8 @@
 //
 
 
-#include <bitset>
+#include <algorithm>
+#include <ctime>
 #include <string>
 #include <utility>
 
@@ -14,95 +15,116 @@
 
 #include "window.h"
 
+#include "logging/logging.h"
+#include "tracing/tracing.h"
+
 using json = nlohmann::json;
 
 
 namespace creatures {
 
-    std::string Window::timePointToISO8601(const std::chrono::system_clock::time_point &tp) const {
-        auto timeT = std::chrono::system_clock::to_time_t(tp);
-        std::ostringstream oss;
-        oss << std::put_time(std::gmtime(&timeT), "%Y-%m-%dT%H:%M:%SZ");
-        return oss.str();
+    namespace {
+        // Everything in here logs under the "window" component
+        constexpr auto &logger = logging::component<"window">;
     }
 
-
-    std::string Window::createPrefix() {
-        return "andersen-mqtt/windows/" + getName() + "/";
+    std::string Window::getLastPolled() const {
+        std::string text;
+        formatISO8601(getLastPolledTime(), text);
+        return text;
     }
 
-    void Window::setStatus(uint8_t statusByte) {
-
-        debug("updating status (0x{:x}) for window {}: {}", statusByte, this->number, this->name);
+    void Window::formatISO8601(std::chrono::system_clock::time_point tp, std::string &into) {
+        auto timeT = std::chrono::system_clock::to_time_t(tp);
+        std::tm utc{};
+        gmtime_r(&timeT, &utc);
 
-        // Now for the best thing in modern C++, bitsets!
-        std::bitset<8> status(statusByte);
+        char text[32];
+        auto length = std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &utc);
+        into.assign(text, length);
+    }
 
-        if (open != status.test(0)) {
-            openUpdated = true;
-            open = status.test(0);
+    std::optional<std::chrono::system_clock::time_point> Window::parseISO8601(const std::string &text) {
+        std::tm utc{};
+        const char *end = strptime(text.c_str(), "%Y-%m-%dT%H:%M:%SZ", &utc);
+        if (end == nullptr || *end != '\0') {
+            return std::nullopt;
         }
+        return std::chrono::system_clock::from_time_t(timegm(&utc));
+    }
 
-        if (movementObstructed != status.test(1)) {
-            movementObstructedUpdated = true;
-            movementObstructed = status.test(1);
-        }
 
-        if (screenMissing != status.test(2)) {
-            screenMissingUpdated = true;
-            screenMissing = status.test(2);
-        }
+    std::string Window::createPrefix() {
+        return "andersen-mqtt/windows/" + getName() + "/";
+    }
 
-        if (rfHeard != status.test(3)) {
-            rfHeardUpdated = true;
-            rfHeard = status.test(3);
-        }
+    namespace {
+        constexpr uint64_t statusMask = 0xFF;
+        constexpr uint64_t knownBit = 1 << 8;
+        constexpr int polledShift = 9;
+    }
 
-        if (rainSensed != status.test(4)) {
-            rainSensedUpdated = true;
-            rainSensed = status.test(4);
-        }
+    Window::State Window::getState() const {
+        auto packed = state.load(std::memory_order_acquire);
+        return {
+                static_cast<uint8_t>(packed & statusMask),
+                (packed & knownBit) != 0,
+                std::chrono::system_clock::time_point(std::chrono::microseconds(packed >> polledShift))
+        };
+    }
 
-        if (rainOverrideActive != status.test(5)) {
-            rainOverrideActiveUpdated = true;
-            rainOverrideActive = status.test(5);
-        }
+    void Window::setStatus(uint8_t statusByte) {
+        TRACE_ZONE("Window::setStatus");
+        TRACE_ZONE_VALUE(this->number);
+
+        logger().debug("updating status (0x{:x}) for window {}: {}", statusByte, this->number, this->name);
+        update(statusByte, std::chrono::system_clock::now());
+    }
 
-        // Update the last updated time
-        this->lastPolled = std::chrono::system_clock::now();
-        lastPolledUpdated = true;
+    void Window::restore(uint8_t statusByte, std::chrono::system_clock::time_point polledAt) {
+        update(statusByte, polledAt);
+    }
+
+    void Window::update(uint8_t statusByte, std::chrono::system_clock::time_point polledAt) {
 
+        // Nothing we hear about is from before 1970, but don't let a bad time wrap around
+        auto polledUs = std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                polledAt.time_since_epoch()).count(), 0);
+        state.store((static_cast<uint64_t>(polledUs) << polledShift) | knownBit | statusByte,
+                    std::memory_order_release);
     }
 
-    void Window::resetUpdatedFlags() {
-        openUpdated = false;
-        movementObstructedUpdated = false;
-        screenMissingUpdated = false;
-        rfHeardUpdated = false;
-        rainSensedUpdated = false;
-        rainOverrideActiveUpdated = false;
-        lastPolledUpdated = false;
+    std::vector<uint8_t> Window::createCommand(uint8_t command) const {
+        // Window numbers line up with WINDOW_1 through WINDOW_4 on the bus
+        std::vector<uint8_t> frame = {SRC_CONTROLLER, this->panel, this->number, command};
+        frame.push_back(calculateChecksum(frame));
+        return frame;
     }
 
 
     std::string Window::toJson() const {
-        debug("serializing window {} to json", this->number);
+        logger().debug("serializing window {} to json", this->number);
+
+        // This gets called from the HTTP thread while the processor is updating us
+        auto current = getState();
+        std::string lastPolledText;
+        formatISO8601(current.lastPolled, lastPolledText);
 
         json j;
         j["name"] = this->name;
         j["number"] = this->number;
-        j["state"] = this->open;
-        j["movementObstructed"] = this->movementObstructed;
-        j["screenMissing"] = this->screenMissing;
-        j["rfHeard"] = this->rfHeard;
-        j["rainSensed"] = this->rainSensed;
-        j["rainOverrideActive"] = this->rainOverrideActive;
-        j["lastPolled"] = this->timePointToISO8601(this->lastPolled);
+        j["state"] = current.isOpen();
+        j["movementObstructed"] = current.isMovementObstructed();
+        j["screenMissing"] = current.isScreenMissing();
+        j["rfHeard"] = current.isRfHeard();
+        j["rainSensed"] = current.isRainSensed();
+        j["rainOverrideActive"] = current.isRainOverrideActive();
+        j["lastPolled"] = lastPolledText;
         return j.dump();
 
     }
 
-    std::string Window::getName() const {
+    const std::string &Window::getName() const {
         return this->name;
     }
 
@@ -111,27 +133,27 @@ namespace creatures {
     }
 
     bool Window::isOpen() const {
-        return this->open;
+        return getState().isOpen();
     }
 
     bool Window::isMovementObstructed() const {
-        return this->movementObstructed;
+        return getState().isMovementObstructed();
     }
 
     bool Window::isScreenMissing() const {
-        return this->screenMissing;
+        return getState().isScreenMissing();
     }
 
     bool Window::isRfHeard() const {
-        return this->rfHeard;
+        return getState().isRfHeard();
     }
 
     bool Window::isRainSensed() const {
-        return this->rainSensed;
+        return getState().isRainSensed();
     }
 
     bool Window::isRainOverrideActive() const {
-        return this->rainOverrideActive;
+        return getState().isRainOverrideActive();
     }
 
 
@@ -153,7 +175,7 @@ namespace creatures {
     }
 
 
-    std::string joinStrings(const std::vector<std::string> &strings, const std::string &delimiter = ", ") {
+    std::string joinStrings(const std::vector<std::string> &strings, const std::string &delimiter) {
         std::ostringstream oss;
         for (size_t i = 0; i < strings.size(); ++i) {
             oss << strings[i];
@@ -172,21 +194,38 @@ namespace creatures {
      * @return The calculated checksum.
      */
     uint8_t Window::calculateChecksum(const std::vector<uint8_t> &message) {
-        if (message.size() <= 1) {
+        return calculateChecksum(message.data(), message.size());
+    }
+
+    /**
+     * Same as above, but straight from a buffer so the framer can check a frame before copying it anywhere
+     *
+     * @param bytes The start of the message
+     * @param size How many bytes are in it
+     * @return The calculated checksum.
+     */
+    uint8_t Window::calculateChecksum(const uint8_t *bytes, size_t size) {
+        if (size <= 1) {
             return 0; // If the message has 1 or fewer bytes, checksum is meaningless
         }
 
         uint8_t checksum = 0;
 
-        debug("Calculating checksum for [{}]", joinStrings(creatures::Window::bytesToHexStrings(message)));
+        // Don't build the hex strings unless someone is going to see them
+        bool verbose = logger().should_log(spdlog::level::debug);
+        if (verbose) {
+            logger().debug("Calculating checksum for [{}]", joinStrings(creatures::Window::bytesToHexStrings(bytes, size)));
+        }
 
         // Start summing from the second byte (index 1)
-        for (size_t i = 1; i < message.size(); ++i) {
-            debug("Adding byte {}: 0x{:02X} (checksum so far: 0x{:02X})", i, message[i], checksum);
-            checksum += message[i];
+        for (size_t i = 1; i < size; ++i) {
+            if (verbose) {
+                logger().debug("Adding byte {}: 0x{:02X} (checksum so far: 0x{:02X})", i, bytes[i], checksum);
+            }
+            checksum += bytes[i];
         }
 
-        debug("Final calculated checksum: 0x{:02X}", checksum);
+        logger().debug("Final calculated checksum: 0x{:02X}", checksum);
         return checksum;
     }
 
@@ -198,26 +237,28 @@ namespace creatures {
      * @return True if the checksum is valid, false otherwise.
      */
     bool Window::validateChecksum(const std::vector<uint8_t> &message) {
-        if (message.size() < 2) {
+        return validateChecksum(message.data(), message.size());
+    }
+
+    bool Window::validateChecksum(const uint8_t *bytes, size_t size) {
+        TRACE_ZONE("Window::validateChecksum");
+        if (size < 2) {
             // Not enough data to validate (minimum 1 byte + checksum)
             return false;
         }
 
         // Extract the provided checksum (last byte)
-        uint8_t providedChecksum = message.back();
-
-        // Create a slice of the message without the checksum byte
-        std::vector<uint8_t> messageWithoutChecksum(message.begin(), message.end() - 1);
+        uint8_t providedChecksum = bytes[size - 1];
 
-        // Calculate the checksum
-        uint8_t calculatedChecksum = calculateChecksum(messageWithoutChecksum);
+        // Calculate the checksum over everything before it
+        uint8_t calculatedChecksum = calculateChecksum(bytes, size - 1);
 
         // Debug: Show calculated and provided checksum
-        debug("Provided checksum: 0x{:02X}, Calculated checksum: 0x{:02X}", providedChecksum, calculatedChecksum);
+        logger().debug("Provided checksum: 0x{:02X}, Calculated checksum: 0x{:02X}", providedChecksum, calculatedChecksum);
 
         // Validate
-        debug("Checksum validation: {}", calculatedChecksum == providedChecksum);
+        logger().debug("Checksum validation: {}", calculatedChecksum == providedChecksum);
         return calculatedChecksum == providedChecksum;
     }
 
-} // creatures
\ No newline at end of file
+} // creatures
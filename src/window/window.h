@@ -5,6 +5,7 @@
 #ifndef ANDERSEN_MQTT_WINDOW_H
 #define ANDERSEN_MQTT_WINDOW_H
 
+#include <atomic>
 #include <chrono>
 
 #define SRC_CONTROLLER              0xFF
@@ -32,6 +33,7 @@
 
 
 #include <bitset>
+#include <optional>
 #include <string>
 #include <utility>
 
@@ -43,15 +45,58 @@ namespace creatures {
     class Window {
 
     public:
-        explicit Window(std::string name, std::uint8_t number) : name(std::move(name)), number(number) {}
+
+        /**
+         * Everything we know about the window as of one poll. The status bits are decoded from
+         * the same byte, so nothing in here can be from two different polls.
+         */
+        struct State {
+            uint8_t statusByte = 0;
+            bool known = false;
+            std::chrono::system_clock::time_point lastPolled;
+
+            [[nodiscard]] bool isOpen() const { return statusByte & 0x01; }
+            [[nodiscard]] bool isMovementObstructed() const { return statusByte & 0x02; }
+            [[nodiscard]] bool isScreenMissing() const { return statusByte & 0x04; }
+            [[nodiscard]] bool isRfHeard() const { return statusByte & 0x08; }
+            [[nodiscard]] bool isRainSensed() const { return statusByte & 0x10; }
+            [[nodiscard]] bool isRainOverrideActive() const { return statusByte & 0x20; }
+        };
+
+        explicit Window(std::string name, std::uint8_t number, std::uint8_t panel = DST_PANEL_1)
+                : name(std::move(name)), number(number), panel(panel) {}
 
         void setStatus(uint8_t statusByte);
 
+        /**
+         * Puts back a status we saved before, along with when we last heard it
+         */
+        void restore(uint8_t statusByte, std::chrono::system_clock::time_point polledAt);
+
+        /**
+         * The status byte, if we've had one, and when it came in, all from the same poll. The
+         * processor writes these while the MQTT and HTTP threads read them, so anyone who needs
+         * more than one of them at once should get them from here.
+         */
+        [[nodiscard]] State getState() const;
+
+        /**
+         * The last status byte the panel sent for this window, and if we've had one yet
+         */
+        uint8_t getStatusByte() const { return getState().statusByte; }
+        bool hasStatus() const { return getState().known; }
+
+        /**
+         * Builds the frame that sends a command (CMD_OPEN, CMD_CLOSE, CMD_STOP) to this window
+         */
+        std::vector<uint8_t> createCommand(uint8_t command) const;
+
 
         std::string createPrefix();
 
-        [[nodiscard]] std::string getName() const;
+        [[nodiscard]] const std::string &getName() const;
         uint8_t getNumber() const;
+        uint8_t getPanel() const { return panel; }
         bool isOpen() const;
         bool isMovementObstructed() const;
         bool isScreenMissing() const;
@@ -59,55 +104,46 @@ namespace creatures {
         bool isRainSensed() const;
         bool isRainOverrideActive() const;
 
-        std::string getLastPolled() const { return timePointToISO8601(lastPolled); }
-
-        void resetUpdatedFlags();
-
-        bool hasOpenUpdated() const { return openUpdated; }
-        bool hasMovementObstructedUpdated() const { return movementObstructedUpdated; }
-        bool hasScreenMissingUpdated() const { return screenMissingUpdated; }
-        bool hasRfHeardUpdated() const { return rfHeardUpdated; }
-        bool hasRainSensedUpdated() const { return rainSensedUpdated; }
-        bool hasRainOverrideActiveUpdated() const { return rainOverrideActiveUpdated; }
-        bool hasLastPolledUpdated() const { return lastPolledUpdated; }
+        std::string getLastPolled() const;
+        std::chrono::system_clock::time_point getLastPolledTime() const { return getState().lastPolled; }
 
         [[nodiscard]]
         std::string toJson() const;
 
+        /**
+         * Writes a time as ISO 8601 into a string we already have, so it can reuse its storage
+         */
+        static void formatISO8601(std::chrono::system_clock::time_point tp, std::string &into);
+
+        /**
+         * The other way around, for times we read back off the broker
+         */
+        static std::optional<std::chrono::system_clock::time_point> parseISO8601(const std::string &text);
+
         static std::vector<std::string> bytesToHexStrings(const uint8_t* bytes, size_t size);
         static std::vector<std::string> bytesToHexStrings(const std::vector<uint8_t>& bytes);
         static uint8_t calculateChecksum(const std::vector<uint8_t>& message);
+        static uint8_t calculateChecksum(const uint8_t *bytes, size_t size);
         static bool validateChecksum(const std::vector<uint8_t> &message);
+        static bool validateChecksum(const uint8_t *bytes, size_t size);
 
     private:
 
+        void update(uint8_t statusByte, std::chrono::system_clock::time_point polledAt);
+
         std::string name;
         std::uint8_t number;
+        std::uint8_t panel;
 
-        bool open;
-        bool movementObstructed;
-        bool screenMissing;
-        bool rfHeard;
-        bool rainSensed;
-        bool rainOverrideActive;
-        std::chrono::system_clock::time_point lastPolled;
-
-        bool openUpdated = true;
-        bool movementObstructedUpdated = true;
-        bool screenMissingUpdated = true;
-        bool rfHeardUpdated = true;
-        bool rainSensedUpdated = true;
-        bool rainOverrideActiveUpdated = true;
-        bool lastPolledUpdated = true;
-
-
-
-
-        [[nodiscard]] std::string timePointToISO8601(const std::chrono::system_clock::time_point& tp) const;
+        // The status byte in the low 8 bits, whether we've had one in bit 8, and the poll time (in
+        // microseconds) above that. One word, so a reader gets all of it from the same poll.
+        std::atomic<uint64_t> state = 0;
 
     };
 
 
+    // Helper to join strings for logging
+    std::string joinStrings(const std::vector<std::string> &strings, const std::string &delimiter = ", ");
 
 }
 
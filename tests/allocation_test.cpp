@@ -0,0 +1,131 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+/*
+ * Once every window has a status, a STATUS frame that doesn't change anything shouldn't go to
+ * the heap anywhere: not in the framer, not in process_message(), and not on the MQTT thread
+ * deciding there's nothing to publish.
+ *
+ * Frames that do change something shouldn't either, once the same few have been around a
+ * couple of times. Those get published and recorded in the history, so that covers the rest
+ * of the way out. The MQTT library copying what we publish doesn't count (see
+ * allocations::Exempt), and neither does the broker, which is ours and in here too.
+ *
+ * This counts every allocation the whole process makes, on every thread, and feeds a million
+ * unchanged frames through, then a hundredth as many that change.
+ *
+ * Usage: allocation_test [frames]
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "processor/processor.h"
+#include "test_broker.h"
+#include "test_check.h"
+#include "test_daemon.h"
+#include "tracing/allocations.h"
+
+using creatures::TestBroker;
+using creatures::TestDaemon;
+using creatures::testing::check;
+using creatures::testing::finish;
+
+namespace {
+
+    // Long enough for the MQTT thread to get through whatever it was handed
+    constexpr auto settleTime = std::chrono::milliseconds(500);
+
+    // The first few of each kind of frame get a pass, since that's when everything is finding its feet
+    constexpr std::size_t warmupFrames = 64;
+
+    struct Phase {
+        uint64_t allocations;
+        uint64_t publishes;
+    };
+
+    /**
+     * Feeds frames through (cycling through the ones given) and counts what happened
+     */
+    Phase run(TestDaemon &daemon, const TestBroker &broker, const std::vector<std::vector<uint8_t>> &cycle,
+              std::size_t frames, const char *what) {
+
+        for (std::size_t i = 0; i < warmupFrames; i++) {
+            daemon.feed(cycle[i % cycle.size()]);
+        }
+        std::this_thread::sleep_for(settleTime);
+
+        auto publishesBefore = broker.getStats().publishesIn;
+        auto before = creatures::allocations::total();
+        auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < frames; i++) {
+            daemon.feed(cycle[i % cycle.size()]);
+        }
+
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        std::this_thread::sleep_for(settleTime);
+        Phase phase{creatures::allocations::total() - before, broker.getStats().publishesIn - publishesBefore};
+
+        auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        fmt::print("{} {} frames in {}us ({:.0f} frames/s): {} allocations, {} publishes\n", frames, what, elapsedUs,
+                   elapsedUs > 0 ? frames * 1e6 / elapsedUs : 0.0, phase.allocations, phase.publishes);
+        return phase;
+    }
+}
+
+
+int main(int argc, char **argv) {
+
+    std::size_t frames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    std::size_t changingFrames = std::max<std::size_t>(frames / 100, 1);
+
+    TestDaemon::initLogging();
+
+    TestBroker broker;
+    if (!broker.start()) {
+        return EXIT_FAILURE;
+    }
+
+    TestDaemon daemon(broker.getPort());
+    if (!daemon.start()) {
+        fmt::print(stderr, "FAILED: never connected to the broker\n");
+        return EXIT_FAILURE;
+    }
+
+    // The first one publishes everything, then the same thing over and over
+    auto unchanged = TestDaemon::statusFrame({0x01, 0x00, 0x01, 0x00});
+    daemon.feed(unchanged);
+    broker.waitForPublishes(4 * creatures::windowFieldCount, std::chrono::seconds(5));
+
+    auto steady = run(daemon, broker, {unchanged}, frames, "unchanged");
+    check(steady.publishes == 0, "frames that didn't change anything were published");
+    check(steady.allocations == 0, "handling frames that didn't change anything went to the heap");
+
+    // Every one of these changes something on every window. The rain bits are left alone, so
+    // none of it sets off a rule and sends a command.
+    std::vector<std::vector<uint8_t>> changing = {
+            TestDaemon::statusFrame({0x00, 0x01, 0x00, 0x01}),
+            TestDaemon::statusFrame({0x03, 0x04, 0x08, 0x00}),
+            TestDaemon::statusFrame({0x0C, 0x00, 0x03, 0x0F}),
+            unchanged
+    };
+    auto changes = run(daemon, broker, changing, changingFrames, "changing");
+    check(changes.publishes > 0, "frames that changed things weren't published");
+    check(changes.allocations == 0, "publishing and recording frames that changed things went to the heap");
+
+    daemon.stop();
+    broker.stop();
+
+    auto expected = 1 + 2 * warmupFrames + frames + changingFrames;
+    check(daemon.getFrames() == expected,
+          fmt::format("the framer only found {} of {} frames", daemon.getFrames(), expected));
+
+    return finish();
+}
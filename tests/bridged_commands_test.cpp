@@ -0,0 +1,96 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+/*
+ * Two brokers that bridge their command topics to each other, so every command shows up on
+ * both. It should only run once. Someone sending the same command twice on one broker meant
+ * it twice, though, so that runs twice.
+ *
+ * Nothing drains the bus here, so "accepted" is the only result a command gets. That's one
+ * result per time a command ran.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "processor/processor.h"
+#include "test_broker.h"
+#include "test_check.h"
+#include "test_daemon.h"
+
+using creatures::TestBroker;
+using creatures::TestDaemon;
+using creatures::testing::check;
+using creatures::testing::finish;
+
+namespace {
+
+    // Long enough for a command that's going to be accepted to have been
+    constexpr auto settleTime = std::chrono::milliseconds(250);
+
+    uint64_t publishesTo(const TestBroker &broker, const std::string &topic) {
+        auto topics = broker.getTopicStats();
+        auto found = topics.find(topic);
+        return found == topics.end() ? 0 : found->second.publishes;
+    }
+
+    void bridge(TestBroker &first, TestBroker &second, const std::string &topic, const std::string &payload) {
+        first.publish(topic, payload);
+        second.publish(topic, payload);
+    }
+}
+
+int main() {
+
+    TestDaemon::initLogging();
+
+    TestBroker first;
+    TestBroker second;
+    if (!first.start() || !second.start()) {
+        return EXIT_FAILURE;
+    }
+
+    TestDaemon daemon(std::vector<uint16_t>{first.getPort(), second.getPort()});
+    if (!daemon.start()) {
+        fmt::print(stderr, "FAILED: never connected to both brokers\n");
+        return EXIT_FAILURE;
+    }
+    std::this_thread::sleep_for(settleTime);
+
+    // Once on each broker is one command
+    auto topic = window1->createPrefix() + "command";
+    auto resultTopic = topic + "/result";
+    bridge(first, second, topic, R"({"command": "open", "id": "bridged"})");
+    std::this_thread::sleep_for(settleTime);
+    auto results = publishesTo(first, resultTopic) + publishesTo(second, resultTopic);
+    check(results == 1, fmt::format("a bridged command ran {} times, not once", results));
+
+    // The same with a group, which comes in on a different path
+    auto groupTopic = "andersen-mqtt/groups/all/command";
+    auto groupResultTopic = std::string(groupTopic) + "/result";
+    bridge(first, second, groupTopic, R"({"command": "close", "id": "bridged-group"})");
+    std::this_thread::sleep_for(settleTime);
+    results = publishesTo(first, groupResultTopic) + publishesTo(second, groupResultTopic);
+    check(results == 1, fmt::format("a bridged group command ran {} times, not once", results));
+
+    // Twice on the same broker is twice
+    first.resetStats();
+    second.resetStats();
+    auto repeatTopic = window2->createPrefix() + "command";
+    first.publish(repeatTopic, R"({"command": "open", "id": "again"})");
+    first.publish(repeatTopic, R"({"command": "open", "id": "again"})");
+    std::this_thread::sleep_for(settleTime);
+    results = publishesTo(first, repeatTopic + "/result");
+    check(results == 2, fmt::format("a command sent twice on one broker ran {} times, not twice", results));
+
+    daemon.stop();
+    first.stop();
+    second.stop();
+
+    return finish();
+}
@@ -0,0 +1,120 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+/*
+ * How long things take to get across the broker, both ways:
+ *
+ *  - publish: a STATUS frame that changes a window, until the broker has the publish
+ *  - command: a command published to a window's topic, until its frame is queued for the bus
+ *
+ * Both go through the same code the daemon runs, against a broker of our own on localhost,
+ * so this is our side of the latency and none of the network's.
+ *
+ * Usage: broker_benchmark [rounds]
+ */
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include "probe/latency_stats.h"
+#include "processor/processor.h"
+#include "test_broker.h"
+#include "test_daemon.h"
+
+using creatures::LatencyStats;
+using creatures::TestBroker;
+using creatures::TestDaemon;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    constexpr auto roundTimeout = std::chrono::seconds(1);
+
+    std::chrono::microseconds since(Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+    }
+
+    void report(const std::string &name, const LatencyStats &stats, std::size_t rounds) {
+        fmt::print("{:<8} {} of {} rounds, p50 {}us  p99 {}us  max {}us  mean {}us\n", name, stats.count(), rounds,
+                   stats.percentile(50).count(), stats.percentile(99).count(), stats.max().count(),
+                   stats.mean().count());
+    }
+
+    // Waits for the next command frame to be queued for the bus
+    bool commandQueued(Clock::time_point deadline) {
+        std::vector<uint8_t> frame;
+        while (Clock::now() < deadline) {
+            if (transmitScheduler->tryDequeue(frame, creatures::TrafficClass::Command)) {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        return false;
+    }
+}
+
+int main(int argc, char **argv) {
+
+    std::size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+
+    TestDaemon::initLogging();
+
+    TestBroker broker;
+    if (!broker.start()) {
+        return EXIT_FAILURE;
+    }
+
+    TestDaemon daemon(broker.getPort());
+    if (!daemon.start()) {
+        fmt::print(stderr, "never connected to the broker\n");
+        return EXIT_FAILURE;
+    }
+
+    // The first frame publishes everything, so get it out of the way
+    daemon.feed(TestDaemon::statusFrame({0x00, 0x00, 0x00, 0x00}));
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+    // Open and close window 1 over and over. Every frame is one publish.
+    LatencyStats publishes(rounds);
+    auto open = TestDaemon::statusFrame({0x01, 0x00, 0x00, 0x00});
+    auto closed = TestDaemon::statusFrame({0x00, 0x00, 0x00, 0x00});
+    for (std::size_t i = 0; i < rounds; i++) {
+        auto expected = broker.getStats().publishesIn + 1;
+        auto start = Clock::now();
+        daemon.feed(i % 2 == 0 ? open : closed);
+        if (broker.waitForPublishes(expected, roundTimeout)) {
+            publishes.record(since(start));
+        }
+    }
+    report("publish", publishes, rounds);
+
+    // The command topics are subscribed to once we're connected, but that might not have finished yet
+    auto commandTopic = window1->createPrefix() + "command";
+    auto warmupDeadline = Clock::now() + std::chrono::seconds(5);
+    bool subscribed = false;
+    while (!subscribed && Clock::now() < warmupDeadline) {
+        broker.publish(commandTopic, "stop");
+        subscribed = commandQueued(Clock::now() + std::chrono::milliseconds(100));
+    }
+
+    LatencyStats commands(rounds);
+    for (std::size_t i = 0; subscribed && i < rounds; i++) {
+        auto start = Clock::now();
+        broker.publish(commandTopic, "stop");
+        if (commandQueued(start + roundTimeout)) {
+            commands.record(since(start));
+        }
+    }
+    report("command", commands, rounds);
+
+    daemon.stop();
+    broker.stop();
+
+    // This is a benchmark, but if nothing made it through at all, something's broken
+    return publishes.count() > 0 && commands.count() > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,159 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+/*
+ * Two brokers, and the first one is a black hole: it's there, but it never finishes a TCP
+ * connect. The first broker's connection has the io thread that the command tracker and the
+ * gateway watchdog run on, just like in main(), so if connecting to it ties that thread up,
+ * commands that come in on the other broker never get anywhere.
+ *
+ * The other broker should get its publishes, and answers to its commands, like nothing was
+ * wrong. Stopping shouldn't wait on the black hole either.
+ */
+
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include "processor/processor.h"
+#include "test_broker.h"
+#include "test_check.h"
+#include "test_daemon.h"
+
+using creatures::TestBroker;
+using creatures::TestDaemon;
+using creatures::testing::check;
+using creatures::testing::finish;
+using creatures::testing::waitFor;
+
+namespace {
+
+    // Plenty on localhost, and nowhere near a TCP connect timeout
+    constexpr auto onTime = std::chrono::milliseconds(1000);
+
+    /**
+     * Listens on localhost, but never accepts. Once the backlog is full the kernel drops every
+     * SYN that comes in, so connecting just hangs until TCP gives up (minutes, not seconds).
+     */
+    class BlackHole {
+
+    public:
+        ~BlackHole() {
+            for (int fd: fillers) {
+                close(fd);
+            }
+            if (listenFd >= 0) {
+                close(listenFd);
+            }
+        }
+
+        bool start() {
+            listenFd = socket(AF_INET, SOCK_STREAM, 0);
+
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+            if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+                listen(listenFd, 0) < 0) {
+                return false;
+            }
+            socklen_t length = sizeof(address);
+            getsockname(listenFd, reinterpret_cast<sockaddr *>(&address), &length);
+            port = ntohs(address.sin_port);
+
+            // Fill up the backlog until a connect doesn't finish on its own
+            for (int i = 0; i < 16; i++) {
+                int fd = socket(AF_INET, SOCK_STREAM, 0);
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+                fillers.push_back(fd);
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+                int error = 0;
+                socklen_t errorLength = sizeof(error);
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength);
+                sockaddr_in peer{};
+                socklen_t peerLength = sizeof(peer);
+                if (error == 0 && getpeername(fd, reinterpret_cast<sockaddr *>(&peer), &peerLength) < 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        [[nodiscard]] uint16_t getPort() const { return port; }
+
+    private:
+        int listenFd = -1;
+        uint16_t port = 0;
+        std::vector<int> fillers;
+    };
+
+    uint64_t publishesTo(const TestBroker &broker, const std::string &topic) {
+        auto topics = broker.getTopicStats();
+        auto found = topics.find(topic);
+        return found == topics.end() ? 0 : found->second.publishes;
+    }
+}
+
+int main() {
+
+    TestDaemon::initLogging();
+
+    BlackHole hole;
+    if (!hole.start()) {
+        fmt::print(stderr, "FAILED: couldn't make a broker that never answers\n");
+        return EXIT_FAILURE;
+    }
+
+    TestBroker broker;
+    if (!broker.start()) {
+        return EXIT_FAILURE;
+    }
+
+    TestDaemon daemon(std::vector<uint16_t>{hole.getPort(), broker.getPort()});
+    daemon.start(onTime);
+    check(daemon.getConnected() == 1,
+          fmt::format("{} connections are up, not just the one to the live broker", daemon.getConnected()));
+
+    // Let the availability from connecting go by
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    broker.resetStats();
+
+    // The first STATUS publishes every field of every window
+    auto start = std::chrono::steady_clock::now();
+    daemon.feed(TestDaemon::statusFrame({0x00, 0x00, 0x00, 0x00}));
+    check(broker.waitForPublishes(4 * creatures::windowFieldCount, onTime),
+          fmt::format("the live broker only got {} of {} publishes on time", broker.getStats().publishesIn,
+                      4 * creatures::windowFieldCount));
+
+    // A command comes in on the live broker, but the tracker lives on the black hole's io thread
+    auto commandTopic = window1->createPrefix() + "command";
+    auto resultTopic = commandTopic + "/result";
+    broker.publish(commandTopic, R"({"command": "open", "id": "outage"})");
+    check(waitFor([&] { return publishesTo(broker, resultTopic) > 0; }, onTime),
+          "a command on the live broker was never accepted");
+
+    auto stopStart = std::chrono::steady_clock::now();
+    daemon.stop();
+    auto stopTook = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - stopStart);
+    check(stopTook < std::chrono::seconds(10), fmt::format("stopping took {}ms", stopTook.count()));
+
+    fmt::print("first publishes and a command answered in {}ms, stopped in {}ms\n",
+               std::chrono::duration_cast<std::chrono::milliseconds>(stopStart - start).count(), stopTook.count());
+
+    broker.stop();
+
+    return finish();
+}
@@ -0,0 +1,132 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+/*
+ * The controller's ACKs and BUSYs don't say what they're for, just that they're for the oldest
+ * frame it hasn't answered yet. The scheduler sends a Safety frame ahead of a Command frame
+ * that was queued first, so the answers have to be handed out in the order frames were sent,
+ * not the order the commands were tracked in.
+ *
+ * This plays the writer's part by hand: take frames out of the scheduler, tell the tracker
+ * what went, and answer them.
+ */
+
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <fmt/format.h>
+
+#include "bus/transmit_scheduler.h"
+#include "mqtt/command_tracker.h"
+#include "test_check.h"
+#include "test_daemon.h"
+#include "window/command_compiler.h"
+#include "window/window.h"
+
+using creatures::CommandTracker;
+using creatures::FrameInfo;
+using creatures::TestDaemon;
+using creatures::TrafficClass;
+using creatures::TransmitScheduler;
+using creatures::testing::check;
+using creatures::testing::finish;
+
+namespace {
+
+    // Every stage each command has been through, by id
+    std::map<std::string, std::vector<std::string>> stages;
+
+    CommandTracker::ResultPublisher recorder(const std::string &id) {
+        return [id](const std::string &payload) {
+            auto stage = payload.find(R"("stage":")");
+            if (stage != std::string::npos) {
+                stage += 9;
+                stages[id].push_back(payload.substr(stage, payload.find('"', stage) - stage));
+            }
+        };
+    }
+
+    std::string lastStage(const std::string &id) {
+        return stages[id].empty() ? "nothing" : stages[id].back();
+    }
+
+    CommandTracker::Tag queue(CommandTracker &tracker, TransmitScheduler &scheduler, const std::string &id,
+                              uint8_t window, uint8_t command, TrafficClass trafficClass) {
+        auto tag = tracker.newTag();
+        tracker.track(tag, {command == CMD_OPEN ? "open" : "close", id, std::chrono::milliseconds(60000)},
+                      {{window, command == CMD_OPEN}}, 1, recorder(id));
+        scheduler.enqueue(creatures::CommandCompiler::createFrame(DST_PANEL_1, window, command), trafficClass, tag);
+        return tag;
+    }
+
+    // Sends everything waiting, in the order the scheduler hands it out
+    std::vector<CommandTracker::Tag> sendAll(CommandTracker &tracker, TransmitScheduler &scheduler) {
+        std::vector<CommandTracker::Tag> sent;
+        std::vector<uint8_t> frame;
+        FrameInfo info;
+        while (scheduler.tryDequeue(frame, TrafficClass::BackgroundPoll, &info)) {
+            tracker.onSent(info.tag);
+            sent.push_back(info.tag);
+        }
+        return sent;
+    }
+}
+
+int main() {
+
+    TestDaemon::initLogging();
+
+    boost::asio::io_context ioc;
+    TransmitScheduler scheduler;
+    CommandTracker tracker(ioc);
+
+    // Someone opens window 1, then the rain closes window 2. The rain goes first.
+    auto openTag = queue(tracker, scheduler, "open", 1, CMD_OPEN, TrafficClass::Command);
+    auto rainTag = queue(tracker, scheduler, "rain", 2, CMD_CLOSE, TrafficClass::Safety);
+    ioc.poll();
+
+    auto sent = sendAll(tracker, scheduler);
+    check(sent == std::vector<CommandTracker::Tag>{rainTag, openTag}, "the Safety frame didn't go out first");
+
+    // So the ACK is the rain's, and the BUSY is the open's
+    tracker.onAck();
+    tracker.onBusy();
+    ioc.poll();
+    check(lastStage("rain") == "acked", fmt::format("the first answer made the rain close {}, not acked", lastStage("rain")));
+    check(lastStage("open") == "busy", fmt::format("the second answer made the open {}, not busy", lastStage("open")));
+
+    // An answer that gets to the tracker before the command does still counts
+    auto lateTag = tracker.newTag();
+    scheduler.enqueue(creatures::CommandCompiler::createFrame(DST_PANEL_1, 3, CMD_CLOSE), TrafficClass::Command, lateTag);
+    sendAll(tracker, scheduler);
+    tracker.onAck();
+    ioc.poll();
+    tracker.track(lateTag, {"close", "late", std::chrono::milliseconds(60000)}, {{3, false}}, 1, recorder("late"));
+    ioc.poll();
+    check(lastStage("late") == "acked", fmt::format("an ACK ahead of its command left it {}, not acked", lastStage("late")));
+
+    // And nothing left over to throw the next one off
+    auto nextTag = queue(tracker, scheduler, "next", 4, CMD_OPEN, TrafficClass::Command);
+    sendAll(tracker, scheduler);
+    tracker.onAck();
+    ioc.poll();
+    check(nextTag != 0 && lastStage("next") == "acked",
+          fmt::format("the command after that was {}, not acked", lastStage("next")));
+
+    // The writer stops with a command in hand. It goes back in ahead of the one queued after it,
+    // and nothing's been sent, so there's nothing to answer yet.
+    auto heldTag = queue(tracker, scheduler, "held", 1, CMD_CLOSE, TrafficClass::Command);
+    auto afterTag = queue(tracker, scheduler, "after", 2, CMD_CLOSE, TrafficClass::Command);
+    std::vector<uint8_t> held;
+    FrameInfo heldInfo;
+    scheduler.tryDequeue(held, TrafficClass::BackgroundPoll, &heldInfo);
+    scheduler.putBack(std::move(held), heldInfo);
+    sent = sendAll(tracker, scheduler);
+    check(sent == std::vector<CommandTracker::Tag>{heldTag, afterTag}, "a frame that was put back didn't go out first");
+
+    return finish();
+}
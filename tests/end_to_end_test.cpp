@@ -0,0 +1,105 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+/*
+ * STATUS frames in one end, MQTT publishes out the other, through the framer, process_message(),
+ * and a real connection to a broker of our own. A STATUS frame should publish exactly what
+ * changed in it, and nothing at all if nothing did.
+ */
+
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include "processor/processor.h"
+#include "test_broker.h"
+#include "test_check.h"
+#include "test_daemon.h"
+
+using creatures::TestBroker;
+using creatures::TestDaemon;
+using creatures::testing::check;
+using creatures::testing::finish;
+
+namespace {
+
+    // Long enough for anything that wasn't supposed to be published to show up anyway
+    constexpr auto settleTime = std::chrono::milliseconds(250);
+
+    void settle(TestBroker &broker, uint64_t expected) {
+        broker.waitForPublishes(expected, std::chrono::seconds(5));
+        std::this_thread::sleep_for(settleTime);
+    }
+
+    // The window fields the broker has seen since its counts were last reset
+    std::map<std::string, creatures::TopicStats> windowFields(const TestBroker &broker) {
+        std::map<std::string, creatures::TopicStats> found;
+        for (const auto &[topic, stats]: broker.getTopicStats()) {
+            if (topic.starts_with("andersen-mqtt/windows/") && !topic.ends_with("/availability")) {
+                found[topic] = stats;
+            }
+        }
+        return found;
+    }
+}
+
+int main() {
+
+    TestDaemon::initLogging();
+
+    TestBroker broker;
+    if (!broker.start()) {
+        return EXIT_FAILURE;
+    }
+
+    TestDaemon daemon(broker.getPort());
+    if (!daemon.start()) {
+        fmt::print(stderr, "FAILED: never connected to the broker\n");
+        return EXIT_FAILURE;
+    }
+
+    // Connecting puts availability out for the gateway and every window, which isn't what we're here for
+    settle(broker, 5);
+    broker.resetStats();
+
+    // The first one publishes every field of every window, once
+    daemon.feed(TestDaemon::statusFrame({0x00, 0x00, 0x00, 0x00}));
+    settle(broker, 4 * creatures::windowFieldCount);
+    auto fields = windowFields(broker);
+    check(fields.size() == 4 * creatures::windowFieldCount,
+          fmt::format("the first STATUS published {} window fields, not {}", fields.size(),
+                      4 * creatures::windowFieldCount));
+    for (const auto &[topic, stats]: fields) {
+        check(stats.publishes == 1, fmt::format("{} was published {} times", topic, stats.publishes));
+    }
+
+    // Window 2 opens. That's one field on one window, and nothing else.
+    broker.resetStats();
+    daemon.feed(TestDaemon::statusFrame({0x00, 0x01, 0x00, 0x00}));
+    settle(broker, 1);
+    auto openTopic = window2->createPrefix() + "open";
+    fields = windowFields(broker);
+    check(broker.getStats().publishesIn == 1,
+          fmt::format("window 2 opening made {} publishes, not 1", broker.getStats().publishesIn));
+    check(fields.size() == 1 && fields.contains(openTopic),
+          fmt::format("window 2 opening didn't publish just {}", openTopic));
+    check(broker.retained(openTopic) == "yes", fmt::format("{} isn't retained as yes", openTopic));
+
+    // Nothing changed, so nothing goes out
+    broker.resetStats();
+    daemon.feed(TestDaemon::statusFrame({0x00, 0x01, 0x00, 0x00}));
+    settle(broker, 0);
+    check(broker.getStats().publishesIn == 0,
+          fmt::format("a STATUS that didn't change anything made {} publishes", broker.getStats().publishesIn));
+
+    check(daemon.getFrames() == 3, fmt::format("the framer only found {} of 3 frames", daemon.getFrames()));
+
+    daemon.stop();
+    broker.stop();
+
+    return finish();
+}
@@ -0,0 +1,335 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+/*
+ * Two copies of the daemon, one broker, one gateway, and only one of them talking to it at a
+ * time. This runs the real andersen_mqtt binary (its path is the first argument) so it's the
+ * whole thing: the leader lock, the wills, and what main() does with the gateway connection.
+ *
+ *  - takeover: the leader dies, the standby gets the lock and the gateway
+ *  - fence: a leader that loses the broker lets go of the gateway before a standby could want it
+ *  - retry: a leader that can't reach the gateway lets go of the lock, and tries again later
+ *  - abandoned: the leader goes, nobody can take over, and a standby says the gateway's gone
+ *
+ * The gateway here only takes connections and keeps track of them. Nobody answers the polls,
+ * which is fine, that doesn't decide who's the leader.
+ */
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include "mqtt/leader_election.h"
+#include "test_broker.h"
+#include "test_check.h"
+
+using creatures::LeaderElection;
+using creatures::TestBroker;
+using creatures::testing::check;
+using creatures::testing::finish;
+using creatures::testing::waitFor;
+
+namespace {
+
+    // A crashed leader's will goes off right away here (the broker sees the socket close), so
+    // this is mostly the settle time and connecting
+    constexpr auto takeoverTimeout = std::chrono::seconds(15);
+
+    // Keep alive (5s) plus how long a leader waits on a ping (2s). Anything past this and a
+    // standby could already have the lock.
+    constexpr auto fenceTimeout = std::chrono::milliseconds(7000);
+
+
+    /**
+     * Takes connections on localhost and notices when they close
+     */
+    class FakeGateway {
+
+    public:
+        ~FakeGateway() { stop(); }
+
+        bool start(uint16_t wantedPort = 0) {
+            listenFd = socket(AF_INET, SOCK_STREAM, 0);
+            int reuse = 1;
+            setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(wantedPort);
+            inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+            if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+                listen(listenFd, 4) < 0) {
+                fmt::print(stderr, "the gateway couldn't listen on {}\n", wantedPort);
+                close(listenFd);
+                listenFd = -1;
+                return false;
+            }
+
+            socklen_t length = sizeof(address);
+            getsockname(listenFd, reinterpret_cast<sockaddr *>(&address), &length);
+            port = ntohs(address.sin_port);
+
+            acceptor = std::jthread([this] {
+                int fd;
+                while ((fd = accept(listenFd, nullptr, nullptr)) >= 0) {
+                    accepted++;
+                    std::lock_guard<std::mutex> lock(connectionMutex);
+                    connections.push_back(fd);
+                    readers.emplace_back([this, fd] {
+                        char buffer[256];
+                        while (recv(fd, buffer, sizeof(buffer), 0) > 0) {}
+                        closed++;
+                    });
+                }
+            });
+            return true;
+        }
+
+        void stop() {
+            if (listenFd < 0) {
+                return;
+            }
+            shutdown(listenFd, SHUT_RDWR);
+            acceptor = {};
+            close(listenFd);
+            listenFd = -1;
+
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            for (int fd: connections) {
+                shutdown(fd, SHUT_RDWR);
+            }
+            readers.clear();
+            for (int fd: connections) {
+                close(fd);
+            }
+            connections.clear();
+        }
+
+        [[nodiscard]] uint16_t getPort() const { return port; }
+
+        std::atomic<int> accepted = 0;
+        std::atomic<int> closed = 0;
+
+    private:
+        int listenFd = -1;
+        uint16_t port = 0;
+        std::jthread acceptor;
+        std::mutex connectionMutex;
+        std::vector<int> connections;
+        std::vector<std::jthread> readers;
+    };
+
+
+    /**
+     * One copy of the daemon
+     */
+    class Instance {
+
+    public:
+        Instance(const std::string &binary, const std::string &name, uint16_t brokerPort, uint16_t gatewayPort) {
+
+            // All built before the fork, since the broker's thread could be holding the heap's lock
+            const char *logLevel = std::getenv("ANDERSEN_LOG_LEVEL");
+            std::vector<std::string> settings = {
+                    "ANDERSEN_MQTT_HOST=127.0.0.1",
+                    fmt::format("ANDERSEN_MQTT_PORT={}", brokerPort),
+                    "ANDERSEN_GATEWAY_HOST=127.0.0.1",
+                    fmt::format("ANDERSEN_GATEWAY_PORT={}", gatewayPort),
+                    "ANDERSEN_FAILOVER=yes",
+                    fmt::format("ANDERSEN_INSTANCE={}", name),
+                    fmt::format("ANDERSEN_LOG_LEVEL={}", logLevel ? logLevel : "warning")
+            };
+            std::vector<char *> environment;
+            for (auto &setting: settings) {
+                environment.push_back(setting.data());
+            }
+            environment.push_back(nullptr);
+            std::vector<char *> arguments = {const_cast<char *>(binary.c_str()), nullptr};
+
+            pid = fork();
+            if (pid == 0) {
+                execve(binary.c_str(), arguments.data(), environment.data());
+                _exit(127);
+            }
+        }
+
+        ~Instance() {
+            if (running()) {
+                kill(pid, SIGKILL);
+                waitpid(pid, nullptr, 0);
+            }
+        }
+
+        [[nodiscard]] bool running() {
+            if (pid <= 0 || reaped) {
+                return false;
+            }
+            if (waitpid(pid, &status, WNOHANG) == pid) {
+                reaped = true;
+            }
+            return !reaped;
+        }
+
+        void signal(int number) {
+            if (running()) {
+                kill(pid, number);
+            }
+        }
+
+        bool waitForExit(std::chrono::milliseconds timeout) {
+            return waitFor([this] { return !running(); }, timeout);
+        }
+
+    private:
+        pid_t pid = -1;
+        int status = 0;
+        bool reaped = false;
+    };
+
+
+    std::string lockHolder(const TestBroker &broker) {
+        return broker.retained(LeaderElection::lockTopic).value_or("");
+    }
+
+    std::string availability(const TestBroker &broker) {
+        return broker.retained("andersen-mqtt/availability").value_or("");
+    }
+
+    bool isOnline(const TestBroker &broker, const std::string &instance) {
+        return broker.retained(LeaderElection::instanceTopicPrefix + instance).value_or("") == "online";
+    }
+
+
+    void takeover(const std::string &binary) {
+        TestBroker broker;
+        FakeGateway gateway;
+        if (!broker.start() || !gateway.start()) {
+            check(false, "takeover: couldn't start the broker and gateway");
+            return;
+        }
+
+        Instance a(binary, "a", broker.getPort(), gateway.getPort());
+        check(waitFor([&] { return lockHolder(broker) == "a" && gateway.accepted == 1; }, takeoverTimeout),
+              "takeover: a never became the leader");
+
+        Instance b(binary, "b", broker.getPort(), gateway.getPort());
+        check(waitFor([&] { return isOnline(broker, "b"); }, takeoverTimeout), "takeover: b never showed up");
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        check(lockHolder(broker) == "a" && gateway.accepted == 1, "takeover: b went for the gateway while a had it");
+
+        a.signal(SIGKILL);
+        check(waitFor([&] { return lockHolder(broker) == "b" && gateway.accepted == 2; }, takeoverTimeout),
+              fmt::format("takeover: b didn't take over (lock is '{}', {} gateway connections)",
+                          lockHolder(broker), gateway.accepted.load()));
+
+        b.signal(SIGTERM);
+        check(b.waitForExit(std::chrono::seconds(10)), "takeover: b didn't stop");
+    }
+
+    void fence(const std::string &binary) {
+        TestBroker broker;
+        FakeGateway gateway;
+        if (!broker.start() || !gateway.start()) {
+            check(false, "fence: couldn't start the broker and gateway");
+            return;
+        }
+
+        Instance a(binary, "a", broker.getPort(), gateway.getPort());
+        check(waitFor([&] { return lockHolder(broker) == "a" && gateway.accepted == 1; }, takeoverTimeout),
+              "fence: a never became the leader");
+
+        broker.stop();
+        check(waitFor([&] { return gateway.closed == 1; }, fenceTimeout),
+              "fence: a kept the gateway after losing the broker");
+        check(a.waitForExit(std::chrono::seconds(10)), "fence: a didn't stop after losing the lock");
+    }
+
+    void retry(const std::string &binary) {
+        TestBroker broker;
+        FakeGateway gateway;
+        if (!broker.start() || !gateway.start()) {
+            check(false, "retry: couldn't start the broker and gateway");
+            return;
+        }
+
+        // Somewhere nobody's listening, for now
+        auto gatewayPort = gateway.getPort();
+        gateway.stop();
+
+        Instance a(binary, "a", broker.getPort(), gatewayPort);
+        check(waitFor([&] {
+            auto topics = broker.getTopicStats();
+            auto lock = topics.find(LeaderElection::lockTopic);
+            return lock != topics.end() && lock->second.publishes >= 2 && lock->second.lastPayload.empty();
+        }, takeoverTimeout), "retry: a didn't let go of the lock when it couldn't reach the gateway");
+        check(a.running(), "retry: a gave up instead of going back to standby");
+
+        if (!gateway.start(gatewayPort)) {
+            check(false, "retry: couldn't start the gateway again");
+            return;
+        }
+        check(waitFor([&] { return lockHolder(broker) == "a" && gateway.accepted == 1; }, takeoverTimeout),
+              "retry: a never came back for the gateway");
+
+        a.signal(SIGTERM);
+        check(a.waitForExit(std::chrono::seconds(10)), "retry: a didn't stop");
+    }
+
+    void abandoned(const std::string &binary) {
+        TestBroker broker;
+        FakeGateway gateway;
+        if (!broker.start() || !gateway.start()) {
+            check(false, "abandoned: couldn't start the broker and gateway");
+            return;
+        }
+
+        Instance a(binary, "a", broker.getPort(), gateway.getPort());
+        check(waitFor([&] { return lockHolder(broker) == "a" && gateway.accepted == 1; }, takeoverTimeout),
+              "abandoned: a never became the leader");
+        Instance b(binary, "b", broker.getPort(), gateway.getPort());
+        check(waitFor([&] { return isOnline(broker, "b"); }, takeoverTimeout), "abandoned: b never showed up");
+
+        // Our gateway never answers a poll, so pretend it did
+        broker.publish("andersen-mqtt/availability", "online", true);
+
+        // The gateway goes away. a leaves it to b, which can't get to it either.
+        gateway.stop();
+        check(a.waitForExit(std::chrono::seconds(10)), "abandoned: a didn't stop after losing the gateway");
+        check(waitFor([&] { return availability(broker) == "offline"; }, takeoverTimeout),
+              fmt::format("abandoned: nobody has the gateway, but availability is still '{}'", availability(broker)));
+        check(b.running(), "abandoned: b gave up instead of staying on standby");
+
+        b.signal(SIGTERM);
+        check(b.waitForExit(std::chrono::seconds(10)), "abandoned: b didn't stop");
+    }
+}
+
+int main(int argc, char **argv) {
+
+    if (argc < 2) {
+        fmt::print(stderr, "usage: failover_test <path to andersen_mqtt>\n");
+        return EXIT_FAILURE;
+    }
+    std::string binary = argv[1];
+
+    takeover(binary);
+    fence(binary);
+    retry(binary);
+    abandoned(binary);
+
+    return finish();
+}
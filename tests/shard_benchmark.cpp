@@ -0,0 +1,146 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+/*
+ * How publishing keeps up as the windows are split across more connections (see ShardRing).
+ *
+ * For each shard count, every window opens (or closes) at once, each connection publishes its
+ * share, and we wait for all of them to reach the broker before flipping them all again. That's
+ * one publish per window per round, so the rate is windows * rounds over how long it took.
+ *
+ * The broker is our own, on localhost, with one thread. Past a few shards that's what runs out
+ * first, so this shows our side scaling and not what a real broker can take.
+ *
+ * Usage: shard_benchmark [windows] [rounds] [max shards]
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "mqtt/mqtt.h"
+#include "test_broker.h"
+#include "test_daemon.h"
+#include "window/window.h"
+
+using creatures::MQTTClient;
+using creatures::MQTTOptions;
+using creatures::TestBroker;
+using creatures::TestDaemon;
+using creatures::Window;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    constexpr auto connectTimeout = std::chrono::seconds(5);
+    constexpr auto roundTimeout = std::chrono::seconds(10);
+
+    /**
+     * Runs every round with this many shards
+     *
+     * @return publishes per second, or 0 if something didn't make it
+     */
+    double run(std::size_t shards, const std::vector<std::shared_ptr<Window>> &windows, std::size_t rounds) {
+
+        TestBroker broker;
+        if (!broker.start()) {
+            return 0;
+        }
+
+        std::vector<std::unique_ptr<MQTTClient>> clients;
+        MQTTOptions options;
+        options.shards = shards;
+        for (std::size_t shard = 0; shard < shards; shard++) {
+            options.shard = shard;
+            options.name = fmt::format("bench/{}", shard);
+            options.clientId = fmt::format("andersen-mqtt-bench-{}", shard);
+
+            auto client = std::make_unique<MQTTClient>("127.0.0.1", std::to_string(broker.getPort()), options);
+            for (const auto &window: windows) {
+                client->addWindow(window);
+            }
+            client->start();
+            clients.push_back(std::move(client));
+        }
+
+        auto deadline = Clock::now() + connectTimeout;
+        while (std::any_of(clients.begin(), clients.end(), [](const auto &c) { return !c->isConnected(); })) {
+            if (Clock::now() >= deadline) {
+                fmt::print(stderr, "{} shards never all connected\n", shards);
+                MQTTClient::stopAll(clients);
+                return 0;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        // Everything goes out the first time, and availability with it. That's not what we're timing.
+        for (const auto &window: windows) {
+            window->setStatus(0x00);
+        }
+        for (const auto &client: clients) {
+            client->publishWindows(true);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+        bool good = true;
+        auto start = Clock::now();
+        for (std::size_t round = 0; good && round < rounds; round++) {
+            auto expected = broker.getStats().publishesIn + windows.size();
+            for (const auto &window: windows) {
+                window->setStatus(round % 2 == 0 ? 0x01 : 0x00);
+            }
+            for (const auto &client: clients) {
+                client->publishWindows(false);
+            }
+            good = broker.waitForPublishes(expected, roundTimeout);
+        }
+        auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+        MQTTClient::stopAll(clients);
+        broker.stop();
+
+        if (!good) {
+            fmt::print(stderr, "{} shards didn't get a round out in time\n", shards);
+            return 0;
+        }
+        return elapsed > 0 ? windows.size() * rounds / elapsed : 0;
+    }
+}
+
+int main(int argc, char **argv) {
+
+    std::size_t windowCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 512;
+    std::size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+    std::size_t maxShards = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 16;
+
+    TestDaemon::initLogging();
+
+    std::vector<std::shared_ptr<Window>> windows;
+    for (std::size_t i = 0; i < windowCount; i++) {
+        windows.push_back(std::make_shared<Window>(fmt::format("window{}", i + 1), static_cast<uint8_t>(i % 255 + 1)));
+    }
+
+    fmt::print("{} windows, {} rounds\n", windowCount, rounds);
+
+    bool good = true;
+    double single = 0;
+    for (std::size_t shards = 1; shards <= maxShards; shards *= 2) {
+        auto rate = run(shards, windows, rounds);
+        if (shards == 1) {
+            single = rate;
+        }
+        fmt::print("{:>3} shards: {:>10.0f} publishes/s  ({:.2f}x one)\n", shards, rate,
+                   single > 0 ? rate / single : 0.0);
+        good = good && rate > 0;
+    }
+
+    // This is a benchmark, but if a shard count couldn't get its publishes out at all, something's broken
+    return good ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,386 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+#include <string_view>
+
+#include "test_broker.h"
+
+#include "logging/logging.h"
+#include "threading/threading.h"
+#include "tracing/allocations.h"
+
+namespace creatures {
+
+    namespace {
+        // Everything in here logs under the "broker" component
+        constexpr auto &logger = logging::component<"broker">;
+    }
+
+    TestBroker::TestBroker(uint16_t port) : requestedPort(port) {}
+
+    TestBroker::~TestBroker() {
+        stop();
+    }
+
+    bool TestBroker::start() {
+        server = std::make_unique<Server>(
+                boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), requestedPort), ioc);
+
+        server->set_error_handler([](MQTT_NS::error_code ec) {
+            logger().error("stand-in broker error: {}", ec.message());
+        });
+        server->set_accept_handler([this](ConnectionPtr connection) {
+            accept(std::move(connection));
+        });
+
+        // mqtt_cpp only tells us the port's taken by throwing
+        try {
+            server->listen();
+        } catch (const boost::system::system_error &e) {
+            logger().error("the stand-in broker couldn't listen on port {}: {}", requestedPort, e.what());
+            server.reset();
+            return false;
+        }
+
+        port = server->port();
+        logger().info("stand-in broker listening on 127.0.0.1:{}", port);
+
+        // mqtt_cpp's replies throw if the client's already gone, which isn't worth stopping over
+        thread = std::jthread([this] {
+            threading::setup("broker");
+
+            // We're standing in for a broker on another machine, so what we allocate isn't the daemon's
+            allocations::Exempt exempt;
+            while (!ioc.stopped()) {
+                try {
+                    ioc.run();
+                } catch (const boost::system::system_error &e) {
+                    logger().debug("lost a client mid-reply: {}", e.what());
+                }
+            }
+        });
+        return true;
+    }
+
+    void TestBroker::stop() {
+        if (!server) {
+            return;
+        }
+
+        boost::asio::post(ioc, [this] {
+            server->close();
+            for (auto &[connection, session]: sessions) {
+                session.connection->force_disconnect();
+            }
+            ioc.stop();
+        });
+        if (thread.joinable()) {
+            thread.join();
+        }
+
+        sessions.clear();
+        subscriptions.clear();
+        server.reset();
+    }
+
+    void TestBroker::accept(ConnectionPtr connection) {
+        using PacketId = Connection::packet_id_t;
+
+        auto &endpoint = *connection;
+        std::weak_ptr<Connection> weak(connection);
+        Connection *key = connection.get();
+
+        // mqtt_cpp holds on to this until the connection is done with
+        endpoint.start_session(std::move(connection));
+
+        // The daemon counts on its QoS1 publishes getting a PUBACK, so don't make us send them by hand
+        endpoint.set_auto_pub_response(true);
+
+        endpoint.set_close_handler([this, key] {
+            closeSession(key, false);
+        });
+        endpoint.set_error_handler([this, key](MQTT_NS::error_code ec) {
+            logger().debug("a client went away: {}", ec.message());
+            closeSession(key, false);
+        });
+
+        endpoint.set_connect_handler(
+                [this, weak](MQTT_NS::buffer clientId, MQTT_NS::optional<MQTT_NS::buffer>,
+                             MQTT_NS::optional<MQTT_NS::buffer>, MQTT_NS::optional<MQTT_NS::will> will,
+                             bool, std::uint16_t) {
+                    auto connection = weak.lock();
+                    if (!connection) {
+                        return false;
+                    }
+                    logger().debug("{} connected", std::string_view(clientId));
+
+                    Session session{connection, std::nullopt};
+                    if (will) {
+                        session.will = std::move(*will);
+                    }
+                    sessions[connection.get()] = std::move(session);
+
+                    {
+                        std::lock_guard<std::mutex> lock(stateMutex);
+                        stats.connects++;
+                        connections++;
+                    }
+
+                    connection->connack(false, MQTT_NS::connect_return_code::accepted);
+                    return true;
+                });
+
+        endpoint.set_disconnect_handler([this, key] {
+            closeSession(key, true);
+        });
+
+        endpoint.set_puback_handler([](PacketId) {
+            return true;
+        });
+
+        endpoint.set_pingreq_handler([this, weak] {
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                stats.pings++;
+            }
+            if (auto connection = weak.lock()) {
+                connection->pingresp();
+            }
+            return true;
+        });
+
+        endpoint.set_publish_handler(
+                [this](MQTT_NS::optional<PacketId>, MQTT_NS::publish_options pubopts, MQTT_NS::buffer topic,
+                       MQTT_NS::buffer contents) {
+                    route(std::string(topic), std::string(contents), pubopts.get_qos(),
+                          pubopts.get_retain() == MQTT_NS::retain::yes);
+                    return true;
+                });
+
+        endpoint.set_subscribe_handler([this, weak](PacketId packetId, std::vector<MQTT_NS::subscribe_entry> entries) {
+            auto connection = weak.lock();
+            if (!connection) {
+                return false;
+            }
+
+            std::vector<MQTT_NS::suback_return_code> results;
+            std::vector<Subscription> added;
+            for (const auto &entry: entries) {
+                std::string filter(entry.topic_filter);
+                auto qos = entry.subopts.get_qos();
+                logger().debug("subscription to {} (qos {})", filter, static_cast<int>(qos));
+
+                // Subscribing to the same thing again just replaces it
+                std::erase_if(subscriptions, [&](const Subscription &subscription) {
+                    return subscription.connection == connection.get() && subscription.filter == filter;
+                });
+                subscriptions.push_back({connection.get(), filter, qos});
+                added.push_back(subscriptions.back());
+                results.push_back(MQTT_NS::qos_to_suback_return_code(qos));
+            }
+            connection->suback(packetId, std::move(results));
+
+            // Anything retained that they just asked for goes out after the SUBACK
+            std::vector<std::pair<std::string, RetainedMessage>> matching;
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                stats.subscribes += entries.size();
+                for (const auto &subscription: added) {
+                    for (const auto &[topic, message]: retainedMessages) {
+                        if (topicMatches(subscription.filter, topic)) {
+                            matching.emplace_back(topic, RetainedMessage{message.payload, std::min(message.qos, subscription.qos)});
+                            stats.publishesOut++;
+                            stats.bytesOut += message.payload.size();
+                        }
+                    }
+                }
+            }
+            for (const auto &[topic, message]: matching) {
+                connection->publish(topic, message.payload, message.qos | MQTT_NS::retain::yes);
+            }
+            return true;
+        });
+
+        endpoint.set_unsubscribe_handler([this, weak](PacketId packetId, std::vector<MQTT_NS::unsubscribe_entry> entries) {
+            auto connection = weak.lock();
+            if (!connection) {
+                return false;
+            }
+
+            for (const auto &entry: entries) {
+                std::string filter(entry.topic_filter);
+                std::erase_if(subscriptions, [&](const Subscription &subscription) {
+                    return subscription.connection == connection.get() && subscription.filter == filter;
+                });
+            }
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                stats.unsubscribes += entries.size();
+            }
+            connection->unsuback(packetId);
+            return true;
+        });
+    }
+
+    void TestBroker::route(const std::string &topic, const std::string &payload, MQTT_NS::qos qos, bool retain) {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+
+            auto now = std::chrono::steady_clock::now();
+            if (stats.publishesIn++ == 0) {
+                stats.firstPublish = now;
+            }
+            stats.lastPublish = now;
+            stats.bytesIn += payload.size();
+
+            auto &topicStats = topics[topic];
+            if (topicStats.publishes > 0 && topicStats.lastPayload == payload) {
+                topicStats.repeats++;
+            }
+            topicStats.publishes++;
+            topicStats.bytes += payload.size();
+            topicStats.lastPayload = payload;
+
+            // An empty retained message clears it out
+            if (retain) {
+                if (payload.empty()) {
+                    retainedMessages.erase(topic);
+                } else {
+                    retainedMessages[topic] = {payload, qos};
+                }
+            }
+        }
+        published.notify_all();
+
+        for (const auto &subscription: subscriptions) {
+            if (!topicMatches(subscription.filter, topic)) {
+                continue;
+            }
+            auto session = sessions.find(subscription.connection);
+            if (session == sessions.end()) {
+                continue;
+            }
+
+            session->second.connection->publish(topic, payload, MQTT_NS::publish_options(std::min(qos, subscription.qos)));
+
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stats.publishesOut++;
+            stats.bytesOut += payload.size();
+        }
+    }
+
+    void TestBroker::closeSession(Connection *connection, bool clean) {
+
+        // A DISCONNECT is followed by the socket closing, so we usually hear about it twice
+        auto found = sessions.find(connection);
+        if (found == sessions.end()) {
+            return;
+        }
+        auto session = std::move(found->second);
+        sessions.erase(found);
+        std::erase_if(subscriptions, [connection](const Subscription &subscription) {
+            return subscription.connection == connection;
+        });
+
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stats.disconnects++;
+            connections--;
+        }
+        disconnected.notify_all();
+
+        // Dropping off without saying goodbye is what wills are for
+        if (!clean && session.will) {
+            logger().debug("firing a will on {}", std::string_view(session.will->topic()));
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                stats.wills++;
+            }
+            route(std::string(session.will->topic()), std::string(session.will->message()),
+                  session.will->get_qos(), session.will->get_retain() == MQTT_NS::retain::yes);
+        }
+
+        // We're inside one of the connection's own handlers, so let it go once that's done
+        boost::asio::post(ioc, [session = std::move(session)] {});
+    }
+
+    void TestBroker::publish(const std::string &topic, const std::string &payload, bool retain) {
+        boost::asio::post(ioc, [this, topic, payload, retain] {
+            route(topic, payload, MQTT_NS::qos::at_least_once, retain);
+        });
+    }
+
+    std::optional<std::string> TestBroker::retained(const std::string &topic) const {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        auto found = retainedMessages.find(topic);
+        if (found == retainedMessages.end()) {
+            return std::nullopt;
+        }
+        return found->second.payload;
+    }
+
+    BrokerStats TestBroker::getStats() const {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        return stats;
+    }
+
+    std::map<std::string, TopicStats> TestBroker::getTopicStats() const {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        return topics;
+    }
+
+    std::size_t TestBroker::getConnections() const {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        return connections;
+    }
+
+    void TestBroker::resetStats() {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stats = BrokerStats{};
+        topics.clear();
+    }
+
+    bool TestBroker::waitForPublishes(uint64_t count, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        return published.wait_for(lock, timeout, [this, count] { return stats.publishesIn >= count; });
+    }
+
+    bool TestBroker::waitForDisconnects(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        return disconnected.wait_for(lock, timeout, [this] { return connections == 0; });
+    }
+
+    bool TestBroker::topicMatches(const std::string &filter, const std::string &topic) {
+
+        // Wildcards at the start don't match the broker's own $ topics
+        if (!topic.empty() && topic[0] == '$' && !filter.empty() && (filter[0] == '+' || filter[0] == '#')) {
+            return false;
+        }
+
+        std::string_view filterLeft(filter);
+        std::string_view topicLeft(topic);
+        while (true) {
+            auto filterEnd = filterLeft.find('/');
+            auto filterLevel = filterLeft.substr(0, filterEnd);
+            if (filterLevel == "#") {
+                return true;
+            }
+
+            auto topicEnd = topicLeft.find('/');
+            auto topicLevel = topicLeft.substr(0, topicEnd);
+            if (filterLevel != "+" && filterLevel != topicLevel) {
+                return false;
+            }
+
+            if (filterEnd == std::string_view::npos || topicEnd == std::string_view::npos) {
+                // "a/#" matches "a" too
+                return filterEnd == topicEnd || (topicEnd == std::string_view::npos && filterLeft.substr(filterEnd + 1) == "#");
+            }
+            filterLeft.remove_prefix(filterEnd + 1);
+            topicLeft.remove_prefix(topicEnd + 1);
+        }
+    }
+
+} // creatures
@@ -0,0 +1,170 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_TEST_BROKER_H
+#define ANDERSEN_MQTT_TEST_BROKER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include <mqtt_server_cpp.hpp>
+
+namespace creatures {
+
+    /**
+     * What one topic has seen
+     */
+    struct TopicStats {
+        uint64_t publishes = 0;
+        uint64_t bytes = 0;             // payloads only
+
+        // Publishes that were the same as the one before, which for a window field means we
+        // sent something nobody needed
+        uint64_t repeats = 0;
+
+        std::string lastPayload;
+    };
+
+    /**
+     * Packet counts for the whole broker
+     */
+    struct BrokerStats {
+        uint64_t connects = 0;
+        uint64_t disconnects = 0;
+        uint64_t publishesIn = 0;
+        uint64_t publishesOut = 0;
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        uint64_t subscribes = 0;
+        uint64_t unsubscribes = 0;
+        uint64_t pings = 0;
+        uint64_t wills = 0;
+
+        // When the first and last publish came in, for working out how fast they did
+        std::chrono::steady_clock::time_point firstPublish;
+        std::chrono::steady_clock::time_point lastPublish;
+    };
+
+    /**
+     * Just enough of an MQTT broker to point the daemon's code at in the tests and benchmarks,
+     * built on the server side of mqtt_cpp.
+     *
+     * It takes MQTT 3.1.1 connections on localhost, routes publishes to subscriptions
+     * (+ and # work), keeps retained messages, fires wills, and counts everything per topic.
+     * There's no persistence, auth, or QoS2 bookkeeping beyond what mqtt_cpp does for us.
+     *
+     * It runs on its own io thread. Everything below is safe to call from any other thread.
+     */
+    class TestBroker {
+
+    public:
+        /**
+         * @param port where to listen, or 0 to let the kernel pick
+         */
+        explicit TestBroker(uint16_t port = 0);
+        ~TestBroker();
+
+        TestBroker(const TestBroker &) = delete;
+        TestBroker &operator=(const TestBroker &) = delete;
+
+        bool start();
+        void stop();
+
+        [[nodiscard]] uint16_t getPort() const { return port; }
+
+        /**
+         * Sends something to the subscribers like a client had published it. Handy for
+         * poking commands at the daemon.
+         */
+        void publish(const std::string &topic, const std::string &payload, bool retain = false);
+
+        // What's retained on a topic right now, if anything
+        [[nodiscard]] std::optional<std::string> retained(const std::string &topic) const;
+
+        [[nodiscard]] BrokerStats getStats() const;
+        [[nodiscard]] std::map<std::string, TopicStats> getTopicStats() const;
+        [[nodiscard]] std::size_t getConnections() const;
+
+        // Forgets the counts, but not what's retained
+        void resetStats();
+
+        /**
+         * Waits until at least this many publishes have come in since the counts were last reset
+         *
+         * @return false if the time ran out first
+         */
+        bool waitForPublishes(uint64_t count, std::chrono::milliseconds timeout);
+
+        /**
+         * Waits for every client to go away. Everything a client sent shows up before it
+         * does, so after this the counts are complete.
+         *
+         * @return false if someone's still connected when the time runs out
+         */
+        bool waitForDisconnects(std::chrono::milliseconds timeout);
+
+        /**
+         * Does an MQTT topic filter (with + and #) match a topic?
+         */
+        static bool topicMatches(const std::string &filter, const std::string &topic);
+
+    private:
+        using Server = MQTT_NS::server<>;
+        using Connection = Server::endpoint_t;
+        using ConnectionPtr = std::shared_ptr<Connection>;
+
+        struct Session {
+            ConnectionPtr connection;
+            std::optional<MQTT_NS::will> will;
+        };
+
+        struct Subscription {
+            Connection *connection;
+            std::string filter;
+            MQTT_NS::qos qos;
+        };
+
+        struct RetainedMessage {
+            std::string payload;
+            MQTT_NS::qos qos;
+        };
+
+        void accept(ConnectionPtr connection);
+        void route(const std::string &topic, const std::string &payload, MQTT_NS::qos qos, bool retain);
+        void closeSession(Connection *connection, bool clean);
+
+        uint16_t requestedPort;
+        uint16_t port = 0;
+
+        boost::asio::io_context ioc;
+        std::unique_ptr<Server> server;
+        std::jthread thread;
+
+        // Only touched on the io thread
+        std::map<Connection *, Session> sessions;
+        std::vector<Subscription> subscriptions;
+
+        // Read from anywhere
+        mutable std::mutex stateMutex;
+        std::condition_variable disconnected;
+        std::condition_variable published;
+        std::map<std::string, RetainedMessage> retainedMessages;
+        std::map<std::string, TopicStats> topics;
+        BrokerStats stats;
+        std::size_t connections = 0;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_TEST_BROKER_H
@@ -0,0 +1,43 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <cstdlib>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include "test_check.h"
+
+namespace creatures::testing {
+
+    int failures = 0;
+
+    void check(bool good, const std::string &what) {
+        if (!good) {
+            fmt::print(stderr, "FAILED: {}\n", what);
+            failures++;
+        }
+    }
+
+    bool waitFor(const std::function<bool()> &condition, std::chrono::milliseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!condition()) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+
+    int finish() {
+        if (failures > 0) {
+            fmt::print(stderr, "{} checks failed\n", failures);
+            return EXIT_FAILURE;
+        }
+        fmt::print("all good\n");
+        return EXIT_SUCCESS;
+    }
+
+} // creatures::testing
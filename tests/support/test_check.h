@@ -0,0 +1,36 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_TEST_CHECK_H
+#define ANDERSEN_MQTT_TEST_CHECK_H
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+namespace creatures::testing {
+
+    // How many checks have failed so far
+    extern int failures;
+
+    /**
+     * Says what went wrong and counts it, but keeps going so one run shows every failure
+     */
+    void check(bool good, const std::string &what);
+
+    /**
+     * Polls until the condition is true
+     *
+     * @return false if the time ran out first
+     */
+    bool waitFor(const std::function<bool()> &condition, std::chrono::milliseconds timeout);
+
+    /**
+     * What main() should return, once everything's been checked
+     */
+    int finish();
+
+} // creatures::testing
+
+#endif //ANDERSEN_MQTT_TEST_CHECK_H
@@ -0,0 +1,137 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include "test_daemon.h"
+
+#include "config/config.h"
+#include "logging/logging.h"
+#include "processor/processor.h"
+
+namespace creatures {
+
+    TestDaemon::TestDaemon(uint16_t brokerPort, std::size_t shards)
+            : TestDaemon(std::vector<uint16_t>{brokerPort}, shards) {}
+
+    TestDaemon::TestDaemon(const std::vector<uint16_t> &brokerPorts, std::size_t shards)
+            : framer([this](const uint8_t *frame, size_t size) {
+                  message.assign(frame, frame + size);
+                  process_message(message, firstRun);
+              }) {
+
+        // Room for the biggest frame up front, so the first one doesn't count as an allocation
+        message.reserve(64);
+
+        transmitScheduler = std::make_shared<TransmitScheduler>();
+        busPacer = std::make_shared<BusPacer>();
+
+        window1 = std::make_shared<Window>("window1", 1);
+        window2 = std::make_shared<Window>("window2", 2);
+        window3 = std::make_shared<Window>("window3", 3);
+        window4 = std::make_shared<Window>("window4", 4);
+
+        ruleEngine = std::make_unique<RuleEngine>();
+        for (const auto &window: {window1, window2, window3, window4}) {
+            ruleEngine->addWindow(window);
+        }
+        stateHistory = std::make_unique<StateHistory>(Configuration().getHistorySize());
+
+        MQTTOptions options;
+        options.shards = std::max<std::size_t>(shards, 1);
+        for (std::size_t broker = 0; broker < brokerPorts.size(); broker++) {
+            auto brokerName = brokerPorts.size() == 1 ? std::string("test") : fmt::format("test{}", broker + 1);
+            for (std::size_t shard = 0; shard < options.shards; shard++) {
+                options.shard = shard;
+                options.name = options.shards == 1 ? brokerName : fmt::format("{}/{}", brokerName, shard);
+                options.clientId = fmt::format("andersen-mqtt-test-{}", shard);
+
+                auto mqttClient = std::make_unique<MQTTClient>("127.0.0.1", std::to_string(brokerPorts[broker]), options);
+                for (const auto &window: {window1, window2, window3, window4}) {
+                    mqttClient->addWindow(window);
+                }
+                mqttClients.push_back(std::move(mqttClient));
+            }
+        }
+
+        commandTracker = std::make_shared<CommandTracker>(mqttClients.front()->getIoContext());
+        transmitScheduler->setDropCallback([](TrafficClass, uint64_t tag) {
+            commandTracker->onDropped(tag);
+        });
+        gatewayWatchdog = std::make_shared<GatewayWatchdog>(mqttClients.front()->getIoContext(), 2,
+                                                            std::chrono::milliseconds(2000));
+    }
+
+    TestDaemon::~TestDaemon() {
+        stop();
+
+        // Anything still posted to the first io_context points into these, so it has to run first
+        auto &ioc = mqttClients.front()->getIoContext();
+        ioc.restart();
+        ioc.poll();
+        gatewayWatchdog.reset();
+        commandTracker.reset();
+        ioc.poll();
+
+        mqttClients.clear();
+        stateHistory.reset();
+        ruleEngine.reset();
+        busPacer.reset();
+        transmitScheduler.reset();
+        window1.reset();
+        window2.reset();
+        window3.reset();
+        window4.reset();
+    }
+
+    void TestDaemon::initLogging() {
+        setenv("ANDERSEN_LOG_LEVEL", "warning", 0);
+        logging::init(Configuration::fromEnvironment());
+    }
+
+    bool TestDaemon::start(std::chrono::milliseconds timeout) {
+        for (const auto &mqttClient: mqttClients) {
+            mqttClient->start();
+        }
+        running = true;
+
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (std::any_of(mqttClients.begin(), mqttClients.end(), [](const auto &c) { return !c->isConnected(); })) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+
+    std::size_t TestDaemon::getConnected() const {
+        return static_cast<std::size_t>(std::count_if(mqttClients.begin(), mqttClients.end(),
+                                                      [](const auto &c) { return c->isConnected(); }));
+    }
+
+    void TestDaemon::stop() {
+        if (running) {
+            MQTTClient::stopAll(mqttClients);
+            running = false;
+        }
+    }
+
+    void TestDaemon::feed(const uint8_t *bytes, std::size_t size) {
+        framer.feed(bytes, size);
+    }
+
+    std::vector<uint8_t> TestDaemon::statusFrame(const std::array<uint8_t, 4> &statuses) {
+        std::vector<uint8_t> frame = {SRC_CONTROLLER, DST_PANEL_1, CMD_STATUS_WITHOUT_POLL,
+                                      statuses[0], statuses[1], statuses[2], statuses[3]};
+        frame.push_back(Window::calculateChecksum(frame));
+        return frame;
+    }
+
+} // creatures
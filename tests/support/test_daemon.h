@@ -0,0 +1,81 @@
+//
+// Created by @opsnlops on 10/18/26.
+//
+
+#ifndef ANDERSEN_MQTT_TEST_DAEMON_H
+#define ANDERSEN_MQTT_TEST_DAEMON_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "window/framer.h"
+
+namespace creatures {
+
+    /**
+     * Sets up the daemon's shared state (see processor/processor.h) the way main() does, with
+     * every broker connection pointed at one of our own, so frames can go through the framer
+     * and process_message() without a gateway or any of the daemon's threads.
+     *
+     * It's all globals underneath, so only one of these at a time.
+     */
+    class TestDaemon {
+
+    public:
+        /**
+         * @param brokerPort where the TestBroker is listening
+         * @param shards how many connections to split the windows across
+         */
+        explicit TestDaemon(uint16_t brokerPort, std::size_t shards = 1);
+
+        /**
+         * One connection (or set of shards) per broker, in this order, like ANDERSEN_BROKERS.
+         * The first one's io thread gets the command tracker and the watchdog, like in main().
+         */
+        explicit TestDaemon(const std::vector<uint16_t> &brokerPorts, std::size_t shards = 1);
+        ~TestDaemon();
+
+        TestDaemon(const TestDaemon &) = delete;
+        TestDaemon &operator=(const TestDaemon &) = delete;
+
+        /**
+         * Quiets the logs down to warnings (unless ANDERSEN_LOG_LEVEL says otherwise). A test
+         * that's counting allocations can't have every frame logged.
+         */
+        static void initLogging();
+
+        /**
+         * Connects to the broker, and waits until every connection is in
+         */
+        bool start(std::chrono::milliseconds timeout = std::chrono::seconds(5));
+        void stop();
+
+        // How many of the connections are up right now
+        [[nodiscard]] std::size_t getConnected() const;
+
+        /**
+         * Bytes from the gateway, handled the way the reader and processor threads would
+         */
+        void feed(const uint8_t *bytes, std::size_t size);
+        void feed(const std::vector<uint8_t> &bytes) { feed(bytes.data(), bytes.size()); }
+
+        [[nodiscard]] uint64_t getFrames() const { return framer.getFrames(); }
+
+        /**
+         * A STATUS frame like the gateway sends, checksum and all
+         */
+        static std::vector<uint8_t> statusFrame(const std::array<uint8_t, 4> &statuses);
+
+    private:
+        Framer framer;
+        std::vector<uint8_t> message;
+        bool firstRun = true;
+        bool running = false;
+    };
+
+} // creatures
+
+#endif //ANDERSEN_MQTT_TEST_DAEMON_H